@@ -4,8 +4,12 @@
  */
 
 #ifndef _DEVOL_H
+#define _DEVOL_H
 
+#include <time.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 /* Function return codes. */
 #define DEVOL_ERR  -1
@@ -31,6 +35,337 @@ typedef unsigned short rdata_t[7];
 typedef struct drand48_data rdata_t;
 #endif
 
+/*
+ * Random number generation. Each controller has its own generator with its
+ * own independent stream; problems should draw from solution->cont->rng. See
+ * devol_rng.c for the details.
+ */
+#define DEVOL_RNG_PHILOX  0   /* Philox4x32-10, counter based. The default. */
+#define DEVOL_RNG_RAND48  1   /* The glibc *rand48_r() family. */
+
+struct devol_rng {
+
+  /* Which generator this is. */
+  int type;
+
+  /* Output is generated 4 words at a time; idx is the next unused one. */
+  int      idx;
+  uint32_t out[4];
+
+  union {
+    struct {
+      uint32_t key[2];
+      uint32_t ctr[4];
+    } philox;
+    struct {
+      unsigned short rstate[3];
+      rdata_t        rdata;
+    } rand48;
+  } state;
+
+};
+
+/* What a deterministic stream is used for; see devol_rng_stream(). */
+#define DEVOL_STREAM_INIT      1
+#define DEVOL_STREAM_BREED     2
+#define DEVOL_STREAM_DISPERSE  3
+
+/* 2^-32: turns a random word into a double on [0,1). */
+#define DEVOL_RNG_UNIT (1.0 / 4294967296.0)
+
+void   devol_rng_init(struct devol_rng *rng, int type,
+		      const unsigned short seed[3], uint32_t stream);
+void   devol_rng_stream(struct devol_rng *rng, const unsigned short seed[3],
+			uint32_t generation, uint32_t slot, uint32_t tag);
+void   devol_rng_fill(struct devol_rng *rng, double *d, int count);
+void   _devol_rng_refill(struct devol_rng *rng);
+
+/* A uniformly distributed 32 bit word. */
+static inline uint32_t devol_rng_u32(struct devol_rng *rng){
+
+  if ( rng->idx >= 4 )
+    _devol_rng_refill(rng);
+  return rng->out[rng->idx++];
+
+}
+
+/* A uniformly distributed double on [0,1). */
+static inline double devol_rng_uniform(struct devol_rng *rng){
+
+  return devol_rng_u32(rng) * DEVOL_RNG_UNIT;
+
+}
+
+/*
+ * A genome arena. Fixed size slots handed out by the engine when a problem
+ * specifies a genome_size. See devol_arena.c.
+ */
+struct devol_arena {
+
+  /* The memory for all of the slots. */
+  void   *base;
+  size_t  slot_size;
+  int     slots;
+
+  /* Slots that have never been handed out start at cursor. */
+  char   *cursor;
+  char   *limit;
+
+  /* Set if base came from malloc() and so is ours to free. */
+  int     owned;
+
+};
+
+/*
+ * A bounded multi producer, multi consumer queue of ints (D. Vyukov's
+ * design): each cell carries a sequence number that says whether it is ready
+ * to be written or read for a given lap of the ring, so producers and
+ * consumers only ever compare and swap their own position. Never blocks;
+ * push fails when the queue is full and pop when it is empty. See
+ * devol_queue.c.
+ */
+struct devol_queue_cell {
+
+  volatile uint64_t seq;
+  int               value;
+
+};
+
+struct devol_queue {
+
+  struct devol_queue_cell *cells;
+  uint64_t                 mask;
+
+  /* Kept on cache lines of their own, away from each other. */
+  char                     __pad0[64 - sizeof(void *) - sizeof(uint64_t)];
+  volatile uint64_t        head;
+  char                     __pad1[64 - sizeof(uint64_t)];
+  volatile uint64_t        tail;
+  char                     __pad2[64 - sizeof(uint64_t)];
+
+};
+
+/*
+ * Statistics kept by each controller. Everything accumulates from when the
+ * gene pool is created; gene_pool_get_stats() adds them all up. Times are in
+ * nanoseconds, one slot per phase of a generation.
+ */
+#define DEVOL_PHASE_FITNESS   0   /* Evaluating the population. */
+#define DEVOL_PHASE_SORT      1   /* Sorting islands by fitness. */
+#define DEVOL_PHASE_BREED     2   /* Picking parents and mutate(). */
+#define DEVOL_PHASE_REPLACE   3   /* Evaluating the children that replaced
+				     the worst solutions. */
+#define DEVOL_PHASE_WAIT      4   /* Waiting on the other threads. */
+#define DEVOL_PHASE_DISPERSE  5   /* Gene dispersal. */
+#define DEVOL_PHASES          6
+
+struct devol_stats {
+
+  uint64_t ns[DEVOL_PHASES];
+
+  /* Calls to fitness() and the evaluations skipped because the solution had
+   * not changed since it was last evaluated. */
+  uint64_t evaluations;
+  uint64_t cache_hits;
+
+  /* Calls to the other call backs. destroy() is only called when the gene
+   * pool is torn down, so there is nothing of it to count. */
+  uint64_t mutates;
+  uint64_t inits;
+
+  uint64_t generations;
+
+};
+
+/*
+ * Fitness statistics of the population. The engine works these out from the
+ * fitnesses it has just computed at the end of every generation (before
+ * dispersal), so they cost no extra calls to fitness(). variance is the
+ * population variance.
+ */
+struct devol_fitness {
+
+  int    count;
+  double mean;
+  double variance;
+  double min;
+  double max;
+
+};
+
+/*
+ * What an island saw at the end of its last generation: partial sums for the
+ * statistics above (m2 is the sum of squared differences from the mean) and
+ * the indexes of its best solutions, best first. Each island is only written
+ * by the controller evolving it; the gene pool combines them at the end of
+ * the generation.
+ */
+struct devol_island {
+
+  int     count;
+  double  mean;
+  double  m2;
+  double  min;
+  double  max;
+
+  int    *top;
+  int     top_count;
+
+};
+
+/*
+ * How one island evolves; see devol_params.island_params. mutation_scale is
+ * for the problem to scale its mutations by (devol_mutation_scale()); the
+ * engine doesn't use it.
+ */
+struct devol_island_params {
+
+  double  reproduction_rate;
+  double  breed_fitness;
+  double  mutation_scale;
+
+};
+
+/*
+ * Per generation records written by gene_pool_record(); see devol_record.c.
+ * A record file is a header followed by one record per generation. The
+ * evaluations and times are for that generation alone.
+ */
+#define DEVOL_RECORD_MAGIC    "DEVOLREC"
+#define DEVOL_RECORD_VERSION  1
+
+struct devol_record_header {
+
+  char     magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t phases;
+  uint32_t population;
+
+};
+
+struct devol_record {
+
+  uint32_t generation;
+  uint32_t count;
+  double   min;
+  double   mean;
+  double   max;
+  uint64_t evaluations;
+  uint64_t ns[DEVOL_PHASES];
+
+};
+
+struct devol_recorder;
+
+/*
+ * The live stats page published by gene_pool_export(); see devol_export.c.
+ * It lives in a POSIX shared memory object that other processes map read
+ * only and copy out with devol_export_read(). seq is a seqlock: odd while the
+ * page is being updated. threads[] has the per thread phase times; the last
+ * entry used (threads[thread_count]) is the calling thread.
+ */
+#define DEVOL_EXPORT_MAGIC    "DEVOLTOP"
+#define DEVOL_EXPORT_VERSION  1
+#define DEVOL_EXPORT_THREADS  63
+#define DEVOL_EXPORT_NAME     "/devol.%d"
+
+struct devol_export {
+
+  char              magic[8];
+  uint32_t          version;
+  volatile uint32_t seq;
+
+  int32_t  pid;
+  uint32_t thread_count;
+  uint32_t population;
+  uint32_t islands;
+  uint32_t generation;
+  uint32_t done;
+
+  /* When the pool started exporting and when the page was last updated, on
+   * CLOCK_MONOTONIC. */
+  uint64_t started;
+  uint64_t updated;
+
+  struct devol_fitness fitness;
+  double   best;
+
+  /* Evaluations so far, and per second over the last generation. */
+  uint64_t evaluations;
+  double   rate;
+
+  uint64_t threads[DEVOL_EXPORT_THREADS + 1][DEVOL_PHASES];
+
+};
+
+struct devol_exporter;
+
+/* The shared state of a multi process gene pool; see devol_mp.c. */
+struct devol_mp;
+
+/* The stages of a pipelined gene pool; see devol_pipeline.c. */
+struct devol_pipeline;
+
+/*
+ * Hardware counters kept for each phase when devol_params.perf is set. See
+ * devol_perf.c.
+ */
+#define DEVOL_PERF_CYCLES         0
+#define DEVOL_PERF_INSTRUCTIONS   1
+#define DEVOL_PERF_LLC_MISSES     2
+#define DEVOL_PERF_BRANCH_MISSES  3
+#define DEVOL_PERF_COUNTERS       4
+
+/* A counter that could not be opened. */
+#define DEVOL_PERF_NONE  ((uint64_t)-1)
+
+/*
+ * Trace events. Each controller keeps the most recent events in a ring that
+ * only its own thread writes, so recording one is a few stores and no locks;
+ * gene_pool_dump_trace() writes them out as Chrome trace event JSON. See
+ * devol_trace.c.
+ */
+#define DEVOL_EVENT_PHASE       0   /* A phase ran; arg is the phase. */
+#define DEVOL_EVENT_MIGRATION   1   /* Dispersal; arg is the swaps made. */
+#define DEVOL_EVENT_ALLOC_FAIL  2   /* No genome slot; arg is the solution. */
+
+struct devol_event {
+
+  uint64_t start;   /* devol_clock_ns() */
+  uint64_t dur;     /* ns; 0 for events that are just a moment. */
+  uint32_t generation;
+  uint32_t type;
+  uint32_t arg;
+
+};
+
+struct devol_trace {
+
+  struct devol_event *events;
+  uint32_t            mask;
+
+  /* Events ever recorded; the ring holds the last mask + 1 of them. */
+  volatile uint64_t   head;
+
+};
+
+/*
+ * The handle asynchronous evaluations complete through; one per controller.
+ * Completions bump an eventfd (a pipe where there is none) that the
+ * controller's thread reads when it wants them. See devol_async.c.
+ */
+struct devol_async {
+
+  int rfd;
+  int wfd;
+
+  /* Only touched by the controller's own thread. */
+  int in_flight;
+  int max;
+
+};
+
 /* Now we can include the thread stuff. */
 #include <devol_threads.h>
 
@@ -40,7 +375,10 @@ typedef struct drand48_data rdata_t;
  */
 struct solution {
 
-  /* These are the functions that will modify the solution. */
+  /* These are the functions that will modify the solution. mutate() builds
+   * a child of par1 and par2 in dest. dest is the solution the child
+   * replaces: it still holds the dead solution's genome (private data), which
+   * mutate() must overwrite completely rather than allocate anew. */
   int    (*mutate)(struct solution *par1, struct solution *par2, 
 		   struct solution *dest);
   double (*fitness)(struct solution *solution);
@@ -48,10 +386,13 @@ struct solution {
   int    (*destroy)(struct solution *solution);
   void   (*swap)(struct solution *left, struct solution *right);
 
-  /* The calculated fitness value. */
+  /* The calculated fitness value. The engine sets this to NAN when the
+   * solution changes and so has to be evaluated again. */
   double fitness_val;
 
-  /* The solution's private data. Use what ever you want... */
+  /* The solution's private data. Use what ever you want... If the gene pool
+   * was given a genome_size then ptr points at the solution's genome slot and
+   * belongs to the engine. */
   union {
     long unsigned int  uint_64; /* 64 Bit integer. */
     void              *ptr;     /* A pointer to something else  */
@@ -83,6 +424,26 @@ struct devol_params {
   /* How much gene dispersal do we want? 0 is no dispersal. */
   double gene_dispersal_factor;
 
+  /*
+   * How solutions move between islands. DEVOL_MIGRATE_RANDOM (the default)
+   * swaps random pairs of solutions, gene_dispersal_factor of the population
+   * each generation. The others send each island's best migrants solutions
+   * (1 if 0) to the islands it is connected to, where each one replaces the
+   * worst solution if it is better. That happens every migration_interval
+   * generations (every generation if 0), or, if migration_diversity is set,
+   * adaptively: whenever the islands have drifted further apart than
+   * migration_diversity the interval halves, and otherwise it doubles back
+   * up to migration_interval. How far apart they are is the standard
+   * deviation of the islands' mean fitnesses over that of the whole
+   * population, 0 to 1; a few tenths is a good place to start. Topology
+   * migration needs genome_size; without it random swaps are used.
+   * gene_dispersal_factor 0 still turns migration off altogether.
+   */
+  int    migration;
+  int    migrants;
+  int    migration_interval;
+  double migration_diversity;
+
   /* How many new solutions should we breed. Varies between 0 and 1: 0 being
    * no new solutions (not a very good algorithm), and 1 being 1 new solution
    * for each member in the population. */
@@ -95,9 +456,124 @@ struct devol_params {
   double breed_fitness;
 
   /*
-   * This allows the calling program to specify the random state.
+   * This allows the calling program to specify the random state and which
+   * generator to use (DEVOL_RNG_*; the default is DEVOL_RNG_PHILOX).
    */
   unsigned short rstate[3];
+  int            rng_type;
+
+  /*
+   * The size in bytes of each solution's genome. If this is non-zero the
+   * engine owns the genome memory: every solution's private.ptr points at a
+   * genome_size slot before init() is called. Children are bred straight
+   * into the slots of the solutions they replace (see mutate() above) so
+   * init() and destroy() only run when the population is created and torn
+   * down, destroy() may be NULL, and dispersal works without a swap()
+   * function. If this is 0 the problem manages its own memory through init()
+   * and destroy(); mutate() is still handed the dying solution's data.
+   */
+  size_t genome_size;
+
+  /*
+   * Copy the genome in src to dest, both genome_size slots. Migration and
+   * the hall of fame copy genomes into other slots with this, or byte for
+   * byte if it is NULL. Only a genome that keeps pointers into itself needs
+   * it, to point the copy's at dest; one that works out where its parts are
+   * from where it is (like mixture's) can leave it NULL.
+   */
+  void   (*copy)(void *dest, const void *src);
+
+  /*
+   * How many islands to split the population into. Each island is evolved on
+   * its own (sorted, bred and replaced within itself); dispersal is the only
+   * way solutions move between them. Threads take whole islands, so the
+   * island layout does not depend on the thread count. 0 means one island
+   * per thread (one island in total for the sequential algorithm).
+   */
+  int islands;
+
+  /*
+   * Deterministic mode. Instead of each controller drawing from its own
+   * stream, every random draw comes from a stream picked by (seed,
+   * generation, slot index): the slot being initialized or replaced, or the
+   * generation's dispersal. With a fixed number of islands the final
+   * population is then bitwise identical for any thread count and for the
+   * sequential algorithm. Problems must only use solution->cont->rng.
+   */
+  int deterministic;
+
+  /*
+   * Count cycles, instructions, cache misses and branch misses for each
+   * phase with the hardware performance counters, if they are available.
+   * Costs a system call per phase so leave this off unless you want them.
+   */
+  int perf;
+
+  /*
+   * How many of the best solutions ever seen to keep copies of; see
+   * gene_pool_hall_of_fame(). 0 keeps just the best one. Genomes are copied
+   * with copy() (byte for byte if that is NULL) if the engine owns them
+   * (genome_size). Otherwise only the private union is copied and the
+   * problem must keep its genome in there for the copies to mean anything.
+   */
+  int hall_of_fame;
+
+  /*
+   * Record trace events (phases, dispersal, allocation failures) for each
+   * thread, keeping the last this many (rounded up to a power of 2) per
+   * thread. 0 is off. See gene_pool_dump_trace().
+   */
+  int trace;
+
+  /*
+   * Evaluate in batches instead of calling fitness() a solution at a time.
+   * Each time an island needs evaluating the engine hands evaluate() every
+   * solution in it that has changed, and evaluate() fills in their
+   * fitness_val; any it leaves as NAN get fitness() as usual. With threads
+   * it is called by each thread for its own islands at the same time. arg
+   * is passed along. grid_evaluate() farms the batches out to fitness
+   * servers.
+   */
+  int   (*evaluate)(solution_t **solutions, int count, void *arg);
+  void   *evaluate_arg;
+
+  /*
+   * Evaluate asynchronously, for fitnesses that come from a subprocess, a
+   * file or a simulator. submit() starts evaluating a solution and returns
+   * straight away; whatever finishes the evaluation then calls
+   * devol_complete() with the handle it was given, from any thread. Up to
+   * in_flight evaluations (64 if 0) are kept going per thread. Children are
+   * submitted as soon as they are bred, so breeding carries on while they
+   * are evaluated. If submit() returns non-zero the solution gets fitness()
+   * instead. Takes the place of evaluate() if both are set.
+   */
+  int   (*submit)(solution_t *solution, struct devol_async *handle,
+		  void *arg);
+  void   *submit_arg;
+  int     in_flight;
+
+  /*
+   * Whatever the problem being solved needs: the data, the bounds, how much
+   * to mutate by. The call backs get it with devol_problem(), so several gene
+   * pools can solve differently set up copies of the same problem at once
+   * instead of sharing one set of globals. The engine never looks at it.
+   */
+  void   *problem;
+
+  /*
+   * Give the islands settings of their own, so one run explores a range of
+   * them with migration carrying good genomes between islands. island_params
+   * is a list with one entry per island; islands has to be set to its length
+   * or the gene pool won't be made. A mutation_scale of 0 means 1. Or set
+   * island_spread above 1 and the engine spreads the islands out itself:
+   * each gets the reproduction rate, breed fitness and a mutation scale of 1
+   * multiplied by its own factors between 1/island_spread and island_spread.
+   * The list is only read when the gene pool is made and by
+   * gene_pool_set_params(). gene_pool_print_islands() shows each island's
+   * settings next to how it is doing.
+   */
+  struct devol_island_params *island_params;
+  double                      island_spread;
 
 };
 
@@ -117,48 +593,414 @@ struct gene_pool {
   /* A pool of threads to use for distributing the work. */
   struct thread_pool workers;
 
+  /* Genome arenas, one per controller. Only used if params.genome_size is
+   * set. */
+  struct devol_arena *arenas;
+
   /* An aggragation of the myriad paramaters that go into an evolutionary
    * algorithm */
   struct devol_params params;
 
-  /*
-   * Data for the *sequential* algorithm only. This data is held in the 
-   * thread's entrance function's stack frame for the multithreaded version.
+  /* The number of islands and how many generations have been run. */
+  int          islands;
+  unsigned int generation;
+
+  /* Fitness statistics: each island's part, the population's as of the last
+   * generation, and the best solutions ever seen (best first; hall_of_fame
+   * has room for hall_of_fame_len and holds hall_of_fame_count). best is the
+   * best fitness ever seen as a devol_fitness_key(); the islands update it
+   * as they finish so it can be read at any time. */
+  struct devol_island  *island_stats;
+  struct devol_fitness  fitness;
+  solution_t           *hall_of_fame;
+  void                 *hall_of_fame_genomes;
+  int                   hall_of_fame_len;
+  int                   hall_of_fame_count;
+  volatile uint64_t     best;
+
+  /* Topology migration; see devol_migrate.c. Each island keeps the indexes
+   * of its best top_len solutions. The outboxes hold migrants solutions per
+   * island, twice over, and migrate_send and migrate_pull say whether this
+   * generation fills them and whether it takes in last generation's. */
+  int                   top_len;
+  int                   migrants;
+  char                 *migrant_genomes;
+  double               *migrant_fitness;
+  int                  *migrant_count;
+  int                   migrate_send;
+  int                   migrate_pull;
+  int                   migrate_interval;
+  int                   migrate_since;
+
+  /* Each island's settings as worked out from params; see devol_islands.c. */
+  struct devol_island_params *island_params;
+
+  /* Where generations get recorded to, if anywhere. */
+  struct devol_recorder *recorder;
+
+  /* Where the live stats page is published, if anywhere. */
+  struct devol_exporter *exporter;
+
+  /* Set if the islands are evolved by worker processes instead of threads.
+   * The workers' controllers are then in workers.controllers but there are
+   * no threads. */
+  struct devol_mp *mp;
+
+  /* Set if breeding and evaluation are done by separate threads; see
+   * gene_pool_create_pipeline(). The threads' controllers are then in
+   * workers.controllers, breeders first. */
+  struct devol_pipeline *pipeline;
+
+  /* The gene_pool controller. Fully initialized only if the gene_pool is
+   * going to be sequential; the SMP version just uses its rng for dispersal.
    */
-  solution_t *new_solutions;
-  int         new_count;
-  int         breeder_window;
-
-  /* The gene_pool controller. Only needed and initialized if the gene_pool is
-   * going to be sequential. */
   struct devol_controller controller;
 
 };
 
+/*
+ * The params.problem of the gene pool solution belongs to. NULL for a
+ * solution that isn't in one (a fitness server's, say).
+ */
+static inline void *devol_problem(solution_t *solution){
+
+  if ( ! solution->cont || ! solution->cont->gene_pool )
+    return NULL;
+  return solution->cont->gene_pool->params.problem;
+
+}
+
+/*
+ * How much the island solution is in wants mutations scaled by: 1 unless the
+ * islands have settings of their own. Call it on the solution being bred
+ * into.
+ */
+static inline double devol_mutation_scale(solution_t *solution){
+
+  size_t island, block;
+  struct gene_pool *pool;
+
+  if ( ! solution->cont || ! (pool = solution->cont->gene_pool) ||
+       ! pool->island_params || solution < pool->solutions ||
+       solution >= pool->solutions + pool->solution_count )
+    return 1;
+
+  block = pool->solution_count / pool->islands;
+  island = (solution - pool->solutions) / block;
+  if ( island >= pool->islands )
+    island = pool->islands - 1;
+
+  return pool->island_params[island].mutation_scale;
+
+}
+
+/* Migration topologies for devol_params.migration. */
+#define DEVOL_MIGRATE_RANDOM  0   /* Random swaps between any islands. */
+#define DEVOL_MIGRATE_RING    1   /* Each island sends to the next one. */
+#define DEVOL_MIGRATE_TORUS   2   /* To its neighbours on a wrapped grid. */
+#define DEVOL_MIGRATE_FULL    3   /* To every other island. */
+
+/*
+ * Convergence criteria for gene_pool_converged(); or them together in
+ * devol_converge.criteria. See devol_converge.c.
+ */
+#define DEVOL_CONVERGE_DERIVATIVE  0x1   /* Average fitness stopped improving. */
+#define DEVOL_CONVERGE_STAGNATION  0x2   /* Best fitness stopped improving. */
+#define DEVOL_CONVERGE_TARGET      0x4   /* Average fitness reached target. */
+#define DEVOL_CONVERGE_CUSTOM      0x8   /* check() said so. */
+
+struct devol_converge {
+
+  /* Set by the program. window is in generations and epsilon is the change
+   * in fitness too small to count. check() may be NULL; arg is for its use. */
+  int    criteria;
+  int    window;
+  double epsilon;
+  double target;
+  int  (*check)(struct devol_converge *conv);
+  void  *arg;
+
+  /* Kept up to date by gene_pool_converged(); zero generations to start
+   * over. slope is the smoothed improvement of the average fitness per
+   * generation. */
+  unsigned int generations;
+  double       avg;
+  double       best;
+  double       slope;
+  double       best_seen;
+  unsigned int best_generation;
+
+  /* The criterion that was met last time, or 0. */
+  int          fired;
+
+};
+
+/*
+ * A job for the scheduler: a gene pool to run for a number of generations
+ * on the scheduler's threads alongside any other jobs. See devol_sched.c.
+ */
+#define DEVOL_JOB_QUEUED   0
+#define DEVOL_JOB_RUNNING  1
+#define DEVOL_JOB_DONE     2
+
+struct devol_job {
+
+  /* Set by the program. The job is done after generations generations, or
+   * sooner if conv is set and gene_pool_converged() says so. Jobs of a
+   * higher priority always go first; jobs of the same priority share the
+   * threads in proportion to their weight (0 counts as 1). name is for
+   * devol_sched_print() and may be NULL. */
+  struct gene_pool      *pool;
+  int                    generations;
+  struct devol_converge *conv;
+  int                    priority;
+  int                    weight;
+  const char            *name;
+
+  /* Called by the thread that ran it after each of the job's generations;
+   * returning non-zero ends the job there. May be NULL. arg is for its
+   * use. */
+  int                  (*generation)(struct devol_job *job);
+  void                  *arg;
+
+  /* Kept by the scheduler. busy is the time spent running generations and
+   * evaluations what they took; started and finished are devol_clock_ns()
+   * times. */
+  volatile int           state;
+  int                    ran;
+  uint64_t               started;
+  uint64_t               finished;
+  uint64_t               busy;
+  uint64_t               evaluations;
+  uint64_t               pass;
+  struct devol_job      *next;
+
+};
+
+/* The scheduler itself; see devol_sched.c. */
+struct devol_sched;
+
+/*
+ * Time keeping for the stats. The phase functions are chained: each one takes
+ * the time the phase started, charges the phase, and returns the current time
+ * for the next phase to start from, so each phase costs one clock read.
+ */
+static inline uint64_t devol_clock_ns(void){
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+
+}
+
+void   _devol_perf_sample(struct devol_controller *controller, int phase);
+
+static inline uint64_t devol_phase_begin(struct devol_controller *controller){
+
+  if ( controller->perf )
+    _devol_perf_sample(controller, -1);
+  return devol_clock_ns();
+
+}
+
+void   _devol_trace(struct devol_controller *controller, int type,
+		    uint32_t arg, uint64_t start, uint64_t dur);
+
+static inline uint64_t devol_phase_end(struct devol_controller *controller,
+				       int phase, uint64_t start){
+
+  uint64_t now = devol_clock_ns();
+
+  controller->stats.ns[phase] += now - start;
+  if ( controller->perf )
+    _devol_perf_sample(controller, phase);
+  if ( controller->trace )
+    _devol_trace(controller, DEVOL_EVENT_PHASE, phase, start, now - start);
+  return now;
+
+}
+
+/*
+ * Map a fitness to an unsigned integer with the same ordering, so the best
+ * fitness can be kept with a plain compare and swap. NaN maps past
+ * everything, so DEVOL_FITNESS_NONE means no fitness at all.
+ */
+#define DEVOL_FITNESS_NONE  ((uint64_t)-1)
+
+static inline uint64_t devol_fitness_key(double fitness){
+
+  union { double d; uint64_t u; } v;
+
+  v.d = fitness;
+  if ( fitness != fitness )
+    return DEVOL_FITNESS_NONE;
+  return (v.u >> 63) ? ~v.u : v.u | (1ULL << 63);
+
+}
+
+static inline double devol_fitness_value(uint64_t key){
+
+  union { double d; uint64_t u; } v;
+
+  v.u = (key >> 63) ? key & ~(1ULL << 63) : ~key;
+  return v.d;
+
+}
+
 /* Flag definitions for the gene_pool struct. */
 #define GPOOL_SEQ   0
 #define GPOOL_SMP   1
+#define GPOOL_MP    2
+#define GPOOL_PIPE  3
 
 /* High level entrances to the API. */
 int  gene_pool_create(struct gene_pool *pool, int solutions, int threads, 
 		      struct devol_params params);
 int  gene_pool_create_seq(struct gene_pool *pool, int solutions,
 			  struct devol_params params);
+int  gene_pool_create_mp(struct gene_pool *pool, int solutions, int processes,
+			 struct devol_params params);
+void gene_pool_destroy_mp(struct gene_pool *pool);
+int  gene_pool_create_pipeline(struct gene_pool *pool, int solutions,
+			       int breeders, int evaluators,
+			       struct devol_params params);
+void gene_pool_destroy_pipeline(struct gene_pool *pool);
+void gene_pool_destroy(struct gene_pool *pool);
 void gene_pool_set_params(struct gene_pool *pool, struct devol_params params);
 int  gene_pool_iterate(struct gene_pool *pool);
 int  gene_pool_iterate_seq(struct gene_pool *pool);
 
 /* Utility functions for dealing with gene pools. */
+void   gene_pool_get_stats(struct gene_pool *pool, struct devol_stats *stats);
+void   gene_pool_print_stats(struct gene_pool *pool, FILE *out);
+int    gene_pool_get_perf(struct gene_pool *pool, int phase,
+			  uint64_t counts[DEVOL_PERF_COUNTERS]);
+void   gene_pool_print_perf(struct gene_pool *pool, FILE *out);
 double gene_pool_avg_fitness(struct gene_pool *pool);
+void   gene_pool_get_fitness(struct gene_pool *pool,
+			     struct devol_fitness *fitness);
+double gene_pool_best_fitness(struct gene_pool *pool);
+solution_t *gene_pool_best(struct gene_pool *pool);
+solution_t *gene_pool_hall_of_fame(struct gene_pool *pool, int *count);
+void   gene_pool_print_islands(struct gene_pool *pool, FILE *out);
+int    gene_pool_converged(struct gene_pool *pool,
+			   struct devol_converge *conv);
+void   devol_converge_reset(struct devol_converge *conv);
+char  *devol_converge_name(int criterion);
 void   gene_pool_display_fitnesses(struct gene_pool *pool);
 void   gene_pool_disperse(struct gene_pool *pool);
+void   _gene_pool_swap(struct gene_pool *pool, solution_t *a, solution_t *b);
 int    _compare_solutions(const void *a, const void *b);
+
+/* The old *rand48_r() wrappers. Use the controller's rng instead. */
 void   devol_rand48(unsigned short rstate[3], rdata_t *rdata, double *d);
 void   devol_nrand48(unsigned short rstate[3], rdata_t *rdata, long int *d);
 void   devol_jrand48(unsigned short rstate[3], rdata_t *rdata, long int *d);
 
+/* Per generation records. */
+int    gene_pool_record(struct gene_pool *pool, const char *path);
+int    gene_pool_record_stop(struct gene_pool *pool);
+void   _gene_pool_record_generation(struct gene_pool *pool);
+
+/* Live stats. */
+int    gene_pool_export(struct gene_pool *pool, const char *name);
+void   gene_pool_export_stop(struct gene_pool *pool);
+void   _gene_pool_export_generation(struct gene_pool *pool);
+struct devol_export *devol_export_open(const char *name);
+int    devol_export_read(struct devol_export *page, struct devol_export *copy);
+void   devol_export_close(struct devol_export *page);
+
+/* Running many gene pools on one set of threads. */
+struct devol_sched *devol_sched_create(int threads);
+int    devol_sched_add(struct devol_sched *sched, struct devol_job *job);
+void   devol_sched_wait(struct devol_sched *sched, struct devol_job *job);
+void   devol_sched_wait_all(struct devol_sched *sched);
+void   devol_sched_print(struct devol_sched *sched, FILE *out);
+void   devol_sched_destroy(struct devol_sched *sched);
+
+/* Asynchronous evaluation. */
+void   devol_complete(struct devol_async *handle, solution_t *solution,
+		      double fitness);
+void   devol_async_destroy(struct devol_controller *controller);
+void   _gene_pool_submit_p(struct devol_controller *controller,
+			   solution_t *solution);
+void   _gene_pool_async_wait_p(struct devol_controller *controller);
+void   _gene_pool_breed_async_p(struct devol_controller *controller,
+				int start, int stop,
+				int new_count, int breeder_window);
+
+/* Trace rings. */
+int    devol_trace_init(struct devol_controller *controller, int events);
+void   devol_trace_destroy(struct devol_controller *controller);
+int    gene_pool_dump_trace(struct gene_pool *pool, FILE *out);
+
+/* Hardware counters; these run on the controller's own thread. */
+int    devol_perf_open(struct devol_controller *controller);
+void   devol_perf_close(struct devol_controller *controller);
+void   devol_perf_free(struct devol_controller *controller);
+
+/* Lock free queues. */
+int    devol_queue_init(struct devol_queue *queue, int size);
+void   devol_queue_destroy(struct devol_queue *queue);
+int    devol_queue_push(struct devol_queue *queue, int value);
+int    devol_queue_pop(struct devol_queue *queue, int *value);
+
+/* Genome arena functions. */
+int    devol_arena_init(struct devol_arena *arena, size_t slot_size,
+			int slots);
+size_t devol_arena_size(size_t slot_size, int slots);
+void   devol_arena_init_at(struct devol_arena *arena, size_t slot_size,
+			   int slots, void *mem);
+void   devol_arena_destroy(struct devol_arena *arena);
+void  *devol_arena_alloc(struct devol_arena *arena);
+
 /* Functions to be used by the parallel sections of the code. */
 void   _gene_pool_calculate_fitnesses_p(struct gene_pool *pool, 
 					int start, int stop);
+void   _gene_pool_evaluate_p(struct devol_controller *controller,
+			     int start, int stop);
+int    _gene_pool_init_fitness(struct gene_pool *pool);
+void   _gene_pool_free_fitness(struct gene_pool *pool);
+void   _gene_pool_island_fitness_p(struct devol_controller *controller,
+				   int island, int start, int stop);
+void   _gene_pool_merge_fitness(struct gene_pool *pool);
+int    _gene_pool_migrants(struct gene_pool *pool);
+int    _gene_pool_init_migration(struct gene_pool *pool);
+void   _gene_pool_free_migration(struct gene_pool *pool);
+void   _gene_pool_migrate_send_p(struct devol_controller *controller,
+				 int island);
+void   _gene_pool_migrate_pull_p(struct devol_controller *controller,
+				 int island, int start, int stop);
+void   _gene_pool_migrate_plan(struct gene_pool *pool);
+int    _gene_pool_init_islands(struct gene_pool *pool);
+void   _gene_pool_free_islands(struct gene_pool *pool);
+void   _gene_pool_set_islands(struct gene_pool *pool);
+void   _gene_pool_island_rates(struct gene_pool *pool, int island,
+			       double *reproduction_rate,
+			       double *breed_fitness);
+void   _gene_pool_island_bounds(struct gene_pool *pool, int island,
+				int *start, int *stop);
+void   _gene_pool_evolve_island_p(struct devol_controller *controller,
+				  int island);
+void   _gene_pool_evaluate_list_p(struct devol_controller *controller,
+				  solution_t **list, int count);
+void   _gene_pool_breed_p(struct devol_controller *controller,
+			  int start, int stop,
+			  int new_count, int breeder_window);
+int    _gene_pool_breed_one_p(struct devol_controller *controller,
+			      int start, int stop, int i, int breeder_window);
+void   _devol_split_islands(struct devol_controller *controllers, int count,
+			    struct gene_pool *gene_pool, int solutions);
+int    _gene_pool_iterate_mp(struct gene_pool *pool);
+int    _gene_pool_iterate_pipeline(struct gene_pool *pool);
+int    _gene_pool_init_arenas(struct gene_pool *pool,
+			      struct devol_controller *controllers, int count);
+int    _gene_pool_init_batches(struct gene_pool *pool,
+			       struct devol_controller *controllers, int count);
+void   _gene_pool_free_batches(struct devol_controller *controllers,
+			       int count);
+void  *_gene_pool_alloc(struct gene_pool *pool, size_t size);
+void   _gene_pool_free(struct gene_pool *pool, void *ptr);
 
 #endif
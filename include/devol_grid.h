@@ -1,8 +1,13 @@
 /*
- * Header for the grid evolutionary computing constructs.
+ * Header for the grid evolutionary computing constructs. See grid.c for how
+ * the pieces fit together.
  */
 
+#include <devol.h>
+
+#include <stdint.h>
 #include <pthread.h>
+#include <sys/types.h>
 
 #include <netinet/in.h>
 
@@ -26,6 +31,9 @@ struct grid_node {
   /* A lock to make sure access to a node is synchronous. */
   pthread_mutex_t node_lock;
 
+  /* The process behind the node if we started it ourselves, else 0. */
+  pid_t pid;
+
 };
 
 #define DEVOL_GRID_NOEXT    0x0      /* There is no host. */
@@ -49,7 +57,204 @@ struct grid_queue {
   /* A file conatining a list of nodes to connect to. */
   char *node_list;
 
+  /* Where the coordinator listens for nodes. */
+  int fd;
+
+};
+
+/*
+ * Messages. Every message is a struct grid_msg followed by length bytes.
+ * Nodes are assumed to share a byte order and struct layout; they are
+ * normally the same program anyway.
+ */
+#define GRID_MSG_HELLO     1   /* Node to coordinator: the port it listens on
+				  (a uint32_t). */
+#define GRID_MSG_SETUP     2   /* Coordinator to node: struct grid_setup. */
+#define GRID_MSG_MIGRANTS  3   /* Node to the next node: a batch of
+				  migrants, each a double fitness followed by
+				  the packed solution. */
+#define GRID_MSG_BYE       4   /* Node to the next node: no more migrants. */
+#define GRID_MSG_STATS     5   /* Node to coordinator: struct grid_stats. */
+#define GRID_MSG_EVAL      6   /* Engine to fitness server: struct grid_eval
+				  then the packed solutions. */
+#define GRID_MSG_FITNESS   7   /* Fitness server to engine: struct grid_eval
+				  then a double per solution. */
+
+struct grid_msg {
+
+  uint32_t type;
+  uint32_t length;
+
+};
+
+/*
+ * Where a node stands in the ring and who it sends its migrants to. The
+ * address is in network byte order.
+ */
+struct grid_setup {
+
+  uint32_t rank;
+  uint32_t count;
+  uint32_t next_addr;
+  uint32_t next_port;
+
+};
+
+/*
+ * The head of a batch to or from a fitness server. Servers answer batches in
+ * the order they get them.
+ */
+struct grid_eval {
+
+  uint32_t batch;
+  uint32_t count;
+
+};
+
+/*
+ * What each node tells the coordinator when it is done.
+ */
+struct grid_stats {
+
+  uint32_t rank;
+  uint32_t generations;
+  uint64_t evaluations;
+  uint64_t ns;
+
+  /* Migrants sent, received and taken into the population, and those lost
+   * because a queue was full. */
+  uint64_t sent;
+  uint64_t received;
+  uint64_t accepted;
+  uint64_t dropped;
+
+  double   best;
+  double   mean;
+
+};
+
+/*
+ * How a node migrates. Every interval generations the node sends copies of
+ * its migrants best solutions to the next node in the ring and takes in
+ * whatever the previous node has sent, in place of its worst solutions.
+ *
+ * Solutions travel as their genome (devol_params.genome_size bytes) or, with
+ * no genome_size, their private union. A problem whose solutions do not
+ * survive being copied byte for byte (pointers, say) sets pack() and
+ * unpack() and the size of what they write.
+ */
+struct grid_params {
+
+  int      migrants;
+  int      interval;
+
+  size_t   packed_size;
+  void   (*pack)(solution_t *solution, void *buf);
+  void   (*unpack)(solution_t *solution, const void *buf);
+
+};
+
+/* A batch of migrants on its way in or out. */
+struct grid_batch {
+
+  struct grid_batch *next;
+  struct grid_msg    msg;
+  char               data[];
+
+};
+
+/*
+ * One node of the grid: a gene pool and its two neighbours in the ring. Two
+ * threads do the network work so that the gene pool never waits on it: one
+ * sends the outbox to the next node, the other fills the inbox from the
+ * previous node.
+ */
+struct grid_peer {
+
+  struct gene_pool   *pool;
+  struct grid_params  params;
+
+  int                 rank;
+  int                 count;
+  int                 listen_fd;
+  struct grid_node    coordinator;
+  struct grid_node    next;
+  struct grid_node    prev;
+
+  pthread_t           sender;
+  pthread_t           receiver;
+  pthread_mutex_t     lock;
+  pthread_cond_t      cond;
+  struct grid_batch  *outbox;
+  struct grid_batch  *inbox;
+  int                 out_len;
+  int                 in_len;
+  int                 prev_done;
+
+  struct grid_stats   stats;
+  uint64_t            started;
+
+};
+
+/*
+ * Remote fitness evaluation; see grid_fitness.c. The servers are the nodes of
+ * a grid_queue. The first part is set by the program: solutions per batch,
+ * batches each server may have on the go, and how to pack a solution (see
+ * struct grid_params). The rest is filled in by grid_fitness_init().
+ */
+struct grid_fitness {
+
+  int      batch;
+  int      depth;
+  size_t   packed_size;
+  void   (*pack)(solution_t *solution, void *buf);
+  void   (*unpack)(solution_t *solution, const void *buf);
+
+  struct grid_queue *queue;
+  size_t   genome_size;
+  double (*fitness)(solution_t *solution);
+
+  /* Batches sent and solutions evaluated remotely, and the solutions that
+   * had to be evaluated here because their server went away. */
+  volatile uint64_t batches;
+  volatile uint64_t remote;
+  volatile uint64_t local;
+
+  /* Where the next search for a free server starts. */
+  volatile uint32_t next;
+
 };
 
+/* The coordinator. */
+int  grid_listen(struct grid_queue *queue, int port);
+int  grid_coordinate(struct grid_queue *queue, int nodes,
+		     struct grid_stats *stats);
+void grid_print_stats(struct grid_stats *stats, int nodes, FILE *out);
+
+/* The nodes. */
+int  grid_join(struct grid_peer *peer, struct gene_pool *pool,
+	       struct grid_params *params, const char *host, int port);
+int  grid_migrate(struct grid_peer *peer);
+int  grid_leave(struct grid_peer *peer);
+
+/* Fitness servers. */
+int  grid_fitness_init(struct grid_fitness *fit, struct grid_queue *queue,
+		       struct devol_params *params);
+int  grid_fitness_spawn(struct grid_queue *queue, int servers,
+			struct grid_fitness *fit);
+int  grid_fitness_connect(struct grid_queue *queue, const char *host,
+			  int port);
+int  grid_fitness_serve(int fd, struct grid_fitness *fit);
+int  grid_fitness_listen(int port, struct grid_fitness *fit);
+void grid_fitness_stop(struct grid_queue *queue);
+int  grid_evaluate(solution_t **solutions, int count, void *arg);
+
+/* Socket plumbing shared by the grid code. */
+int  _grid_write_all(int fd, const void *buf, size_t len);
+int  _grid_read_all(int fd, void *buf, size_t len);
+int  _grid_send(int fd, uint32_t type, const void *buf, uint32_t len);
+int  _grid_expect(int fd, uint32_t type, void *buf, uint32_t len);
+int  _grid_connect(struct sockaddr_in *addr);
+
 
 #endif
@@ -7,9 +7,15 @@
 #define _DEVOL_THREADS_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <pthread.h>
 
 struct thread_pool;
+struct devol_arena;
+struct devol_perf;
+struct devol_trace;
+struct devol_async;
+struct solution;
 
 /*
  * Since this struct will be getting a *lot* of concurrent access (possibly),
@@ -26,15 +32,18 @@ struct devol_controller {
   int start;
   int stop;
 
+  /* The islands that make up the block: island_start up to island_stop. */
+  int island_start;
+  int island_stop;
+
   /* The thread's state. */
-  int state;
+  volatile int state;
 
   /* Set this flag to have the thread terminate conpletely (pthread_exit). */
-  int die;
+  volatile int die;
 
-  /* State information for the erand48_r function. */
-  unsigned short rstate[3];
-  rdata_t        rdata;
+  /* This controller's random number stream. */
+  struct devol_rng rng;
 
   /* A pointer back to the thread_pool struct so we can lock against the
    * sync_lock. */
@@ -43,14 +52,35 @@ struct devol_controller {
   /* And also a pointer back to the gene pool for obvious reasons. */
   struct gene_pool *gene_pool;
 
+  /* Where this controller's genome slots come from (may be NULL). */
+  struct devol_arena *arena;
+
+  /* When the thread finished its work for the generation; the barrier wait
+   * is charged from here. And the stats themselves. */
+  uint64_t           work_end;
+  struct devol_stats stats;
+
+  /* Hardware counters for this thread, if asked for and available. */
+  struct devol_perf *perf;
+
+  /* Where this thread's trace events go, if tracing. */
+  struct devol_trace *trace;
+
+  /* Where this thread's asynchronous evaluations report back to; made the
+   * first time it is needed. */
+  struct devol_async *async;
+
+  /* Room to list the solutions of one of this thread's islands for
+   * params.evaluate(); see _gene_pool_init_batches(). */
+  struct solution **batch;
 
-  /* Pad this struct out so that it is exactly 128 bytes. */
+  /* Pad this struct out so that it is exactly 256 bytes. */
 #ifdef __x86_64__
-  char __padding[52]; /* I can't imagine cache lines > 128 bytes. */
+  char __padding[16]; /* I can't imagine cache lines > 128 bytes. */
 #elif __sun__
-  char __padding[64]; /* I really hate sun os. */
+  char __padding[56]; /* I really hate sun os. */
 #else
-  char __padding[68];
+  char __padding[48];
 #endif
 
 };
@@ -69,7 +99,7 @@ struct thread_pool {
   
   /* A flag to mark whether the thread_pool has finished processing the release
    * of the threads and is ready for threads to start terminating. */
-  int term_ready;
+  volatile int term_ready;
 
 };
 
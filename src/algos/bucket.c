@@ -1,25 +1,43 @@
 /*
  * This is a very specific implementation of a memory allocator. The goal is to
  * take an initial memory space and break it up into blocks. These blocks can
- * then be allocated out as necessary. This requires three things: A) you know
- * exactly how big each block must be, B) you know exactly how many blocks you
- * need at most, and C) each block *must* be the same size. Given these
- * constraints, the allocator can be made to be A) multithread safe without
- * requiring any locking, B) concurrent, and C) fast, D) simple. These are all
- * very good things. Yay.
+ * then be allocated out as necessary. This requires two things: A) you know
+ * exactly how big each block must be, and B) each block *must* be the same
+ * size. Given these constraints, the allocator can be made to be A) multithread
+ * safe without requiring any locking, B) concurrent, and C) fast, D) simple.
+ * These are all very good things. Yay.
+ *
+ * Each bucket keeps a list of free blocks threaded through the blocks
+ * themselves, plus a bump cursor into the newest slab for blocks that have
+ * never been handed out. An allocation pops the list or bumps the cursor, a
+ * free pushes onto the list; both are O(1). When a bucket runs out it grows
+ * by another slab, twice as big as the last one, so the number of blocks
+ * passed in at init time is a hint rather than a hard limit.
+ *
+ * Blocks do not have to be freed by the thread that allocated them, nor does
+ * the caller have to know which bucket a block came from: the owner is found
+ * from the block's address, with a range check for the initial slabs and a
+ * lookup of the block's chunk for grown ones. That lets the users of this
+ * allocator move blocks between threads freely (e.g swap pointers during gene
+ * dispersal).
  */
 
 #include <mixture.h>
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
 /* Definitions for local functions. */
-void _twiddle_block_bit(struct bucket *bkt, unsigned int offset);
+int _bucket_grow(struct bucket *bkt);
+struct bucket *_bucket_owner(struct bucket_table *tbl, void *ptr);
+
+/* Free blocks store the address of the next free block in their first word. */
+#define NEXT_FREE(BLOCK)	(*(void **)(BLOCK))
 
-/* A useful macro to read a bit from a position in 32 bits. */
-#define READ_BIT(BLOCK, OFFSET)	((BLOCK & (1<<OFFSET)) >> OFFSET)
+#define CHUNK_SIZE	((size_t)1 << BUCKET_CHUNK_SHIFT)
+#define CHUNK_OF(PTR)	((uintptr_t)(PTR) >> BUCKET_CHUNK_SHIFT)
 
 /*
  * Initialize a bucket allocator with the given parameters. Allocate out all
@@ -29,7 +47,20 @@ int init_bucket_allocator(struct bucket_table *tbl, int buckets,
 			   size_t block_size, size_t elems){
 
   int i;
-  int alloc_tbl_len;
+  struct bucket *bkt;
+
+  /* Each free block has to be able to hold a pointer to the next free block,
+   * and blocks should stay pointer aligned. */
+  if ( block_size < sizeof(void *) )
+    block_size = sizeof(void *);
+  if ( block_size % sizeof(void *) )
+    block_size += sizeof(void *) - (block_size % sizeof(void *));
+  if ( elems < 1 )
+    elems = 1;
+
+  /* Chunks record their bucket in an unsigned short. */
+  if ( buckets < 1 || buckets >= 0xffff )
+    return -1;
 
   tbl->bucket_count = buckets;
   tbl->block_size = block_size;
@@ -38,42 +69,42 @@ int init_bucket_allocator(struct bucket_table *tbl, int buckets,
   tbl->buckets = (struct bucket *)malloc(sizeof(struct bucket) * buckets);
   if ( ! tbl->buckets )
     return -1;
+  memset(tbl->buckets, 0, sizeof(struct bucket) * buckets);
 
   tbl->base = malloc(buckets * block_size * elems);
   if ( ! tbl->base ){
     free(tbl->buckets);
     return -1;
   }
+  tbl->base_end = (char *)tbl->base + (buckets * block_size * elems);
 
-  /* Compute the number of uint32_t's to hold enough bits so that each bit
-   * represents whether or not a block has been allocated. Zer out the table
-   * since obviously nothing has been allocated yet. */
-  alloc_tbl_len = elems / 32;
-  if ( elems % 32 )
-    alloc_tbl_len++;
-  tbl->alloc_tables = (uint32_t *)malloc(4 * alloc_tbl_len * buckets);
-  if ( ! tbl->alloc_tables ){
+  /* The top level of the chunk index. Leaves come as slabs need them. */
+  tbl->chunk_index = (unsigned short * volatile *)
+    malloc(sizeof(unsigned short *) << BUCKET_ROOT_BITS);
+  if ( ! tbl->chunk_index ){
     free(tbl->buckets);
     free(tbl->base);
     return -1;
   }
-  memset(tbl->alloc_tables, 0, 4 * alloc_tbl_len * buckets);
+  memset((void *)tbl->chunk_index, 0,
+	 sizeof(unsigned short *) << BUCKET_ROOT_BITS);
 
-  /* OK, we have some memory. Compute the address of each buckets memory space
-   * and the required memory for holding the bucket tracking bits. */
+  /* OK, we have some memory. Hand each bucket its first slab. Nothing is
+   * touched yet; blocks are carved off with the bump cursor as needed. */
   for ( i = 0; i < buckets; i++){
 
-    tbl->buckets[i].base_addr = tbl->base + (i * block_size * elems);
-    tbl->buckets[i].alloc_table = tbl->alloc_tables + (i * alloc_tbl_len);
-    tbl->buckets[i].elems = elems;
-    tbl->buckets[i].tbl = tbl;
-
-    /*
-    printf("# table %2d: elems=%lu base=%p alloc_table=%p (len=%d)\n",
-	   i, tbl->buckets[i].elems,
-	   tbl->buckets[i].base_addr, tbl->buckets[i].alloc_table,
-	   alloc_tbl_len);
-    */
+    bkt = &tbl->buckets[i];
+    bkt->cursor = (char *)tbl->base + (i * block_size * elems);
+    bkt->limit = bkt->cursor + (block_size * elems);
+    bkt->free_list = NULL;
+    bkt->claimed = 0;
+    bkt->remote_free = NULL;
+    bkt->elems = elems;
+    bkt->slabs = NULL;
+    bkt->slab_count = 1;
+    bkt->id = i;
+    bkt->tbl = tbl;
+
   }
   tbl->elems_per_bkt = elems;
 
@@ -82,22 +113,109 @@ int init_bucket_allocator(struct bucket_table *tbl, int buckets,
 }
 
 /*
- * Flip a bit in the passed bkt allocation table.
+ * Release everything the table holds. Any blocks still allocated out are
+ * invalid after this.
+ */
+void destroy_bucket_allocator(struct bucket_table *tbl){
+
+  int i;
+  struct bucket_slab *slab, *next;
+
+  for ( i = 0; i < tbl->bucket_count; i++){
+    for ( slab = tbl->buckets[i].slabs; slab; slab = next ){
+      next = slab->next;
+      free(slab);
+    }
+  }
+
+  for ( i = 0; i < (1 << BUCKET_ROOT_BITS); i++)
+    free(tbl->chunk_index[i]);
+  free((void *)tbl->chunk_index);
+  free(tbl->base);
+  free(tbl->buckets);
+
+}
+
+/*
+ * Mark the chunks from start up to end as belonging to bucket id. Only the
+ * leaves are ever shared, and two threads racing to make the same one just
+ * means one of them throws its copy away.
  */
-void _twiddle_block_bit(struct bucket *bkt, unsigned int offset){
+static int _bucket_index(struct bucket_table *tbl, char *start, char *end,
+			 int id){
+
+  uintptr_t c, root;
+  unsigned short *leaf;
+
+  for ( c = CHUNK_OF(start); c < CHUNK_OF(end - 1) + 1; c++){
+
+    root = c >> BUCKET_LEAF_BITS;
+    if ( root >> BUCKET_ROOT_BITS )
+      return -1;
 
-  unsigned int block;
-  unsigned int bit;
-  uint32_t position;
-  uint32_t *tbl;
+    if ( ! tbl->chunk_index[root] ){
+      leaf = (unsigned short *)
+	malloc(sizeof(unsigned short) << BUCKET_LEAF_BITS);
+      if ( ! leaf )
+	return -1;
+      memset(leaf, 0, sizeof(unsigned short) << BUCKET_LEAF_BITS);
+      if ( ! __sync_bool_compare_and_swap(&tbl->chunk_index[root], NULL, leaf) )
+	free(leaf);
+    }
 
-  block = offset / 32; /* Gets us which uint32_t we will find our bit in. */
-  bit = offset % 32; /* The bit position on the uint32_t. */
-  position = (1<<bit); /* A 1 in the position of our bit. */
-  tbl = &(bkt->alloc_table[block]);
+    tbl->chunk_index[root][c & ((1 << BUCKET_LEAF_BITS) - 1)] = id + 1;
 
-  /* And the twiddle. */
-  *tbl = ((*tbl & ~position) | position) & ~(*tbl & position);
+  }
+
+  return 0;
+
+}
+
+/*
+ * Give a bucket another slab to carve blocks out of. Each new slab is as big
+ * as everything the bucket already owns so the number of slabs stays
+ * logarithmic in the peak number of blocks. Slabs are whole chunks so no two
+ * buckets ever share one.
+ */
+int _bucket_grow(struct bucket *bkt){
+
+  size_t elems = bkt->elems;
+  size_t block_size = bkt->tbl->block_size;
+  size_t size;
+  void *mem;
+  struct bucket_slab *slab;
+
+  if ( bkt->slab_count > BUCKET_MAX_GROWTH )
+    return -1;
+
+  /* Put the slab header in front of the blocks; round it up so the first
+   * block stays aligned. */
+  size = sizeof(struct bucket_slab) + 16 + (elems * block_size);
+  size = (size + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+  if ( posix_memalign(&mem, CHUNK_SIZE, size) )
+    return -1;
+  slab = (struct bucket_slab *)mem;
+
+  /* The slab has to be findable before any of its blocks are handed out. */
+  if ( _bucket_index(bkt->tbl, (char *)mem, (char *)mem + size, bkt->id) ){
+    free(mem);
+    return -1;
+  }
+  __sync_synchronize();
+
+  slab->base_addr = (char *)slab +
+    ((sizeof(struct bucket_slab) + 15) & ~((size_t)15));
+  slab->elems = elems;
+  slab->bucket = bkt->id;
+  slab->next = bkt->slabs;
+  bkt->slabs = slab;
+  bkt->slab_count++;
+
+  bkt->cursor = slab->base_addr;
+  bkt->limit = bkt->cursor + (elems * block_size);
+  bkt->elems += elems;
+
+  return 0;
 
 }
 
@@ -106,30 +224,41 @@ void _twiddle_block_bit(struct bucket *bkt, unsigned int offset){
  */
 void *_balloc(struct bucket *bkt){
 
-  int idx = 0;
-  int bit_offset = 0;
   void *addr;
 
-  /* Search for the first non-0xFFFFFFFF uint32_t in the allocation table. This
-   * is where our first available block should be. */
-  while ( bkt->alloc_table[idx] == 0xFFFFFFFF ) idx++;
+  /* The first thread to allocate from a bucket owns it for good; nobody
+   * else may touch free_list or the cursor. */
+  if ( bkt->claimed != 2 &&
+       __sync_bool_compare_and_swap(&bkt->claimed, 0, 1) ){
+    bkt->owner = pthread_self();
+    __sync_synchronize();
+    bkt->claimed = 2;
+  }
+  if ( bkt->claimed != 2 || ! pthread_equal(bkt->owner, pthread_self()) )
+    return NULL;
 
-  /* Now find the first non-zero bit. */
-  while ( bit_offset < 32 ){
-    if ( ! READ_BIT(bkt->alloc_table[idx], bit_offset) )
-      break;
-    bit_offset++;
+  /* Recycled blocks first, they are probably still warm in the cache. If
+   * we have none of our own, take over everything that has been freed back
+   * to us since we last looked. */
+  if ( ! bkt->free_list && bkt->remote_free ){
+    do {
+      addr = bkt->remote_free;
+    } while ( ! __sync_bool_compare_and_swap(&bkt->remote_free, addr, NULL) );
+    bkt->free_list = addr;
   }
 
-  /* Now we have a bit offset and a table index. Caluclate whether this bit
-   * is even in the bucket at all. */
-  if ( bit_offset + (idx * 32) >= bkt->elems )
+  if ( bkt->free_list ){
+    addr = bkt->free_list;
+    bkt->free_list = NEXT_FREE(addr);
+    return addr;
+  }
+
+  /* Then blocks that have never been handed out. */
+  if ( bkt->cursor >= bkt->limit && _bucket_grow(bkt) )
     return NULL;
 
-  /* Now compute the actual address in memory of the found block, twiddle its
-   * bit, and finally return the address of the block. */
-  addr = bkt->base_addr + ((bit_offset + (idx * 32)) * bkt->tbl->block_size);
-  _twiddle_block_bit(bkt, bit_offset + (idx * 32));
+  addr = bkt->cursor;
+  bkt->cursor += bkt->tbl->block_size;
 
   return addr;
 
@@ -146,62 +275,111 @@ void *balloc(struct bucket_table *tbl, int bucket){
 
 }
 
-void _do_bfree(struct bucket *bkt, void *ptr){
+/*
+ * Find the bucket that owns the passed block. Blocks from the initial slabs
+ * are a simple range check on the table's contiguous base memory; anything
+ * else is looked up by its chunk. Either way it is O(1).
+ */
+struct bucket *_bucket_owner(struct bucket_table *tbl, void *ptr){
 
-  int block;
-  unsigned long int base, addr;
-  unsigned long int offset;
-
-  /* Given the ptr, we must figure out what block it points to. Then make sure
-   * that block is set to free. If the ptr doesn't point to anything just
-   * silently fail. */
-  
-  base = (unsigned long int) bkt->base_addr;
-  addr = (unsigned long int) ptr;
-  offset = addr - base;
-  
-  if ( offset % bkt->tbl->block_size != 0 )
-    return;
+  uintptr_t c = CHUNK_OF(ptr);
+  size_t bkt_size;
+  unsigned short *leaf;
 
-  /* This is the bit index into the allocation table. */
-  block = offset / bkt->tbl->block_size;
-  
-  /* If that bit is set, then twiddle it, otherwise just return. */
-  if ( READ_BIT(bkt->alloc_table[block / 32], block % 32) )
-    _twiddle_block_bit(bkt, block);
-}
+  if ( (char *)ptr >= (char *)tbl->base && (char *)ptr < (char *)tbl->base_end){
+    if ( tbl->bucket_count == 1 )
+      return tbl->buckets;
+    bkt_size = tbl->block_size * tbl->elems_per_bkt;
+    return &tbl->buckets[((char *)ptr - (char *)tbl->base) / bkt_size];
+  }
 
-void bfree(struct bucket_table *tbl, int bucket, void *ptr){
+  if ( (c >> BUCKET_LEAF_BITS) >> BUCKET_ROOT_BITS )
+    return NULL;
+  leaf = tbl->chunk_index[c >> BUCKET_LEAF_BITS];
+  if ( ! leaf || ! leaf[c & ((1 << BUCKET_LEAF_BITS) - 1)] )
+    return NULL;
 
-  /* Pass this call on to the corrent bucket. */
-  _do_bfree(&tbl->buckets[bucket], ptr);
+  return &tbl->buckets[leaf[c & ((1 << BUCKET_LEAF_BITS) - 1)] - 1];
 
 }
 
 /*
- * Print out the allocation table for a given bucket.
+ * Return the id of the bucket that owns ptr, or -1 if it did not come from
+ * this table.
  */
-void _do_display_bucket(struct bucket *bkt){
+int bowner(struct bucket_table *tbl, void *ptr){
 
-  printf("#  Allocation table:");
+  struct bucket *bkt = _bucket_owner(tbl, ptr);
 
-  int bit = 0;
+  return bkt ? bkt->id : -1;
 
-  while ( bit < bkt->elems ){
+}
 
-    if ( bit % 32 == 0 ) /* New line time. */
-      printf("\n#   %6d", bit);
+void _do_bfree(struct bucket *bkt, void *ptr){
 
-    if ( bit % 8 == 0 ) /* Space for readability */
-      printf(" ");
+  void *head;
 
-    /* Now finally, print the bit. */
-    printf("%c", READ_BIT(bkt->alloc_table[bit / 32], bit % 32) ? '1' : '0');
+  /* The owner can put the block right back on its own list. */
+  if ( bkt->claimed == 2 && pthread_equal(bkt->owner, pthread_self()) ){
+    NEXT_FREE(ptr) = bkt->free_list;
+    bkt->free_list = ptr;
+    return;
+  }
 
-    bit++;
+  /* Anyone else has to go through the shared list. */
+  do {
+    head = bkt->remote_free;
+    NEXT_FREE(ptr) = head;
+  } while ( ! __sync_bool_compare_and_swap(&bkt->remote_free, head, ptr) );
 
-  }
-  printf("\n");
+}
+
+void bfree(struct bucket_table *tbl, void *ptr){
+
+  struct bucket *bkt;
+
+  /* Freeing NULL is just silently ignored, like free(). So is anything that
+   * isn't ours. */
+  if ( ! ptr )
+    return;
+
+  bkt = _bucket_owner(tbl, ptr);
+  if ( ! bkt )
+    return;
+
+  /* Pass this call on to the correct bucket. */
+  _do_bfree(bkt, ptr);
+
+}
+
+/*
+ * Print out the allocation state of a given bucket.
+ */
+void _do_display_bucket(struct bucket *bkt){
+
+  int i = 0;
+  size_t free_blocks = 0;
+  size_t carved;
+  void *block;
+  struct bucket_slab *slab;
+
+  /* Anything on either free list plus anything past the cursor is free. This
+   * walks the lists, so only do it when no one is using the bucket. */
+  for ( block = bkt->free_list; block; block = NEXT_FREE(block) )
+    free_blocks++;
+  for ( block = bkt->remote_free; block; block = NEXT_FREE(block) )
+    free_blocks++;
+  carved = bkt->elems - ((bkt->limit - bkt->cursor) / bkt->tbl->block_size);
+
+  printf("#  Blocks: %lu allocated, %lu total\n",
+	 (unsigned long)(carved - free_blocks), (unsigned long)bkt->elems);
+  printf("#  Slabs: %d\n", bkt->slab_count);
+
+  /* The initial slab lives in the table's base memory, so only the grown
+   * slabs are on the list. */
+  for ( slab = bkt->slabs; slab; slab = slab->next )
+    printf("#   slab %2d: base=%p elems=%lu\n", i++, slab->base_addr,
+	   (unsigned long)slab->elems);
 
 }
 
@@ -218,7 +396,7 @@ void _display_buckets(struct bucket_table *tbl, int print_alloc_tables){
   printf("#  Block size: %u\n", (unsigned int)tbl->block_size);
   printf("#  Blocks per bucket: %d\n", tbl->elems_per_bkt);
   printf("#  Bucket table address: %p\n", tbl->buckets);
-  printf("#  Allocation table address: %p\n", tbl->alloc_tables);
+  printf("#  Base address: %p\n", tbl->base);
 
   if ( ! print_alloc_tables )
     return;
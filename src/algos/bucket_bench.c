@@ -0,0 +1,337 @@
+/*
+ * Micro benchmark for the bucket allocator. Replays the allocation pattern
+ * the mixture program generates and compares the current bucket allocator
+ * against the old bitmap allocator and plain malloc().
+ *
+ * Each thread owns pop-size/threads solutions. Every generation it breeds
+ * rep-rate * (pop-size/threads) children; each child allocates a solution
+ * struct and a parameter block, then some random member of the population is
+ * killed and its two blocks are freed. That is what init() and destroy() in
+ * mixture.c did back when mixture managed its own genome memory.
+ *
+ * Usage:
+ *
+ *   ./bucket_bench [pop-size] [threads] [generations] [rep-rate] [norms]
+ */
+
+#include <mixture.h>
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * The original bitmap allocator, kept here so we have something to compare
+ * against. It scans the allocation table a word and then a bit at a time and
+ * cannot grow.
+ */
+struct legacy_bucket {
+  void     *base_addr;
+  uint32_t *alloc_table;
+  size_t    elems;
+  size_t    block_size;
+};
+
+#define READ_BIT(BLOCK, OFFSET)	((BLOCK & (1<<OFFSET)) >> OFFSET)
+
+static void _legacy_twiddle(struct legacy_bucket *bkt, unsigned int offset){
+
+  uint32_t position = (1 << (offset % 32));
+  uint32_t *tbl = &(bkt->alloc_table[offset / 32]);
+
+  *tbl = ((*tbl & ~position) | position) & ~(*tbl & position);
+
+}
+
+static int legacy_init(struct legacy_bucket *bkt, size_t block_size,
+		       size_t elems){
+
+  size_t words = (elems / 32) + 1;
+
+  bkt->base_addr = malloc(block_size * elems);
+  bkt->alloc_table = (uint32_t *)malloc(4 * words);
+  if ( ! bkt->base_addr || ! bkt->alloc_table )
+    return -1;
+  memset(bkt->alloc_table, 0, 4 * words);
+  bkt->elems = elems;
+  bkt->block_size = block_size;
+
+  return 0;
+
+}
+
+static void *legacy_alloc(struct legacy_bucket *bkt){
+
+  int idx = 0;
+  int bit_offset = 0;
+
+  while ( bkt->alloc_table[idx] == 0xFFFFFFFF ) idx++;
+  while ( bit_offset < 32 ){
+    if ( ! READ_BIT(bkt->alloc_table[idx], bit_offset) )
+      break;
+    bit_offset++;
+  }
+  if ( bit_offset + (idx * 32) >= bkt->elems )
+    return NULL;
+
+  _legacy_twiddle(bkt, bit_offset + (idx * 32));
+  return (char *)bkt->base_addr +
+    ((bit_offset + (idx * 32)) * bkt->block_size);
+
+}
+
+static void legacy_free(struct legacy_bucket *bkt, void *ptr){
+
+  unsigned long offset = (char *)ptr - (char *)bkt->base_addr;
+  unsigned long block = offset / bkt->block_size;
+
+  if ( READ_BIT(bkt->alloc_table[block / 32], block % 32) )
+    _legacy_twiddle(bkt, block);
+
+}
+
+/*
+ * The three allocators under test.
+ */
+#define ALLOC_BUCKET  0
+#define ALLOC_LEGACY  1
+#define ALLOC_MALLOC  2
+
+char *alloc_names[] = { "bucket", "legacy", "malloc" };
+
+int    pop_size = 10000;
+int    threads = 1;
+int    generations = 1000;
+double rrate = .25;
+int    norms_len = 2;
+
+/*
+ * The solution struct mixture.c allocated back then, when its parameters
+ * lived in a block of their own.
+ */
+struct bench_solution {
+  double *mu;
+  double *sigma;
+  double *prob;
+  int     len;
+  int     solved;
+  double  mle;
+};
+
+struct bucket_table   sol_tbl, param_tbl;
+struct legacy_bucket *legacy_sols, *legacy_params;
+
+struct bench_thread {
+  pthread_t thread;
+  int       tid;
+  int       allocator;
+  int       failed;
+};
+
+static void *_alloc(int allocator, int tid, int param){
+
+  size_t size = param ? sizeof(double) * 3 * norms_len :
+    sizeof(struct bench_solution);
+
+  switch ( allocator ){
+  case ALLOC_BUCKET:
+    return balloc(param ? &param_tbl : &sol_tbl, tid);
+  case ALLOC_LEGACY:
+    return legacy_alloc(param ? &legacy_params[tid] : &legacy_sols[tid]);
+  default:
+    return malloc(size);
+  }
+
+}
+
+static void _free(int allocator, int tid, int param, void *ptr){
+
+  switch ( allocator ){
+  case ALLOC_BUCKET:
+    bfree(param ? &param_tbl : &sol_tbl, ptr);
+    break;
+  case ALLOC_LEGACY:
+    legacy_free(param ? &legacy_params[tid] : &legacy_sols[tid], ptr);
+    break;
+  default:
+    free(ptr);
+  }
+
+}
+
+/*
+ * Replay the mixture allocation pattern for one thread.
+ */
+void *bench_main(void *data){
+
+  int i, g, victim;
+  int block = pop_size / threads;
+  int children = (int)(rrate * block);
+  unsigned short rstate[3];
+  struct bench_solution *sol;
+  struct bench_solution **live;
+  struct bench_thread *bt = (struct bench_thread *)data;
+
+  rstate[0] = 7;
+  rstate[1] = 20 + bt->tid;
+  rstate[2] = 1969;
+
+  live = (struct bench_solution **)malloc(sizeof(*live) * block);
+  if ( ! live ){
+    bt->failed = 1;
+    return NULL;
+  }
+
+  /* The initial population. */
+  for ( i = 0; i < block; i++){
+    live[i] = _alloc(bt->allocator, bt->tid, 0);
+    if ( ! live[i] ){
+      bt->failed = 1;
+      return NULL;
+    }
+    live[i]->mu = _alloc(bt->allocator, bt->tid, 1);
+    live[i]->mu[0] = 0.0;
+  }
+
+  for ( g = 0; g < generations; g++){
+    for ( i = 0; i < children; i++){
+
+      /* Breed... */
+      sol = _alloc(bt->allocator, bt->tid, 0);
+      if ( ! sol ){
+	bt->failed = 1;
+	return NULL;
+      }
+      sol->mu = _alloc(bt->allocator, bt->tid, 1);
+      if ( ! sol->mu ){
+	bt->failed = 1;
+	return NULL;
+      }
+      sol->mu[0] = (double)i;
+
+      /* ...and kill. */
+      victim = nrand48(rstate) % block;
+      _free(bt->allocator, bt->tid, 1, live[victim]->mu);
+      _free(bt->allocator, bt->tid, 0, live[victim]);
+      live[victim] = sol;
+
+    }
+  }
+
+  for ( i = 0; i < block; i++){
+    _free(bt->allocator, bt->tid, 1, live[i]->mu);
+    _free(bt->allocator, bt->tid, 0, live[i]);
+  }
+  free(live);
+
+  return NULL;
+
+}
+
+/*
+ * Run one allocator and return the time it took in nanoseconds, or -1 if it
+ * ran out of memory.
+ */
+double run_bench(int allocator){
+
+  int i, failed = 0;
+  int blocks;
+  struct timespec t_start, t_stop;
+  struct bench_thread *bts;
+
+  /* Size everything the same way mixture.c does. */
+  blocks = rrate * pop_size;
+  blocks *= 2;
+  blocks += pop_size;
+  blocks /= threads;
+
+  if ( allocator == ALLOC_BUCKET ){
+    init_bucket_allocator(&sol_tbl, threads,
+			  sizeof(struct bench_solution), blocks);
+    init_bucket_allocator(&param_tbl, threads,
+			  sizeof(double) * 3 * norms_len, blocks);
+  } else if ( allocator == ALLOC_LEGACY ){
+    legacy_sols = malloc(sizeof(struct legacy_bucket) * threads);
+    legacy_params = malloc(sizeof(struct legacy_bucket) * threads);
+    for ( i = 0; i < threads; i++){
+      legacy_init(&legacy_sols[i], sizeof(struct bench_solution), blocks);
+      legacy_init(&legacy_params[i], sizeof(double) * 3 * norms_len, blocks);
+    }
+  }
+
+  bts = (struct bench_thread *)malloc(sizeof(struct bench_thread) * threads);
+  memset(bts, 0, sizeof(struct bench_thread) * threads);
+
+  clock_gettime(CLOCK_MONOTONIC, &t_start);
+  for ( i = 0; i < threads; i++){
+    bts[i].tid = i;
+    bts[i].allocator = allocator;
+    pthread_create(&bts[i].thread, NULL, bench_main, &bts[i]);
+  }
+  for ( i = 0; i < threads; i++){
+    pthread_join(bts[i].thread, NULL);
+    failed |= bts[i].failed;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t_stop);
+
+  if ( allocator == ALLOC_BUCKET ){
+    destroy_bucket_allocator(&sol_tbl);
+    destroy_bucket_allocator(&param_tbl);
+  } else if ( allocator == ALLOC_LEGACY ){
+    for ( i = 0; i < threads; i++){
+      free(legacy_sols[i].base_addr);
+      free(legacy_sols[i].alloc_table);
+      free(legacy_params[i].base_addr);
+      free(legacy_params[i].alloc_table);
+    }
+    free(legacy_sols);
+    free(legacy_params);
+  }
+  free(bts);
+
+  if ( failed )
+    return -1;
+
+  return ((t_stop.tv_sec - t_start.tv_sec) * 1.0e9) +
+    (t_stop.tv_nsec - t_start.tv_nsec);
+
+}
+
+int main(int argc, char **argv){
+
+  int a;
+  double ns, ops;
+
+  if ( argc > 1 ) pop_size = atoi(argv[1]);
+  if ( argc > 2 ) threads = atoi(argv[2]);
+  if ( argc > 3 ) generations = atoi(argv[3]);
+  if ( argc > 4 ) rrate = atof(argv[4]);
+  if ( argc > 5 ) norms_len = atoi(argv[5]);
+
+  if ( pop_size < 1 || threads < 1 || norms_len < 1 ){
+    fprintf(stderr, "Bad parameters.\n");
+    return 1;
+  }
+
+  /* Two allocations and two frees per child, plus the initial population. */
+  ops = 4.0 * (int)(rrate * (pop_size / threads)) * generations * threads;
+  ops += 4.0 * (pop_size / threads) * threads;
+
+  printf("# pop-size=%d threads=%d generations=%d rep-rate=%lf norms=%d\n",
+	 pop_size, threads, generations, rrate, norms_len);
+  printf("# allocator      time (ms)   ns/op\n");
+  for ( a = ALLOC_BUCKET; a <= ALLOC_MALLOC; a++){
+    ns = run_bench(a);
+    if ( ns < 0 )
+      printf("  %-10s     out of memory\n", alloc_names[a]);
+    else
+      printf("  %-10s %12.2lf %8.2lf\n", alloc_names[a], ns / 1.0e6,
+	     ns / ops);
+  }
+
+  return 0;
+
+}
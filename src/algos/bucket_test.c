@@ -5,10 +5,33 @@
 #include <mixture.h>
 
 #include <stdio.h>
+#include <pthread.h>
 
 struct bucket_table tbl1;
 struct bucket_table tbl2;
 
+/*
+ * Another thread may free bucket 1's blocks, grown slabs or not, but may not
+ * allocate from it.
+ */
+void *_other_thread(void *arg){
+
+  int i;
+  void **blocks = (void **)arg;
+
+  if ( balloc(&tbl1, 1) )
+    printf("Error: allocated from another thread's bucket\n");
+
+  for ( i = 0; i < 105; i++){
+    if ( bowner(&tbl1, blocks[i]) != 1 )
+      printf("Error: block %d has owner %d\n", i, bowner(&tbl1, blocks[i]));
+    bfree(&tbl1, blocks[i]);
+  }
+
+  return NULL;
+
+}
+
 
 int main(){
 
@@ -33,17 +56,18 @@ int main(){
   printf(" a3 = %p\n", a3);
   printf(" a4 = %p\n", a4);
 
-  bfree(&tbl1, 1, a2);
-  bfree(&tbl1, 1, a3);
+  bfree(&tbl1, a2);
+  bfree(&tbl1, a3);
 
   _display_buckets(&tbl1, 1);
   a2 = balloc(&tbl1, 1);
   _display_buckets(&tbl1, 1);
   
 
-  /* This should be a little more strenuous. */
+  /* This should be a little more strenuous. Ask for more than the bucket
+   * was sized for; it should grow rather than fail. */
   int i;
-  void *tmp[100];
+  void *tmp[105];
   for ( i = 0; i < 105; i++){
     tmp[i] = balloc(&tbl1, 1);
     if ( ! tmp[i] ){
@@ -54,14 +78,19 @@ int main(){
 
   _display_buckets(&tbl1, 1);
 
-  for ( i = 0; i < 100; i++)
-    bfree(&tbl1, 1, tmp[i]);
-  bfree(&tbl1, 1, a1);
-  bfree(&tbl1, 1, a2);
-  bfree(&tbl1, 1, a4);
+  pthread_t other;
+  pthread_create(&other, NULL, _other_thread, tmp);
+  pthread_join(other, NULL);
+
+  bfree(&tbl1, a1);
+  bfree(&tbl1, a2);
+  bfree(&tbl1, a4);
 
   _display_buckets(&tbl1, 1);
 
+  destroy_bucket_allocator(&tbl1);
+  destroy_bucket_allocator(&tbl2);
+
   return 0;
 
 }
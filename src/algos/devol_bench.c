@@ -0,0 +1,751 @@
+/*
+ * Throughput benchmarks for libdeval. Runs the mixture, root finder and
+ * square root of 5 problems over a grid of parameters and writes one CSV line
+ * for each point of the grid: generations and fitness evaluations per second,
+ * averaged over several repetitions, with their standard deviations.
+ *
+ * Every list parameter takes a comma seperated list of values and every
+ * combination is run (parameters that do not apply to a problem are only run
+ * once for it). Each repetition builds a fresh gene pool, runs some untimed
+ * warmup generations and then times the rest.
+ *
+ * Relevant parameters:
+ *
+ *   problems      <p1,p2,...>          Any of mixture, root and sqrt5.
+ *   threads       <t1,t2,...>          Thread counts; 0 is the sequential
+ *                                      algorithm.
+ *   pop-size      <n1,n2,...>          Population sizes.
+ *   norms         <k1,k2,...>          Normals in the mixture (mixture only).
+ *   samples       <s1,s2,...>          Data samples (mixture only).
+ *   rep-rate      <r1,r2,...>          Reproduction rates.
+ *   breed-fitness <b1,b2,...>          Breed fitnesses.
+ *   generations   <integer>            Timed generations per repetition.
+ *   warmup        <integer>            Untimed generations first.
+ *   reps          <integer>            Repetitions of each point.
+ *   seed          <s1,s2,s3>           Seed for the random number generator.
+ *   output        <file>               Where the CSV goes (default bench.csv;
+ *                                      - for stdout, though the library's
+ *                                      INFO output ends up there too).
+ *
+ * 'make bench' runs a small default sweep and leaves the results in
+ * bench.csv at the top of the tree.
+ *
+ * With --ttq the benchmark measures time to quality instead: the square root
+ * of 5 traces in the data directory (sqrt_5_rr-*_bf-*.evol and
+ * rr=*:bf=*:var=*.txt, one line of generation and average fitness each) are
+ * replayed with fixed seeds. Each configuration runs until the average
+ * fitness of the population gets down to where its trace finished and the
+ * line reports the generations, wall time and fitness evaluations that took.
+ * If the median number of generations is more than tolerance times the
+ * trace's, the line is marked SLOWER (or MISSED if the target was never
+ * reached) and devol_bench exits non-zero. The traces do not say how big the
+ * population was, so they are compared in generations only.
+ *
+ *   ttq                                Time to quality mode.
+ *   data-dir      <dir>                Where the traces are (default
+ *                                      ../../data).
+ *   trace         <file>               Only replay this trace.
+ *   target        <double>             Average fitness to run to instead of
+ *                                      the trace's last value.
+ *   tolerance     <double>             Allowed ratio of generations to the
+ *                                      trace's (default 1.5).
+ *   max-gen       <integer>            Give up after this many generations
+ *                                      (default twice the allowed number).
+ *
+ * In this mode threads defaults to 0 and pop-size to 1000; the rr=.01
+ * trace cannot have come from a population much smaller than that since it
+ * needs a breeder window of at least 2.
+ * 'make ttq' runs it and leaves the results in ttq.csv.
+ */
+
+#include <devol.h>
+#include <mixture.h>
+#include <root_finder.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <dirent.h>
+
+#define PROBLEM_MIXTURE  0
+#define PROBLEM_ROOT     1
+#define PROBLEM_SQRT5    2
+
+char *problem_names[] = { "mixture", "root", "sqrt5" };
+
+/*
+ * The grid.
+ */
+struct list {
+  double *vals;
+  int     len;
+};
+
+struct list problems, thread_counts, pop_sizes, norm_counts, sample_counts;
+struct list rep_rates, breed_fitnesses;
+
+int generations = 50;
+int warmup = 5;
+int reps = 5;
+unsigned short seed[3] = {7, 20, 1969};
+FILE *out;
+
+/* Time to quality mode. */
+int ttq = 0;
+char *data_dir = "../../data";
+char *trace_file = NULL;
+double target = NAN;
+double tolerance = 1.5;
+int max_gen = 0;
+
+/* A stored run: the parameters from its file name and its averages. */
+struct trace {
+  char    name[256];
+  double  rr;
+  double  bf;
+  double  var;
+  double *avg;
+  int     len;
+};
+
+/* What one repetition measured. */
+struct result {
+  double gens_per_sec;
+  double evals_per_sec;
+  double best;
+};
+
+struct option bench_opts[] = {
+
+  {"problems", 1, NULL, 'P'},
+  {"threads", 1, NULL, 't'},
+  {"pop-size", 1, NULL, 'p'},
+  {"norms", 1, NULL, 'n'},
+  {"samples", 1, NULL, 'S'},
+  {"rep-rate", 1, NULL, 'r'},
+  {"breed-fitness", 1, NULL, 'b'},
+  {"generations", 1, NULL, 'g'},
+  {"warmup", 1, NULL, 'w'},
+  {"reps", 1, NULL, 'R'},
+  {"seed", 1, NULL, 's'},
+  {"output", 1, NULL, 'o'},
+  {"ttq", 0, NULL, 'T'},
+  {"data-dir", 1, NULL, 'D'},
+  {"trace", 1, NULL, 'f'},
+  {"target", 1, NULL, 'G'},
+  {"tolerance", 1, NULL, 'l'},
+  {"max-gen", 1, NULL, 'm'},
+  {NULL, 0, NULL, 0},
+
+};
+char *args = "P:t:p:n:S:r:b:g:w:R:s:o:TD:f:G:l:m:";
+extern char *optarg;
+
+void die(char *msg){
+
+  fprintf(stderr, "%s", msg);
+  exit(1);
+
+}
+
+/*
+ * Parse a comma seperated list. Problems may be given by name.
+ */
+void parse_list(struct list *l, char *str){
+
+  char *tok, *end;
+  int i;
+
+  l->len = 0;
+  l->vals = (double *)malloc(sizeof(double) * (strlen(str) + 1));
+  if ( ! l->vals )
+    die("Out of memory.\n");
+
+  for ( tok = strtok(str, ","); tok; tok = strtok(NULL, ",")){
+    for ( i = 0; i <= PROBLEM_SQRT5; i++){
+      if ( strcmp(tok, problem_names[i]) == 0 )
+	break;
+    }
+    if ( i <= PROBLEM_SQRT5 ){
+      l->vals[l->len++] = i;
+      continue;
+    }
+    l->vals[l->len++] = strtod(tok, &end);
+    if ( *end )
+      die("Unable to parse list.\n");
+  }
+
+}
+
+void default_list(struct list *l, char *str){
+
+  if ( ! l->len )
+    parse_list(l, strdup(str));
+
+}
+
+/*
+ * A mixture problem we can make as big as we like: k normals spaced out 4
+ * apart with sigma 1, and n samples drawn from them with equal probability.
+ */
+void make_mixture(int k, int n){
+
+  int i, j;
+  double u1, u2;
+  unsigned short rstate[3] = {3, 14, 15};
+
+  free(norms);
+  free(samples);
+
+  norms = (struct normal *)malloc(sizeof(struct normal) * k);
+  samples = (double *)malloc(sizeof(double) * n);
+  if ( ! norms || ! samples )
+    die("Out of memory.\n");
+
+  for ( i = 0; i < k; i++){
+    norms[i].mu_min = (4 * i) - 2;
+    norms[i].mu_max = (4 * i) + 2;
+    norms[i].sigma_min = .5;
+    norms[i].sigma_max = 2;
+    norms[i].mu_var = .01;
+    norms[i].sigma_var = .005;
+    snprintf(norms[i].name, sizeof(norms[i].name), "n%d", i);
+  }
+  norms_len = k;
+
+  /* Box-Muller. */
+  for ( i = 0; i < n; i++){
+    j = nrand48(rstate) % k;
+    u1 = erand48(rstate);
+    u2 = erand48(rstate);
+    samples[i] = (4 * j) +
+      (sqrt(-2 * log(1 - u1)) * cos(2 * M_PI * u2));
+  }
+  sample_count = n;
+
+}
+
+/*
+ * Set up the globals for a problem.
+ */
+void setup_problem(int problem, int k, int n){
+
+  if ( problem == PROBLEM_MIXTURE ){
+    make_mixture(k, n);
+  } else if ( problem == PROBLEM_ROOT ){
+    /* (x-1)(x-2)(x-3). root_fitness() takes the highest order coefficient
+     * first. */
+    static double cubic[] = { 1, -6, 11, -6 };
+    coeffs = cubic;
+    num_coeffs = 4;
+    x_min = -5;
+    x_max = 5;
+    variance = .001;
+  } else {
+    /* The square root of 5 problem, set up the way devol_test does. */
+    static double sqrt5[] = { 1, 0, -5 };
+    coeffs = sqrt5;
+    num_coeffs = 3;
+    x_min = 0;
+    x_max = 10;
+    variance = .005;
+  }
+
+}
+
+/*
+ * Make a gene pool for a problem set up by setup_problem().
+ */
+int make_pool(struct gene_pool *pool, int problem, int threads, int pop,
+	      double rr, double bf, int rep){
+
+  struct devol_params params;
+
+  memset(&params, 0, sizeof(params));
+  params.reproduction_rate = rr;
+  params.breed_fitness = bf;
+  params.gene_dispersal_factor = .01;
+  params.rstate[0] = seed[0];
+  params.rstate[1] = seed[1];
+  params.rstate[2] = seed[2] + rep;
+
+  if ( problem == PROBLEM_MIXTURE ){
+    params.mutate = mixture_mutate;
+    params.fitness = mixture_fitness;
+    params.init = mixture_init;
+    params.genome_size = MIXTURE_GENOME_SIZE(norms_len);
+  } else {
+    params.mutate = root_mutate;
+    params.fitness = root_fitness;
+    params.init = root_init;
+    params.destroy = root_destroy;
+  }
+
+  if ( threads )
+    return gene_pool_create(pool, pop, threads, params);
+  else
+    return gene_pool_create_seq(pool, pop, params);
+
+}
+
+void iterate(struct gene_pool *pool, int threads){
+
+  if ( threads )
+    gene_pool_iterate(pool);
+  else
+    gene_pool_iterate_seq(pool);
+
+}
+
+/*
+ * Run one repetition of a point on the grid.
+ */
+int run_one(int problem, int threads, int pop, double rr, double bf,
+	    int rep, struct result *res){
+
+  int g;
+  uint64_t t_start, t_stop;
+  struct devol_stats before, after;
+  struct gene_pool pool;
+
+  if ( make_pool(&pool, problem, threads, pop, rr, bf, rep) )
+    return DEVOL_ERR;
+
+  for ( g = 0; g < warmup; g++)
+    iterate(&pool, threads);
+
+  gene_pool_get_stats(&pool, &before);
+  t_start = devol_clock_ns();
+  for ( g = 0; g < generations; g++)
+    iterate(&pool, threads);
+  t_stop = devol_clock_ns();
+  gene_pool_get_stats(&pool, &after);
+
+  res->gens_per_sec = generations / ((t_stop - t_start) / 1.0e9);
+  res->evals_per_sec = (after.evaluations - before.evaluations) /
+    ((t_stop - t_start) / 1.0e9);
+
+  res->best = pool.solutions[0].fitness_val;
+  for ( g = 1; g < pop; g++){
+    if ( pool.solutions[g].fitness_val < res->best )
+      res->best = pool.solutions[g].fitness_val;
+  }
+
+  gene_pool_destroy(&pool);
+
+  return DEVOL_OK;
+
+}
+
+void mean_stddev(double *v, int n, double *mean, double *stddev){
+
+  int i;
+  double sum = 0, sq = 0;
+
+  for ( i = 0; i < n; i++)
+    sum += v[i];
+  *mean = sum / n;
+  for ( i = 0; i < n; i++)
+    sq += (v[i] - *mean) * (v[i] - *mean);
+  *stddev = n > 1 ? sqrt(sq / (n - 1)) : 0;
+
+}
+
+/*
+ * Run every repetition of one point on the grid and write its line.
+ */
+void run_point(int problem, int threads, int pop, int k, int n,
+	       double rr, double bf){
+
+  int r;
+  double gens[reps], evals[reps];
+  double g_mean, g_sd, e_mean, e_sd, g_min, g_max;
+  struct result res;
+
+  /* Each island needs a few solutions to breed from. */
+  if ( pop < 4 || (threads && pop / threads < 4) ){
+    fprintf(stderr, "# Skipping %s: pop-size %d too small for %d threads.\n",
+	    problem_names[problem], pop, threads);
+    return;
+  }
+
+  g_min = HUGE_VAL;
+  g_max = 0;
+  for ( r = 0; r < reps; r++){
+    if ( run_one(problem, threads, pop, rr, bf, r, &res) )
+      die("Unable to make a gene pool.\n");
+    gens[r] = res.gens_per_sec;
+    evals[r] = res.evals_per_sec;
+    if ( gens[r] < g_min ) g_min = gens[r];
+    if ( gens[r] > g_max ) g_max = gens[r];
+  }
+
+  mean_stddev(gens, reps, &g_mean, &g_sd);
+  mean_stddev(evals, reps, &e_mean, &e_sd);
+
+  fprintf(out, "%s,%d,%d,%d,%d,%g,%g,%d,%d,%.3lf,%.3lf,%.3lf,%.3lf,"
+	  "%.1lf,%.1lf,%.12g\n", problem_names[problem], threads, pop, k, n,
+	  rr, bf, generations, reps, g_mean, g_sd, g_min, g_max,
+	  e_mean, e_sd, res.best);
+  fflush(out);
+
+}
+
+/*
+ * Load a trace if name is one. Returns DEVOL_ERR if it is not.
+ */
+int load_trace(struct trace *tr, char *dir, char *name){
+
+  int g, size = 0;
+  double avg;
+  char path[1024];
+  FILE *in;
+
+  memset(tr, 0, sizeof(struct trace));
+
+  if ( sscanf(name, "sqrt_5_rr-%lf_bf-%lf.evol", &tr->rr, &tr->bf) == 2 )
+    tr->var = .005;
+  else if ( sscanf(name, "rr=%lf:bf=%lf:var=%lf.txt",
+		   &tr->rr, &tr->bf, &tr->var) != 3 )
+    return DEVOL_ERR;
+
+  snprintf(tr->name, sizeof(tr->name), "%s", name);
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  in = fopen(path, "r");
+  if ( ! in )
+    return DEVOL_ERR;
+
+  while ( fscanf(in, "%d %lf", &g, &avg) == 2 ){
+    if ( tr->len == size ){
+      size = size ? size * 2 : 256;
+      tr->avg = (double *)realloc(tr->avg, sizeof(double) * size);
+      if ( ! tr->avg )
+	die("Out of memory.\n");
+    }
+    tr->avg[tr->len++] = avg;
+  }
+  fclose(in);
+
+  if ( ! tr->len ){
+    free(tr->avg);
+    return DEVOL_ERR;
+  }
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Run one repetition of a trace until the average fitness gets to goal or
+ * limit generations have gone by. Returns the generations it took, or 0 if it
+ * never got there.
+ */
+int ttq_one(int threads, int pop, struct trace *tr, double goal, int limit,
+	    int rep, double *ms, double *evals){
+
+  int g;
+  uint64_t t_start;
+  struct devol_stats stats;
+  struct gene_pool pool;
+
+  if ( make_pool(&pool, PROBLEM_SQRT5, threads, pop, tr->rr, tr->bf, rep) )
+    die("Unable to make a gene pool.\n");
+
+  t_start = devol_clock_ns();
+  for ( g = 1; g <= limit; g++){
+    iterate(&pool, threads);
+    if ( gene_pool_avg_fitness(&pool) <= goal )
+      break;
+  }
+  *ms = (devol_clock_ns() - t_start) / 1.0e6;
+
+  gene_pool_get_stats(&pool, &stats);
+  *evals = stats.evaluations;
+
+  gene_pool_destroy(&pool);
+
+  return g <= limit ? g : 0;
+
+}
+
+int cmp_int(const void *a, const void *b){
+
+  return *(int *)a - *(int *)b;
+
+}
+
+/*
+ * Replay one trace at one thread count and population size. Returns non-zero
+ * if it was slower than the trace allows.
+ */
+int ttq_point(struct trace *tr, int threads, int pop){
+
+  int r, ref, reached = 0, median, limit;
+  int gens[reps];
+  double ms[reps], evals[reps];
+  double goal, t_mean, t_sd, e_mean, e_sd, allowed;
+  char *status;
+
+  if ( (int)(tr->bf * pop) < 2 || (threads && pop / threads < 4) ){
+    fprintf(stderr, "# Skipping %s: pop-size %d too small.\n", tr->name, pop);
+    return 0;
+  }
+
+  /* Where the trace finished, and when it first got there. */
+  goal = isnan(target) ? tr->avg[tr->len - 1] : target;
+  for ( ref = 0; ref < tr->len && tr->avg[ref] > goal; ref++)
+    ;
+  ref = ref < tr->len ? ref + 1 : tr->len;
+
+  allowed = ref * tolerance;
+  limit = max_gen ? max_gen : (int)ceil(2 * allowed);
+
+  variance = tr->var;
+  for ( r = 0; r < reps; r++){
+    gens[r] = ttq_one(threads, pop, tr, goal, limit, r,
+		      &ms[reached], &evals[reached]);
+    if ( gens[r] )
+      reached++;
+    else
+      gens[r] = limit + 1;
+  }
+
+  qsort(gens, reps, sizeof(int), cmp_int);
+  median = gens[reps / 2];
+
+  /* Times and evaluations are only for the repetitions that got there. */
+  t_mean = t_sd = e_mean = e_sd = 0;
+  if ( reached ){
+    mean_stddev(ms, reached, &t_mean, &t_sd);
+    mean_stddev(evals, reached, &e_mean, &e_sd);
+  }
+
+  if ( median > limit )
+    status = "MISSED";
+  else if ( median > allowed )
+    status = "SLOWER";
+  else
+    status = "ok";
+
+  fprintf(out, "%s,%d,%d,%g,%g,%g,%.6g,%d,%d,", tr->name, threads, pop,
+	  tr->rr, tr->bf, tr->var, goal, reps, reached);
+  if ( median > limit )
+    fprintf(out, ",");
+  else
+    fprintf(out, "%d,", median);
+  fprintf(out, "%d,%.3lf,%.3lf,%.3lf,%.1lf,%.1lf,%s\n", ref,
+	  (double)median / ref, t_mean, t_sd, e_mean, e_sd, status);
+  fflush(out);
+
+  if ( *status != 'o' )
+    fprintf(stderr, "# %s: %s (median %d generations, trace %d).\n",
+	    tr->name, status, median, ref);
+
+  return *status != 'o';
+
+}
+
+/*
+ * Replay every trace at every thread count and population size. Returns the
+ * number of regressions.
+ */
+int run_ttq(){
+
+  int i, t, s, n, failed = 0;
+  struct dirent **names;
+  struct trace tr;
+  char *slash;
+
+  fprintf(out, "trace,threads,pop_size,rep_rate,breed_fitness,variance,"
+	  "target,reps,reached,gens_median,gens_trace,gens_ratio,time_ms,"
+	  "time_ms_sd,evals,evals_sd,status\n");
+
+  setup_problem(PROBLEM_SQRT5, 0, 0);
+
+  if ( trace_file ){
+    slash = strrchr(trace_file, '/');
+    if ( slash )
+      *slash = 0;
+    if ( load_trace(&tr, slash ? trace_file : ".",
+		    slash ? slash + 1 : trace_file) )
+      die("Unable to load trace.\n");
+    for ( t = 0; t < thread_counts.len; t++)
+      for ( s = 0; s < pop_sizes.len; s++)
+	failed += ttq_point(&tr, (int)thread_counts.vals[t],
+			    (int)pop_sizes.vals[s]);
+    free(tr.avg);
+    return failed;
+  }
+
+  n = scandir(data_dir, &names, NULL, alphasort);
+  if ( n < 0 )
+    die("Unable to read the data directory.\n");
+
+  for ( i = 0; i < n; i++){
+    if ( load_trace(&tr, data_dir, names[i]->d_name) == DEVOL_OK ){
+      for ( t = 0; t < thread_counts.len; t++)
+	for ( s = 0; s < pop_sizes.len; s++)
+	  failed += ttq_point(&tr, (int)thread_counts.vals[t],
+			      (int)pop_sizes.vals[s]);
+      free(tr.avg);
+    }
+    free(names[i]);
+  }
+  free(names);
+
+  return failed;
+
+}
+
+int main(int argc, char **argv){
+
+  int p, t, s, k, n, r, b;
+  int problem;
+  char arg;
+  char *not_ok;
+
+  out = NULL;
+
+  while ( (arg = getopt_long(argc, argv, args, bench_opts, NULL)) != -1 ){
+
+    switch (arg){
+
+    case 'P':
+      parse_list(&problems, optarg);
+      break;
+    case 't':
+      parse_list(&thread_counts, optarg);
+      break;
+    case 'p':
+      parse_list(&pop_sizes, optarg);
+      break;
+    case 'n':
+      parse_list(&norm_counts, optarg);
+      break;
+    case 'S':
+      parse_list(&sample_counts, optarg);
+      break;
+    case 'r':
+      parse_list(&rep_rates, optarg);
+      break;
+    case 'b':
+      parse_list(&breed_fitnesses, optarg);
+      break;
+    case 'g':
+      generations = (int) strtol(optarg, &not_ok, 0);
+      if ( *not_ok || generations < 1 )
+	die("Unable to parse generations.\n");
+      break;
+    case 'w':
+      warmup = (int) strtol(optarg, &not_ok, 0);
+      if ( *not_ok )
+	die("Unable to parse warmup.\n");
+      break;
+    case 'R':
+      reps = (int) strtol(optarg, &not_ok, 0);
+      if ( *not_ok || reps < 1 )
+	die("Unable to parse repetitions.\n");
+      break;
+    case 's':
+      if ( sscanf(optarg, "%hu,%hu,%hu", &seed[0], &seed[1], &seed[2]) != 3 )
+	die("Please use 3 integer shorts for the RNG seed.\n");
+      break;
+    case 'o':
+      out = strcmp(optarg, "-") ? fopen(optarg, "w") : stdout;
+      if ( ! out )
+	die("Unable to open output file.\n");
+      break;
+    case 'T':
+      ttq = 1;
+      break;
+    case 'D':
+      data_dir = optarg;
+      break;
+    case 'f':
+      trace_file = optarg;
+      break;
+    case 'G':
+      target = strtod(optarg, &not_ok);
+      if ( *not_ok )
+	die("Unable to parse target.\n");
+      break;
+    case 'l':
+      tolerance = strtod(optarg, &not_ok);
+      if ( *not_ok || tolerance <= 0 )
+	die("Unable to parse tolerance.\n");
+      break;
+    case 'm':
+      max_gen = (int) strtol(optarg, &not_ok, 0);
+      if ( *not_ok || max_gen < 0 )
+	die("Unable to parse max-gen.\n");
+      break;
+    case '?':
+      fprintf(stderr, "Error parsing arguments.\n");
+      exit(1);
+
+    }
+  }
+
+  if ( ! out )
+    out = fopen(ttq ? "ttq.csv" : "bench.csv", "w");
+  if ( ! out )
+    die("Unable to open the output file.\n");
+
+  if ( ttq ){
+    default_list(&thread_counts, "0");
+    default_list(&pop_sizes, "1000");
+    r = run_ttq();
+    if ( out != stdout )
+      fclose(out);
+    return r ? 1 : 0;
+  }
+
+  default_list(&problems, "mixture,root,sqrt5");
+  default_list(&thread_counts, "0,1,2,4");
+  default_list(&pop_sizes, "1000");
+  default_list(&norm_counts, "2");
+  default_list(&sample_counts, "1000");
+  default_list(&rep_rates, ".25");
+  default_list(&breed_fitnesses, ".25");
+
+  fprintf(out, "problem,threads,pop_size,norms,samples,rep_rate,"
+	  "breed_fitness,generations,reps,gens_per_sec,gens_per_sec_sd,"
+	  "gens_per_sec_min,gens_per_sec_max,evals_per_sec,evals_per_sec_sd,"
+	  "best_fitness\n");
+
+  for ( p = 0; p < problems.len; p++){
+
+    problem = (int)problems.vals[p];
+
+    /* The size of the mixture problem only matters for the mixture. */
+    for ( k = 0; k < (problem == PROBLEM_MIXTURE ? norm_counts.len : 1); k++){
+      for ( n = 0; n < (problem == PROBLEM_MIXTURE ? sample_counts.len : 1);
+	    n++){
+
+	setup_problem(problem, (int)norm_counts.vals[k],
+		      (int)sample_counts.vals[n]);
+
+	for ( t = 0; t < thread_counts.len; t++)
+	  for ( s = 0; s < pop_sizes.len; s++)
+	    for ( r = 0; r < rep_rates.len; r++)
+	      for ( b = 0; b < breed_fitnesses.len; b++)
+		run_point(problem, (int)thread_counts.vals[t],
+			  (int)pop_sizes.vals[s],
+			  problem == PROBLEM_MIXTURE ?
+			  (int)norm_counts.vals[k] : 0,
+			  problem == PROBLEM_MIXTURE ?
+			  (int)sample_counts.vals[n] : 0,
+			  rep_rates.vals[r], breed_fitnesses.vals[b]);
+
+      }
+    }
+  }
+
+  if ( out != stdout )
+    fclose(out);
+
+  return 0;
+
+}
@@ -0,0 +1,507 @@
+/*
+ * Sweep the reproduction rate, breed fitness and mutation variance of a
+ * problem in one process. Every combination of the lists given is its own
+ * sequential gene pool and they all run at once as jobs on one scheduler
+ * (see devol_sched.c), so a sweep that used to be dozens of runs of
+ * root_finder or mixture one after the other is one run on as many threads as
+ * there are CPUs. The problem is set up once: the configurations share the
+ * polynomial, or the mixture's data set, and only differ in their
+ * devol_params and the variance in their params.problem.
+ *
+ * The average fitness of each configuration's population goes to
+ * rr=<r>:bf=<b>:var=<v>.txt in the output directory, one line of generation
+ * and average per generation just like the runs kept in data/ (devol_bench
+ * --ttq can replay them). The values in the name are spelled the way they were
+ * given, so --rep-rate .05 makes rr=.05. summary.txt in the same directory
+ * (and stdout) gets a table of how each configuration ended up.
+ *
+ * Relevant parameters:
+ *
+ *   problem       <root|mixture>       What to solve (default root).
+ *   coeff         <a0,a1,...>          The polynomial, highest order first
+ *                                      (root only; default 1,0,-5, the square
+ *                                      root of 5).
+ *   x-min         <double>             The minimum starting search bound.
+ *   x-max         <double>             The maximum starting search bound.
+ *   data          <file>               The data set (mixture only).
+ *   norms         <file>               The normals (mixture only).
+ *   rep-rate      <r1,r2,...>          Reproduction rates (default .25).
+ *   breed-fitness <b1,b2,...>          Breed fitnesses (default .25).
+ *   variance      <v1,v2,...>          Mutation variances: the root
+ *                                      finder's variance (default .005), or
+ *                                      the mu and sigma variance of every
+ *                                      normal. Without it the mixture keeps
+ *                                      the norms file's own and the file
+ *                                      names leave out var.
+ *   pop-size      <integer>            The population size (default 1000).
+ *   max-iter      <integer>            Maximum generations (default 1000).
+ *   islands       <integer>            Islands per gene pool.
+ *   threads       <integer>            Scheduler threads (default one per
+ *                                      CPU).
+ *   seed          <s1,s2,s3>           Seed for every configuration.
+ *   converge      N/A                  Stop a configuration once it
+ *                                      converges: the root finder's average
+ *                                      gets below its variance, the
+ *                                      mixture's average or best fitness
+ *                                      stops improving.
+ *   window        <integer>            Generations to look over for
+ *                                      convergence: the root finder also
+ *                                      stops if its average or best fitness
+ *                                      stops improving over this many
+ *                                      (default 20 for the mixture).
+ *   epsilon       <double>             Smallest change in fitness per
+ *                                      generation that counts as improving.
+ *   output-dir    <dir>                Where the files go (default .).
+ *
+ * For example, the runs in data/ are
+ *
+ *   ./devol_sweep --rep-rate .05,.1,.2,.4 --breed-fitness .4 \
+ *     --variance .0005,.005 --output-dir ../../data
+ */
+
+#include <devol.h>
+#include <mixture.h>
+#include <root_finder.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define PROBLEM_ROOT     0
+#define PROBLEM_MIXTURE  1
+
+/*
+ * A list of values, kept as they were typed for the file names.
+ */
+struct list {
+  char  **strs;
+  double *vals;
+  int     len;
+};
+
+/*
+ * One point of the sweep.
+ */
+struct config {
+
+  char                  *rr;
+  char                  *bf;
+  char                  *var;
+  char                   name[256];
+
+  struct root_problem    root;
+  struct mixture_problem mix;
+  struct devol_converge  conv;
+  struct gene_pool       pool;
+  struct devol_job       job;
+  FILE                  *out;
+
+};
+
+int problem = PROBLEM_ROOT;
+struct list rep_rates, breed_fitnesses, variances;
+
+int pop_size = 1000;
+int max_iter = 1000;
+int islands = 0;
+int threads = 0;
+int converge = 0;
+int window = -1;
+double epsilon = -1;
+unsigned short seed[3] = {7, 20, 1969};
+char *output_dir = ".";
+
+double *poly = NULL;
+int poly_len = 0;
+double search_min = 0;
+double search_max = 10;
+char *data_file = NULL;
+char *norms_file = NULL;
+
+struct option sweep_opts[] = {
+
+  {"problem", 1, NULL, 'P'},
+  {"coeff", 1, NULL, 'c'},
+  {"x-min", 1, NULL, 'N'},
+  {"x-max", 1, NULL, 'X'},
+  {"data", 1, NULL, 'd'},
+  {"norms", 1, NULL, 'n'},
+  {"rep-rate", 1, NULL, 'r'},
+  {"breed-fitness", 1, NULL, 'b'},
+  {"variance", 1, NULL, 'V'},
+  {"pop-size", 1, NULL, 'p'},
+  {"max-iter", 1, NULL, 'm'},
+  {"islands", 1, NULL, 'I'},
+  {"threads", 1, NULL, 't'},
+  {"seed", 1, NULL, 's'},
+  {"converge", 0, NULL, 'C'},
+  {"window", 1, NULL, 'w'},
+  {"epsilon", 1, NULL, 'e'},
+  {"output-dir", 1, NULL, 'o'},
+  {NULL, 0, NULL, 0},
+
+};
+char *args = "P:c:N:X:d:n:r:b:V:p:m:I:t:s:Cw:e:o:";
+extern char *optarg;
+
+void die(char *msg){
+
+  fprintf(stderr, "%s", msg);
+  exit(1);
+
+}
+
+/*
+ * Parse a comma seperated list of doubles, keeping each one's spelling.
+ */
+void parse_list(struct list *l, char *str){
+
+  char *tok, *end;
+
+  l->len = 0;
+  l->strs = (char **)malloc(sizeof(char *) * (strlen(str) + 1));
+  l->vals = (double *)malloc(sizeof(double) * (strlen(str) + 1));
+  if ( ! l->strs || ! l->vals )
+    die("Out of memory.\n");
+
+  for ( tok = strtok(str, ","); tok; tok = strtok(NULL, ",")){
+    l->vals[l->len] = strtod(tok, &end);
+    if ( *end || end == tok )
+      die("Unable to parse list.\n");
+    l->strs[l->len++] = tok;
+  }
+
+}
+
+void default_list(struct list *l, char *str){
+
+  if ( ! l->len )
+    parse_list(l, strdup(str));
+
+}
+
+/*
+ * Write each generation's average fitness to the configuration's file.
+ */
+int generation(struct devol_job *job){
+
+  struct config *c = (struct config *)job->arg;
+
+  fprintf(c->out, "%d\t%lf\n", job->ran, gene_pool_avg_fitness(job->pool));
+  return 0;
+
+}
+
+/*
+ * Set up a configuration's problem, convergence test, gene pool and job.
+ */
+void make_config(struct config *c, int r, int b, int v){
+
+  int i;
+  char path[1024];
+  struct devol_params params;
+
+  memset(c, 0, sizeof(struct config));
+  c->rr = rep_rates.strs[r];
+  c->bf = breed_fitnesses.strs[b];
+  c->var = variances.len ? variances.strs[v] : NULL;
+  if ( c->var )
+    snprintf(c->name, sizeof(c->name), "rr=%s:bf=%s:var=%s",
+	     c->rr, c->bf, c->var);
+  else
+    snprintf(c->name, sizeof(c->name), "rr=%s:bf=%s", c->rr, c->bf);
+
+  memset(&params, 0, sizeof(params));
+  params.reproduction_rate = rep_rates.vals[r];
+  params.breed_fitness = breed_fitnesses.vals[b];
+  params.islands = islands;
+  params.rstate[0] = seed[0];
+  params.rstate[1] = seed[1];
+  params.rstate[2] = seed[2];
+
+  if ( problem == PROBLEM_ROOT ){
+
+    c->root.coeffs = poly;
+    c->root.num_coeffs = poly_len;
+    c->root.x_min = search_min;
+    c->root.x_max = search_max;
+    c->root.variance = variances.vals[v];
+
+    c->conv.criteria = DEVOL_CONVERGE_TARGET;
+    c->conv.target = c->root.variance;
+    c->conv.epsilon = epsilon < 0 ? 1e-6 : epsilon;
+    c->conv.window = window;
+    if ( window > 0 )
+      c->conv.criteria |= DEVOL_CONVERGE_DERIVATIVE |
+	DEVOL_CONVERGE_STAGNATION;
+
+    params.mutate = root_mutate;
+    params.fitness = root_fitness;
+    params.init = root_init;
+    params.destroy = root_destroy;
+    params.problem = &c->root;
+
+  } else {
+
+    /* The data set is shared; the normals are copied so each configuration
+     * can have its own variance. */
+    c->mix.norms = (struct normal *)malloc(sizeof(struct normal) * norms_len);
+    if ( ! c->mix.norms )
+      die("Out of memory.\n");
+    memcpy(c->mix.norms, norms, sizeof(struct normal) * norms_len);
+    for ( i = 0; c->var && i < norms_len; i++){
+      c->mix.norms[i].mu_var = variances.vals[v];
+      c->mix.norms[i].sigma_var = variances.vals[v];
+    }
+    c->mix.norms_len = norms_len;
+    c->mix.samples = samples;
+    c->mix.sample_count = sample_count;
+
+    c->conv.criteria = DEVOL_CONVERGE_DERIVATIVE | DEVOL_CONVERGE_STAGNATION;
+    c->conv.epsilon = epsilon < 0 ? .01 : epsilon;
+    c->conv.window = window < 0 ? 20 : window;
+
+    params.mutate = mixture_mutate;
+    params.fitness = mixture_fitness;
+    params.init = mixture_init;
+    params.genome_size = MIXTURE_GENOME_SIZE(norms_len);
+    params.problem = &c->mix;
+
+  }
+
+  snprintf(path, sizeof(path), "%s/%s.txt", output_dir, c->name);
+  c->out = fopen(path, "w");
+  if ( ! c->out ){
+    perror(path);
+    exit(1);
+  }
+
+  if ( gene_pool_create_seq(&c->pool, pop_size, params) )
+    die("Unable to make a gene pool.\n");
+
+  c->job.pool = &c->pool;
+  c->job.generations = max_iter;
+  c->job.conv = converge ? &c->conv : NULL;
+  c->job.name = c->name;
+  c->job.generation = generation;
+  c->job.arg = c;
+
+}
+
+/*
+ * The summary: one line per configuration.
+ */
+void summarize(struct config *configs, int count, FILE *out){
+
+  int i;
+  double ms;
+  struct config *c;
+
+  fprintf(out, "# %-8s %-8s %-8s %6s %-12s %14s %14s %10s %12s\n",
+	  "rr", "bf", "var", "gens", "stopped", "avg", "best", "ms",
+	  "evals/s");
+  for ( i = 0; i < count; i++){
+    c = &configs[i];
+    ms = (c->job.finished - c->job.started) / 1.0e6;
+    fprintf(out, "  %-8s %-8s %-8s %6d %-12s %14lf %14lf %10.1lf %12.0lf\n",
+	    c->rr, c->bf, c->var ? c->var : "-", c->job.ran,
+	    c->conv.fired ? devol_converge_name(c->conv.fired) : "max-iter",
+	    gene_pool_avg_fitness(&c->pool),
+	    gene_pool_best_fitness(&c->pool), ms,
+	    ms > 0 ? c->job.evaluations / (ms / 1000) : 0);
+  }
+
+}
+
+int main(int argc, char **argv){
+
+  int i, r, b, v, count;
+  char arg, *not_ok;
+  char path[1024];
+  uint64_t t_start;
+  struct list seeds;
+  struct config *configs;
+  struct devol_sched *sched;
+  FILE *out;
+
+  memset(&seeds, 0, sizeof(seeds));
+
+  while ( (arg = getopt_long(argc, argv, args, sweep_opts, NULL)) != -1 ){
+
+    switch (arg){
+
+    case 'P':
+      if ( strcmp(optarg, "root") == 0 )
+	problem = PROBLEM_ROOT;
+      else if ( strcmp(optarg, "mixture") == 0 )
+	problem = PROBLEM_MIXTURE;
+      else
+	die("The problem is root or mixture.\n");
+      break;
+    case 'c': {
+      struct list l;
+      parse_list(&l, optarg);
+      poly = l.vals;
+      poly_len = l.len;
+      break;
+    }
+    case 'N':
+      search_min = strtod(optarg, &not_ok);
+      if ( *not_ok )
+	die("Unable to parse x-min.\n");
+      break;
+    case 'X':
+      search_max = strtod(optarg, &not_ok);
+      if ( *not_ok )
+	die("Unable to parse x-max.\n");
+      break;
+    case 'd':
+      data_file = optarg;
+      break;
+    case 'n':
+      norms_file = optarg;
+      break;
+    case 'r':
+      parse_list(&rep_rates, optarg);
+      break;
+    case 'b':
+      parse_list(&breed_fitnesses, optarg);
+      break;
+    case 'V':
+      parse_list(&variances, optarg);
+      break;
+    case 'p':
+      pop_size = (int)strtol(optarg, &not_ok, 0);
+      if ( *not_ok || pop_size < 1 )
+	die("Unable to parse population size.\n");
+      break;
+    case 'm':
+      max_iter = (int)strtol(optarg, &not_ok, 0);
+      if ( *not_ok || max_iter < 1 )
+	die("Unable to parse maximum iterations.\n");
+      break;
+    case 'I':
+      islands = (int)strtol(optarg, &not_ok, 0);
+      if ( *not_ok || islands < 0 )
+	die("Unable to parse island count.\n");
+      break;
+    case 't':
+      threads = (int)strtol(optarg, &not_ok, 0);
+      if ( *not_ok || threads < 1 )
+	die("Unable to parse thread count.\n");
+      break;
+    case 's':
+      parse_list(&seeds, optarg);
+      if ( seeds.len != 3 )
+	die("Please use 3 integer shorts for the RNG seed.\n");
+      for ( i = 0; i < 3; i++)
+	seed[i] = (unsigned short)seeds.vals[i];
+      break;
+    case 'C':
+      converge = 1;
+      break;
+    case 'w':
+      window = (int)strtol(optarg, &not_ok, 0);
+      if ( *not_ok || window < 0 )
+	die("Unable to parse convergence window.\n");
+      break;
+    case 'e':
+      epsilon = strtod(optarg, &not_ok);
+      if ( *not_ok )
+	die("Unable to parse convergence epsilon.\n");
+      break;
+    case 'o':
+      output_dir = optarg;
+      break;
+    default:
+      fprintf(stderr, "Error parsing arguments.\n");
+      exit(1);
+
+    }
+  }
+
+  default_list(&rep_rates, ".25");
+  default_list(&breed_fitnesses, ".25");
+
+  /* Set the problem up, once. */
+  if ( problem == PROBLEM_ROOT ){
+    if ( ! poly ){
+      static double sqrt5[] = { 1, 0, -5 };
+      poly = sqrt5;
+      poly_len = 3;
+    }
+    default_list(&variances, ".005");
+  } else {
+    if ( ! data_file || ! norms_file )
+      die("The mixture needs --data and --norms.\n");
+    norms = read_mixture_file(norms_file, &norms_len);
+    samples = read_data_file(data_file, &sample_count);
+    if ( ! norms || ! samples )
+      die("Unable to read the mixture.\n");
+    printf("# Read %d normal distributions and %d data samples.\n",
+	   norms_len, sample_count);
+  }
+
+  if ( mkdir(output_dir, 0777) && errno != EEXIST ){
+    perror(output_dir);
+    return 1;
+  }
+
+  count = rep_rates.len * breed_fitnesses.len *
+    (variances.len ? variances.len : 1);
+  configs = (struct config *)malloc(sizeof(struct config) * count);
+  if ( ! configs )
+    die("Out of memory.\n");
+
+  if ( ! threads )
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if ( threads < 1 )
+    threads = 1;
+
+  sched = devol_sched_create(threads);
+  if ( ! sched )
+    die("Unable to start the scheduler.\n");
+
+  printf("# Sweeping %d configurations on %d threads.\n", count, threads);
+  t_start = devol_clock_ns();
+
+  i = 0;
+  for ( r = 0; r < rep_rates.len; r++){
+    for ( b = 0; b < breed_fitnesses.len; b++){
+      for ( v = 0; v < (variances.len ? variances.len : 1); v++){
+	make_config(&configs[i], r, b, v);
+	devol_sched_add(sched, &configs[i].job);
+	i++;
+      }
+    }
+  }
+
+  devol_sched_wait_all(sched);
+  devol_sched_destroy(sched);
+
+  printf("# Sweep took %.1lf ms.\n", (devol_clock_ns() - t_start) / 1.0e6);
+  summarize(configs, count, stdout);
+
+  snprintf(path, sizeof(path), "%s/summary.txt", output_dir);
+  out = fopen(path, "w");
+  if ( out ){
+    summarize(configs, count, out);
+    fclose(out);
+  } else {
+    perror(path);
+  }
+
+  for ( i = 0; i < count; i++){
+    fclose(configs[i].out);
+    gene_pool_destroy(&configs[i].pool);
+    free(configs[i].mix.norms);
+  }
+  free(configs);
+
+  return 0;
+
+}
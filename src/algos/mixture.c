@@ -11,15 +11,41 @@
  *   pop-size      <integer>            The population size.
  *   rep-rate      <double>             The reproduction rate of the pop.
  *   dispersal     <integer>            The amount of gene dispersal.
+ *   migration     <ring|torus|full>[,<migrants>]
+ *                                      Send each island's best few (1 by
+ *                                      default) to its neighbours instead of
+ *                                      swapping random solutions, more often
+ *                                      while the islands drift apart.
+ *   island-spread <double>             Give each island its own reproduction
+ *                                      rate, breed fitness and mu/sigma
+ *                                      variance, up to this many times more
+ *                                      or less than the ones given, and
+ *                                      print how each island did at the end.
  *   breed-fitness <double>             Percent of the population that is
  *                                      allowed to breed.
  *   max-iter      <integer>            Maximum iterations.
  *   seed          <s1,s2,s3>           3 unsigned short integer seed values
- *                                      for the drand48() family of random 
- *                                      functions.
- *   converge      N/A                  If specified terminate the algorithm
- *                                      when the average population fitness is
- *                                      less than variance.
+ *                                      for the random number generator.
+ *   converge      N/A                  If specified print the average
+ *                                      fitness each iteration and terminate
+ *                                      the algorithm once it converges: the
+ *                                      average fitness or the best fitness
+ *                                      stops improving.
+ *   window        <integer>            Generations to look over for
+ *                                      convergence (default 20).
+ *   epsilon       <double>             Smallest change in fitness per
+ *                                      generation that counts as improving
+ *                                      (default .01).
+ *   record        <file>               Append a binary record of each
+ *                                      generation to file (see devol2evol).
+ *   export        N/A                  Publish live stats for devol-top to
+ *                                      read, under this program's pid.
+ *   trace         <file>               Record what each thread does and write
+ *                                      it to file as a Chrome trace at the
+ *                                      end (the last 64k events per thread).
+ *   pipeline      <breeders,evaluators>
+ *                                      Breed and evaluate in separate threads,
+ *                                      this many of each (instead of threads).
  *   sequential    N/A                  Run the algorithm in sequential mode.
  *   verbose       N/A                  Will be verbose.
  *   help          N/A                  Display a help message.
@@ -51,16 +77,9 @@
 /*
  * Prototypes for functions we need.
  */
-int     mutate(solution_t *par1, solution_t *par2, 
-	       solution_t *dest);
-double  fitness(solution_t *solution);
-int     init(solution_t *solution);
-int     destroy(solution_t *solution);
-void    swap(solution_t *left, solution_t *right);
 int    *parse_integer_array(char *list, int *count);
 void    die(char *msg);
 int     run();
-void    print_solution(solution_t *s);
 
 /*
  * Fields that modify the functionality of the program.
@@ -70,13 +89,27 @@ int verbose  = 0;
 int defaults = 0;
 int help     = 0;
 int seq      = 0;
+int stats    = 0;
+int perf     = 0;
+int deterministic = 0;
+int export   = 0;
 
 int pop_size = 100;
 int max_iter = 100;
 int threads  = 1;
+int breeders = 0;
+int evaluators = 0;
+
+struct devol_converge conv = {
+  .criteria = DEVOL_CONVERGE_DERIVATIVE | DEVOL_CONVERGE_STAGNATION,
+  .window = 20,
+  .epsilon = .01,
+};
 
 char *data_file = NULL;
 char *norms_file = NULL;
+char *trace_file = NULL;
+char *record_file = NULL;
 
 /*
  * These are the arguements themselves.
@@ -88,18 +121,30 @@ struct option mix_opts[] = {
   {"pop-size", 1, NULL, 'p'},
   {"rep-rate", 1, NULL, 'r'},
   {"dispersal", 1, NULL, 'D'},
+  {"migration", 1, NULL, 'M'},
+  {"island-spread", 1, NULL, 'A'},
   {"threads", 1, NULL, 't'},
   {"breed-fitness", 1, NULL, 'b'},
   {"max-iter", 1, NULL, 'm'},
   {"seed", 1, NULL, 's'},
+  {"islands", 1, NULL, 'I'},
+  {"window", 1, NULL, 'w'},
+  {"epsilon", 1, NULL, 'e'},
+  {"trace", 1, NULL, 'X'},
+  {"record", 1, NULL, 'O'},
+  {"export", 0, &export, 'E'},
+  {"pipeline", 1, NULL, 'L'},
+  {"deterministic", 0, &deterministic, 'R'},
   {"converge", 0, &converge, 'C'},
   {"sequential", 0, &seq, 'S'},
   {"verbose", 0, &verbose, 'v'},
+  {"stats", 0, &stats, 'T'},
+  {"perf", 0, &perf, 'P'},
   {"help", 0, &help, 'h'},
   {NULL, 0, NULL, 0},
 
 };
-char *args = "d:n:p:r:t:b:m:s:Cvdh";
+char *args = "d:n:p:r:t:b:m:s:I:w:e:X:O:L:Cvdh";
 extern char *optarg;
 
 /*
@@ -118,33 +163,17 @@ struct devol_params algo_params = {
   /*
    * These are the functions used to actually run the algorithm.
    */
-  .mutate  = mutate,
-  .fitness = fitness,
-  .init    = init,
-  .destroy = destroy,
-  .swap    = swap,
+  .mutate  = mixture_mutate,
+  .fitness = mixture_fitness,
+  .init    = mixture_init,
+  .destroy = NULL,   /* The engine owns the genomes, nothing to free. */
+  .swap    = NULL,   /* Likewise it can swap them on its own. */
 
   /* And some default random state. */
   .rstate = {7, 20, 1969},
 
 };
 
-/*
- * Memory allocation for the solutions. Lockless, fast, etc. Requires two
- * allocators since each allocator is only capable of allocating fixed sized
- * chunks.
- */
-struct bucket_table mix_sols;
-struct bucket_table mix_params;
-
-/*
- * The list of normals and the list of data.
- */
-struct normal *norms;
-int            norms_len;
-double        *samples;
-int            sample_count;
-
 /*
  * main(). Start here...
  */
@@ -154,9 +183,8 @@ int main(int argc, char **argv){
   char arg;
   char *not_ok;
 
-  int *rng_seed;
+  int *rng_seed, *stages;
   int elems;
-  int blocks;
 
   time_t t_start;
   time_t t_stop;
@@ -188,6 +216,29 @@ int main(int argc, char **argv){
       if ( *not_ok )
 	die("Unable to parse reproduction rate.\n");
       break;
+    case 'M': /* migration topology */
+      if ( ! strncmp(optarg, "ring", 4) )
+	algo_params.migration = DEVOL_MIGRATE_RING;
+      else if ( ! strncmp(optarg, "torus", 5) )
+	algo_params.migration = DEVOL_MIGRATE_TORUS;
+      else if ( ! strncmp(optarg, "full", 4) )
+	algo_params.migration = DEVOL_MIGRATE_FULL;
+      else
+	die("Migration is one of ring, torus or full.\n");
+      if ( strchr(optarg, ',') ){
+	algo_params.migrants = (int) strtol(strchr(optarg, ',') + 1,
+					    &not_ok, 0);
+	if ( *not_ok || algo_params.migrants < 1 )
+	  die("Unable to parse migrant count.\n");
+      }
+      algo_params.migration_interval = 8;
+      algo_params.migration_diversity = .2;
+      break;
+    case 'A': /* spread of island settings */
+      algo_params.island_spread = strtod(optarg, &not_ok);
+      if ( *not_ok || algo_params.island_spread < 1 )
+	die("Unable to parse island spread.\n");
+      break;
     case 't':
       threads = (int) strtol(optarg, &not_ok, 0);
       if ( *not_ok )
@@ -215,6 +266,39 @@ int main(int argc, char **argv){
 	     rng_seed[0], rng_seed[1], rng_seed[2]);
       free(rng_seed);
       break;
+    case 'I': /* number of islands */
+      algo_params.islands = (int) strtol(optarg, &not_ok, 0);
+      if ( *not_ok )
+	die("Unable to parse island count.\n");
+      break;
+    case 'w': /* convergence window */
+      conv.window = (int) strtol(optarg, &not_ok, 0);
+      if ( *not_ok || conv.window < 1 )
+	die("Unable to parse convergence window.\n");
+      break;
+    case 'e': /* convergence epsilon */
+      conv.epsilon = strtod(optarg, &not_ok);
+      if ( *not_ok )
+	die("Unable to parse convergence epsilon.\n");
+      break;
+    case 'X': /* where to put a trace */
+      trace_file = strdup(optarg);
+      algo_params.trace = 65536;
+      break;
+    case 'O': /* where to record the generations */
+      record_file = strdup(optarg);
+      break;
+    case 'L': /* breeder and evaluator threads */
+      stages = parse_integer_array(optarg, &elems);
+      if ( ! stages || elems != 2 || stages[0] < 1 || stages[1] < 1 )
+	die("Give the pipeline as <breeders>,<evaluators>.\n");
+      breeders = stages[0];
+      evaluators = stages[1];
+      free(stages);
+      break;
+    case 'R': /* reproducible across thread counts */
+      deterministic = 1;
+      break;
     case 'C': /* We should check for convergence. */
       converge = 1;
       break;
@@ -243,12 +327,29 @@ int main(int argc, char **argv){
   
   printf("# Algorithm parameters:\n");
   printf("#   Population size:      %d\n", pop_size);
-  printf("#   Thread count:         %d\n", seq ? 1 : threads);
+  if ( breeders && ! seq )
+    printf("#   Pipeline:             %d breeders, %d evaluators\n",
+	   breeders, evaluators);
+  else
+    printf("#   Thread count:         %d\n", seq ? 1 : threads);
   printf("#   Maximum iterations:   %d\n", max_iter);
   printf("#   Gene dispersal:       %lf\n", algo_params.gene_dispersal_factor);
+  if ( algo_params.migration )
+    printf("#   Migration:            %s, %d migrants\n",
+	   algo_params.migration == DEVOL_MIGRATE_RING ? "ring" :
+	   (algo_params.migration == DEVOL_MIGRATE_TORUS ? "torus" : "full"),
+	   algo_params.migrants > 0 ? algo_params.migrants : 1);
+  if ( algo_params.island_spread > 1 )
+    printf("#   Island spread:        %lf\n", algo_params.island_spread);
   printf("#   Reproduction rate:    %lf\n", algo_params.reproduction_rate);
   printf("#   Breed fitness:        %lf\n", algo_params.breed_fitness);
+  printf("#   Islands:              %d\n", algo_params.islands ?
+	 algo_params.islands : (seq ? 1 : (breeders ? breeders : threads)));
+  printf("#   Deterministic:        %s\n", deterministic ? "yes" : "no");
   printf("#   Check for converge:   %s\n", converge ? "yes" : "no");
+  if ( converge )
+    printf("#   Converge window:      %d (epsilon %g)\n",
+	   conv.window, conv.epsilon);
   printf("#   Data file:            %s\n", data_file);
   printf("#   Normal distributions: %s\n", norms_file);
 
@@ -272,19 +373,12 @@ int main(int argc, char **argv){
   samples = read_data_file(data_file, &sample_count);
   printf("# Read %d data samples.\n", sample_count);
 
-  /* Initialize the solution's memory allocator. */
-  blocks = algo_params.reproduction_rate * pop_size;
-  blocks *= 2;        /* Just for good measure. */
-  blocks += pop_size; /* The steady state solutions. */
-  blocks /= threads;  /* Since we split each bucket by thread. */
-  printf("# Initializing mixture allocation buckets.\n");
-  init_bucket_allocator(&mix_sols, threads, sizeof(struct mixture_solution),
-			blocks);
-  /*_display_buckets(&mix_sols, 0);*/
-  printf("# Initializing param allocation buckets.\n");
-  init_bucket_allocator(&mix_params, threads, sizeof(double) * 3 * norms_len,
-			blocks);
-  /*_display_buckets(&mix_params, 0);*/
+  algo_params.deterministic = deterministic;
+  algo_params.perf = perf;
+
+  /* Each genome is a mixture_solution followed by the mu, sigma and prob
+   * arrays. The engine allocates them for us. */
+  algo_params.genome_size = MIXTURE_GENOME_SIZE(norms_len);
 
   /* Now run the algorithm. */
   run();
@@ -304,11 +398,15 @@ int run(){
   int i;
   int iter = 0;
   int err;
+  FILE *out;
   struct gene_pool pool;
 
   /* Initialize the gene pool. */
   if ( seq )
     err = gene_pool_create_seq(&pool, pop_size, algo_params);
+  else if ( breeders )
+    err = gene_pool_create_pipeline(&pool, pop_size, breeders, evaluators,
+				    algo_params);
   else
     err = gene_pool_create(&pool, pop_size, threads, algo_params);
 
@@ -317,7 +415,12 @@ int run(){
 
   if ( verbose )
     for ( i = 0; i < pop_size; i++)
-      print_solution(&pool.solutions[i]);
+      mixture_print_solution(&pool.solutions[i]);
+
+  if ( record_file && gene_pool_record(&pool, record_file) )
+    die("Unable to open the record file.\n");
+  if ( export && gene_pool_export(&pool, NULL) )
+    die("Unable to export the stats.\n");
 
   printf("# Gene pool made, solutions inited, running...\n");
   
@@ -329,318 +432,54 @@ int run(){
     else
       gene_pool_iterate(&pool);
     
-    /* Print the average fitness of the solution pool. */
-    if ( converge )
-      printf("%6d\t%lf\n", iter, gene_pool_avg_fitness(&pool));
-
-    /* If I could come up with a reliable way of measuring a convergence
-     * criteria then I would. My current ideas are to keep a running average
-     * of the gene pools mean fitness derivative. If that derivative hits some
-     * value then accept convergence. But I don't really have time any more. 
-     */
-  }
-
-  if ( verbose )
-    for ( i = 0; i < pop_size; i++)
-      print_solution(&pool.solutions[i]);
-
-  /* We are done... */
-  return 0;
-
-}
-
-int cross_over(solution_t *par1, solution_t *par2, solution_t *dest){
-
-  int i;
-  long int cpoint;
-  struct devol_controller *cont = par1->cont;
-  struct mixture_solution *m1, *m2, *ds;
-
-  m1 = par1->private.ptr;
-  m2 = par2->private.ptr;
-  ds = dest->private.ptr;
-
-  /*
-   * Here lieth the code that allows us to not use cross over just to see the
-   * difference in average solution fitness over time with or with out cross
-   * over.
-   */
-  /*
-  if ( m1->mle > m2->mle){
-    for ( i = 0; i < norms_len; i++){
-      ds->mu[i] = m1->mu[i];
-      ds->sigma[i] = m1->sigma[i];
-      ds->prob[i] = m1->prob[i];
-    }
-  } else {
-    for ( i = 0; i < norms_len; i++){
-      ds->mu[i] = m2->mu[i];
-      ds->sigma[i] = m2->sigma[i];
-      ds->prob[i] = m2->prob[i];
+    /* Print the average fitness of the solution pool and stop once it
+     * stops getting any better. */
+    if ( converge ){
+      gene_pool_converged(&pool, &conv);
+      printf("%6d\t%lf\n", iter, conv.avg);
+      if ( conv.fired ){
+	printf("# Converged after %d iterations (%s).\n", iter,
+	       devol_converge_name(conv.fired));
+	break;
+      }
     }
-  }  
-  return 0;
-  */
-
-  /* Pick a random number less than the number of distributions we are using.
-   * Then take params from parent 1 until we hit the crossover point; then
-   * take params from the other parent. */
-  devol_nrand48(cont->rstate, &cont->rdata, &cpoint);
-  cpoint %= norms_len;
-
-  /* OK, we have a crossover point. Now make the child. */
-  for ( i = 0; i < norms_len; i++){
-    ds->mu[i] = (i < cpoint) ? m1->mu[i] : m2->mu[i];
-    ds->sigma[i] = (i < cpoint) ? m1->sigma[i] : m2->sigma[i];
-
-    /* We cant crossover probabilities. This leads to huge problems. */
-    ds->prob[i] = m1->prob[i];
-  }
-
-  return 0;
-
-}
-
-int mutate(solution_t *par1, solution_t *par2, solution_t *dest){
-
-  int i;
-  long int p_plus, p_minus;
-  double d_mu, d_sigma, d_prob;
-  
-  struct mixture_solution *ms;
-  struct devol_controller *cntr = par1->cont;
-
-  /* We are passed a pair of solutions. Make a third from those two. First init
-   * the solution, then perform some crossover, then finally, randomly perturb
-   * the child solution. */
-  init(dest);
-  ms = dest->private.ptr;
-  cross_over(par1, par2, dest);
-
-  /* Do the random perturbations here. */
-  for ( i = 0; i < norms_len; i++){
-
-    /* Get the initial randoms. */
-    devol_rand48(cntr->rstate, &cntr->rdata, &d_mu);
-    devol_rand48(cntr->rstate, &cntr->rdata, &d_sigma);
-
-    /* Now fit them into the variance window. */
-    d_mu = (d_mu * norms[i].mu_var) - (norms[i].mu_var/2);
-    d_sigma = (d_sigma * norms[i].sigma_var) - (norms[i].sigma_var/2);
-
-    /* Add the changes in. */
-    ms->mu[i] += d_mu;
-    ms->sigma[i] += d_sigma;
-
-  }
-
-  /* We do one probability modification per iteration for simplicity's sake. */
-  if ( norms_len > 1 ){
-    devol_rand48(cntr->rstate, &cntr->rdata, &d_prob);  
-    devol_jrand48(cntr->rstate, &cntr->rdata, &p_plus);
-    d_prob = (d_prob * PROB_VAR) - (PROB_VAR/2);
-    p_plus = labs(p_plus);
-    p_plus %= norms_len;
-    
-    do {
-      devol_jrand48(cntr->rstate, &cntr->rdata, &p_minus);
-      p_minus = labs(p_minus);
-      p_minus %= norms_len;
-    } while ( p_minus == p_plus );
-
-    /* The probability has to sum to 1 after all. */
-    ms->prob[p_plus]  += d_prob;
-    ms->prob[p_minus] -= d_prob;
-
-  }
-
-  //printf("# Perturbations:\n");
-  //print_solution(dest);
-
-  return 0;
-
-}
-
-#define ONE_DIV_ROOT_2_PI 0.39894
-
-/*
- * The normal PDF function. Calculated with respect to the unit normal 
- * (sigma=1 and mu=0). To use diff normal params, shift the passed argument 
- * correctly.
- */
-double _normal_pdf(double x){
-
-  return ONE_DIV_ROOT_2_PI * exp(-( .5 * x * x ));
-
-}
-
-/*
- * Calculate the maximum likelihood of the passed point with respect to the
- * normal distributions of the passed solution.
- *
- * The normal PDF:
- *
- *   ( 1 / abs(ROOT_2_PI*sigma) ) * exp( -(x-mu)^2 / 2*sigma^2 )
- *
- */
-double _do_mle_point_estimate(struct mixture_solution *s, double x){
-
-  int i;
-
-  double sum = 0.0;
-  double samp;
-
-  /* For each normal distribution: */
-  for ( i = 0; i < norms_len; i++){
-
-    /* Calculate the value of the normal PDF for the params. */
-    samp = _normal_pdf( (x - s->mu[i]) / s->sigma[i] ) / s->sigma[i];
-
-    /* And add it into the sum. */
-    sum += s->prob[i] * samp;
 
   }
 
-  /* Return the sum; which is now the MLE for the passed data point. */
-  return sum;
-
-}
-
-/*
- * Calculate the maximum likelihood function for the passed parameters. For
- * each data point, calculate the sum of the weighted normal log probability.
- */
-double fitness(solution_t *solution){
-
-  int i;
-  
-  double mle;
-  double fitness = 0.0;
-
-  struct mixture_solution *ms = solution->private.ptr;
-
-  if ( ms->solved )
-    return ms->mle;
-
-  /* For each data point, calculate the MLE estimate. Then take the log, and
-   * finally add it into our fitness value. */
-  for ( i = 0; i < sample_count; i++){
-
-    mle = _do_mle_point_estimate(ms, samples[i]);
-    fitness += log(mle);
+  if ( record_file && gene_pool_record_stop(&pool) )
+    fprintf(stderr, "Unable to write all of %s.\n", record_file);
+  gene_pool_export_stop(&pool);
 
+  if ( gene_pool_best(&pool) ){
+    printf("# Best solution seen:\n");
+    mixture_print_solution(gene_pool_best(&pool));
   }
 
-  /* Since we want a value close to zero, we simply take an arbitrary ceiling
-   * value for the fitnees, and return the distance the computed MLE is from
-   * that fitness. */
-  ms->solved = 1;
-  ms->mle = FITNESS_CEILING - fitness;
-  return ms->mle;
-
-}
-
-/*
- * Initialize a solution to hold a random guess as to what the mixture of
- * distributions will be. We assume that each solution passed already has its
- * functions set up properly, so we can ignore that part of initialization.
- */
-int init(solution_t *solution){
+  if ( verbose )
+    for ( i = 0; i < pop_size; i++)
+      mixture_print_solution(&pool.solutions[i]);
 
-  int i;
-  double tmp = 0;
-  double mu, sigma;
-  struct mixture_solution *msol;
-  struct devol_controller *cont = solution->cont;
-
-  msol = (struct mixture_solution *)balloc(&mix_sols, cont->tid);
-  if ( ! msol )
-    die("init solution: out of memory.\n");
-
-  /* All the sigma, mu, and prob allocations in 1 operation. */
-  msol->mu = (double *)balloc(&mix_params, cont->tid);
-  msol->sigma = msol->mu + norms_len;
-  msol->prob = msol->mu + (2 * norms_len);
-  msol->solved = 0;
-
-  msol->len = norms_len;
-  for ( i = 0; i < norms_len; i++){
-    /* Generate a random number on the mu interval. */
-    devol_rand48(cont->rstate, &cont->rdata, &tmp);
-    mu = (tmp * (norms[i].mu_max - norms[i].mu_min)) + norms[i].mu_min;
-
-    /* Generate a random number on the sigma interval. */
-    devol_rand48(cont->rstate, &cont->rdata, &tmp);
-    sigma = 
-      (tmp * (norms[i].sigma_max - norms[i].sigma_min)) + norms[i].sigma_min;
-    
-    /* And set the msol fields. */
-    msol->mu[i] = mu;
-    msol->sigma[i] = sigma;
-    msol->prob[i] = 1.0 / norms_len;
+  if ( algo_params.island_spread > 1 )
+    gene_pool_print_islands(&pool, stdout);
 
+  if ( trace_file ){
+    out = fopen(trace_file, "w");
+    if ( ! out || gene_pool_dump_trace(&pool, out) )
+      fprintf(stderr, "Unable to write the trace to %s.\n", trace_file);
+    if ( out )
+      fclose(out);
   }
 
-  solution->private.ptr = msol;
-
-  return 0;
-
-}
-
-/*
- * Free the buffers held by the passed solution.
- */
-int destroy(solution_t *solution){
-
-  struct mixture_solution *sol = solution->private.ptr;
-
-  /* Since mu and sigma were made in one allocation, they must be destroyed in
-   * one free(). */
-  bfree(&mix_params, solution->cont->tid, sol->mu);
-
-  /* And free the solution itself. */
-  bfree(&mix_sols, solution->cont->tid, sol);
+  if ( stats )
+    gene_pool_print_stats(&pool, stdout);
+  if ( perf )
+    gene_pool_print_perf(&pool, stdout);
 
+  /* We are done... */
   return 0;
 
 }
 
-/*
- * Deep swap of two solutions. Necessary because the memory allocator I wrote
- * is really, really, finicky. Gah this is computationally expensive :(. Thats
- * a downside to the shitty memory allocator I wrote I guess. Maybe I should
- * that allocator able to do frees w/o knowing the bucket a memory block is
- * from.
- */
-void swap(solution_t *left, solution_t *right){
-
-  int t_solved;
-  double tmp;
-  double t_theta[norms_len * 3];
-  struct mixture_solution *l_sol = left->private.ptr;
-  struct mixture_solution *r_sol = right->private.ptr;
-
-  /* Copy the actual values of the parameters; leave the original addresses of
-   * each of the mixture structs alone so we dont break the memory allocator.
-   */
-  memcpy(t_theta,   l_sol->mu, sizeof(double) * norms_len * 3);
-  memcpy(l_sol->mu, r_sol->mu, sizeof(double) * norms_len * 3);
-  memcpy(r_sol->mu, t_theta,   sizeof(double) * norms_len * 3);
-
-  /* Now that the parameters themselves are copied, we should probably copy
-   * some of the other fields as well. */
-  tmp                = left->fitness_val;
-  left->fitness_val  = right->fitness_val;
-  right->fitness_val = tmp;
-  tmp                = l_sol->mle;
-  l_sol->mle         = r_sol->mle;
-  r_sol->mle         = tmp;
-  t_solved           = l_sol->solved;
-  l_sol->solved      = r_sol->solved;
-  r_sol->solved      = t_solved;
-
-}
-
 /*
  * Parse a comma seperated list of integers.
  */
@@ -700,19 +539,3 @@ void die(char *msg){
   exit(1);
 
 }
-
-/*
- * Print a solution out. In a pretty way.
- */
-void print_solution(solution_t *s){
-
-  int i;
-  struct mixture_solution *ms = s->private.ptr;
-
-  printf("# Solution: (fitness = %lf)\n", ms->mle);
-  for ( i = 0; i < ms->len; i++){
-    printf("#  mu = %.4lf sigma = %.4lf prob = %.4lf\n", 
-	   ms->mu[i], ms->sigma[i], ms->prob[i]);
-  }
-
-}
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <pthread.h>
 
 /*
  * A struct for describing each normal distribution expected in the mixture.
@@ -31,9 +32,6 @@ struct normal {
  */
 struct mixture_solution {
 
-  double *mu;    /* List of mus for each distribution. */
-  double *sigma; /* List of stddevs for each distribution. */
-  double *prob;  /* Probability for the given distribution. */
   int len;       /* How many distributions we have. */
 
   /* Store this once we have calculated the result so we dont have to do
@@ -54,24 +52,90 @@ struct mixture_solution {
 #define FITNESS_CEILING (1.0e12)
 
 struct bucket_table;
+struct solution;
+
+/*
+ * A slab of blocks. The first slab of every bucket lives in the table's base
+ * memory; when a bucket runs dry it grabs another (bigger) slab and keeps
+ * going instead of failing the allocation.
+ */
+struct bucket_slab {
+
+  /* The next slab owned by the same bucket. */
+  struct bucket_slab *next;
+
+  /* Where the blocks start and how many of them there are. */
+  void     *base_addr;
+  size_t    elems;
+
+  /* The bucket that owns this slab; frees of its blocks go back there. */
+  int       bucket;
+
+};
+
+/* How many times a single bucket may grow. Each growth doubles the bucket so
+ * this is plenty. */
+#define BUCKET_MAX_GROWTH 32
+
+/* Grown slabs are made of whole chunks of this many bytes, aligned to one, so
+ * which bucket a block belongs to is a lookup of the block's chunk in a two
+ * level table: BUCKET_ROOT_BITS of the chunk number pick a leaf, the rest an
+ * entry in it. That covers 48 bit addresses. */
+#define BUCKET_CHUNK_SHIFT  16
+#define BUCKET_LEAF_BITS    16
+#define BUCKET_ROOT_BITS    16
 
 /*
  * A special memory allocator. Lockless and threadable but highly specialized.
+ * Freed blocks are kept on a singly linked list threaded through the blocks
+ * themselves so both allocation and deallocation are O(1).
+ *
+ * A bucket belongs to the first thread to allocate from it and only that
+ * thread allocates from it (balloc() from any other thread gets NULL), but
+ * any thread may free a block back to it. The owner's own frees go straight
+ * onto free_list; everyone else's are pushed onto remote_free with a compare
+ * and swap, and the owner takes that whole list over once its own free_list
+ * is empty. Since only the owner ever pops there is no ABA problem.
  */
 struct bucket {
 
-  /* Starting address of our bucket. */
-  void     *base_addr;
+  /* Blocks freed back to this bucket. Kept on its own cache line since every
+   * thread may write to it. */
+  void * volatile remote_free;
+  char  __remote_padding[64 - sizeof(void *)];
+
+  /* Head of the list of free blocks. Owner only. claimed goes from 0 to 1
+   * when a thread starts to take the bucket and to 2 once owner is set. */
+  void     *free_list;
+  pthread_t owner;
+  volatile int claimed;
 
-  /* A list of bits representing which blocks have been allocated. */
-  uint32_t *alloc_table;
+  /* Bump cursor into the newest slab. Blocks below the cursor have been
+   * handed out at least once, blocks above it have never been touched. */
+  char     *cursor;
+  char     *limit;
 
-  /* How many elems we have over all/allocated out. */
+  /* How many elems we have over all. */
   size_t    elems;
 
+  /* Every slab this bucket has grown by. */
+  struct bucket_slab *slabs;
+  int       slab_count;
+
+  /* Which bucket in the table this is. */
+  int       id;
+
   /* A pointer back to the table that manages this bucket. */
   struct bucket_table *tbl;
 
+  /* Keep neighbouring buckets (used by different threads) off of each
+   * other's cache lines. */
+#ifdef __x86_64__
+  char __padding[64];
+#else
+  char __padding[28];
+#endif
+
 };
 
 struct bucket_table {
@@ -84,14 +148,55 @@ struct bucket_table {
   /* Elements per bucket. */
   int elems_per_bkt;
 
-  /* The real base of memory. We will allocate all bucket's memory once. */
+  /* The real base of memory. We will allocate all bucket's initial memory
+   * once. Since it is contiguous, the owner of a block in here is just its
+   * offset divided by the size of a bucket's share. */
   void *base;
+  void *base_end;
+
+  /* Which bucket (plus one; 0 is none) each chunk of the grown slabs belongs
+   * to, so a block outside of base can still be traced back to its owner.
+   * Leaves are made as slabs need them and put in with a compare and swap. */
+  unsigned short * volatile *chunk_index;
+
+};
+
+/*
+ * The problem being solved; see mixture_ops.c. A gene pool whose
+ * params.problem points at a mixture_problem solves that one instead of the
+ * globals, so several can share a data set but differ in their normals.
+ */
+struct mixture_problem {
 
-  /* All the allocation tables. */
-  uint32_t *alloc_tables;
+  struct normal *norms;
+  int            norms_len;
+  double        *samples;
+  int            sample_count;
 
 };
 
+extern struct normal *norms;
+extern int            norms_len;
+extern double        *samples;
+extern int            sample_count;
+
+/* Each genome is a mixture_solution followed by its mu, sigma and prob
+ * arrays. The arrays are found from where the struct is rather than kept in
+ * it, so a genome still makes sense wherever the engine copies it to (a
+ * migrant's new island, the hall of fame). */
+#define MIXTURE_GENOME_SIZE(LEN) \
+  (sizeof(struct mixture_solution) + (sizeof(double) * 3 * (LEN)))
+#define MIXTURE_MU(MS)     ((double *)((MS) + 1))
+#define MIXTURE_SIGMA(MS)  (MIXTURE_MU(MS) + (MS)->len)
+#define MIXTURE_PROB(MS)   (MIXTURE_MU(MS) + (2 * (MS)->len))
+
+int    mixture_cross_over(struct solution *par1, struct solution *par2,
+			  struct solution *dest);
+int    mixture_mutate(struct solution *par1, struct solution *par2,
+		      struct solution *dest);
+double mixture_fitness(struct solution *solution);
+int    mixture_init(struct solution *solution);
+void   mixture_print_solution(struct solution *s);
 
 /*
  * Functions to use.
@@ -101,7 +206,9 @@ double        *read_data_file(char *file, int *samples);
 int            init_bucket_allocator(struct bucket_table *tbl, int buckets,
 				     size_t block_size, size_t elems);
 void          *balloc(struct bucket_table *tbl, int bucket);
-void           bfree(struct bucket_table *tbl, int bucket, void *ptr);
+void           bfree(struct bucket_table *tbl, void *ptr);
+int            bowner(struct bucket_table *tbl, void *ptr);
+void           destroy_bucket_allocator(struct bucket_table *tbl);
 void          _display_buckets(struct bucket_table *tbl, 
 			       int print_alloc_tables);
 
@@ -0,0 +1,303 @@
+/*
+ * The mixture problem itself: the call backs the engine uses to solve it. The
+ * mixture program (mixture.c) and the benchmarks both use these. The normals
+ * and data samples (the globals below, or a struct mixture_problem in
+ * devol_params.problem) must be set up before the gene pool is made, and
+ * devol_params.genome_size must be MIXTURE_GENOME_SIZE(norms_len).
+ */
+
+#include <devol.h>
+#include <mixture.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * The list of normals and the list of data.
+ */
+struct normal *norms;
+int            norms_len;
+double        *samples;
+int            sample_count;
+
+/*
+ * The problem solution is being solved for: its gene pool's, or the globals.
+ */
+static void _mixture_problem(solution_t *solution, struct mixture_problem *mp){
+
+  struct mixture_problem *p = (struct mixture_problem *)devol_problem(solution);
+
+  if ( p ){
+    *mp = *p;
+    return;
+  }
+
+  mp->norms = norms;
+  mp->norms_len = norms_len;
+  mp->samples = samples;
+  mp->sample_count = sample_count;
+
+}
+
+int mixture_cross_over(solution_t *par1, solution_t *par2, solution_t *dest){
+
+  int i;
+  long int cpoint;
+  struct devol_controller *cont = par1->cont;
+  struct mixture_solution *m1, *m2, *ds, *from;
+
+  m1 = par1->private.ptr;
+  m2 = par2->private.ptr;
+  ds = dest->private.ptr;
+
+  /*
+   * Here lieth the code that allows us to not use cross over just to see the
+   * difference in average solution fitness over time with or with out cross
+   * over.
+   */
+  /*
+  if ( m1->mle > m2->mle){
+    for ( i = 0; i < norms_len; i++){
+      MIXTURE_MU(ds)[i] = MIXTURE_MU(m1)[i];
+      MIXTURE_SIGMA(ds)[i] = MIXTURE_SIGMA(m1)[i];
+      MIXTURE_PROB(ds)[i] = MIXTURE_PROB(m1)[i];
+    }
+  } else {
+    for ( i = 0; i < norms_len; i++){
+      MIXTURE_MU(ds)[i] = MIXTURE_MU(m2)[i];
+      MIXTURE_SIGMA(ds)[i] = MIXTURE_SIGMA(m2)[i];
+      MIXTURE_PROB(ds)[i] = MIXTURE_PROB(m2)[i];
+    }
+  }  
+  return 0;
+  */
+
+  /* Pick a random number less than the number of distributions we are using.
+   * Then take params from parent 1 until we hit the crossover point; then
+   * take params from the other parent. */
+  cpoint = devol_rng_u32(&cont->rng) % ds->len;
+
+  /* OK, we have a crossover point. Now make the child. */
+  for ( i = 0; i < ds->len; i++){
+    from = (i < cpoint) ? m1 : m2;
+    MIXTURE_MU(ds)[i] = MIXTURE_MU(from)[i];
+    MIXTURE_SIGMA(ds)[i] = MIXTURE_SIGMA(from)[i];
+
+    /* We cant crossover probabilities. This leads to huge problems. */
+    MIXTURE_PROB(ds)[i] = MIXTURE_PROB(m1)[i];
+  }
+
+  return 0;
+
+}
+
+int mixture_mutate(solution_t *par1, solution_t *par2, solution_t *dest){
+
+  int i;
+  long int p_plus, p_minus;
+  double d_mu, d_sigma, d_prob, mu_var, sigma_var, scale;
+  struct mixture_problem mp;
+  struct mixture_solution *ms = dest->private.ptr;
+  struct devol_controller *cntr = par1->cont;
+  double r[2 * ms->len];
+
+  _mixture_problem(par1, &mp);
+  scale = devol_mutation_scale(dest);
+
+  /* We are passed a pair of solutions. Make a third from those two. dest is
+   * a dead solution whose genome we get to reuse; crossover overwrites all of
+   * its parameters, then we randomly perturb the child solution. */
+  ms->solved = 0;
+  mixture_cross_over(par1, par2, dest);
+
+  /* Do the random perturbations here. Get all of the randoms we need for
+   * them in one go. */
+  devol_rng_fill(&cntr->rng, r, 2 * mp.norms_len);
+  for ( i = 0; i < mp.norms_len; i++){
+
+    d_mu = r[2 * i];
+    d_sigma = r[(2 * i) + 1];
+
+    /* Now fit them into the variance window, as wide as this island
+     * wants it. */
+    mu_var = mp.norms[i].mu_var * scale;
+    sigma_var = mp.norms[i].sigma_var * scale;
+    d_mu = (d_mu * mu_var) - (mu_var/2);
+    d_sigma = (d_sigma * sigma_var) - (sigma_var/2);
+
+    /* Add the changes in. */
+    MIXTURE_MU(ms)[i] += d_mu;
+    MIXTURE_SIGMA(ms)[i] += d_sigma;
+
+  }
+
+  /* We do one probability modification per iteration for simplicity's sake. */
+  if ( mp.norms_len > 1 ){
+    d_prob = devol_rng_uniform(&cntr->rng);
+    d_prob = (d_prob * PROB_VAR) - (PROB_VAR/2);
+    p_plus = devol_rng_u32(&cntr->rng) % mp.norms_len;
+    
+    do {
+      p_minus = devol_rng_u32(&cntr->rng) % mp.norms_len;
+    } while ( p_minus == p_plus );
+
+    /* The probability has to sum to 1 after all. */
+    MIXTURE_PROB(ms)[p_plus]  += d_prob;
+    MIXTURE_PROB(ms)[p_minus] -= d_prob;
+
+  }
+
+  //printf("# Perturbations:\n");
+  //print_solution(dest);
+
+  return 0;
+
+}
+
+#define ONE_DIV_ROOT_2_PI 0.39894
+
+/*
+ * The normal PDF function. Calculated with respect to the unit normal 
+ * (sigma=1 and mu=0). To use diff normal params, shift the passed argument 
+ * correctly.
+ */
+double _normal_pdf(double x){
+
+  return ONE_DIV_ROOT_2_PI * exp(-( .5 * x * x ));
+
+}
+
+/*
+ * Calculate the maximum likelihood of the passed point with respect to the
+ * normal distributions of the passed solution.
+ *
+ * The normal PDF:
+ *
+ *   ( 1 / abs(ROOT_2_PI*sigma) ) * exp( -(x-mu)^2 / 2*sigma^2 )
+ *
+ */
+double _do_mle_point_estimate(struct mixture_solution *s, double x){
+
+  int i;
+
+  double sum = 0.0;
+  double samp;
+  double *mu = MIXTURE_MU(s);
+  double *sigma = MIXTURE_SIGMA(s);
+  double *prob = MIXTURE_PROB(s);
+
+  /* For each normal distribution: */
+  for ( i = 0; i < s->len; i++){
+
+    /* Calculate the value of the normal PDF for the params. */
+    samp = _normal_pdf( (x - mu[i]) / sigma[i] ) / sigma[i];
+
+    /* And add it into the sum. */
+    sum += prob[i] * samp;
+
+  }
+
+  /* Return the sum; which is now the MLE for the passed data point. */
+  return sum;
+
+}
+
+/*
+ * Calculate the maximum likelihood function for the passed parameters. For
+ * each data point, calculate the sum of the weighted normal log probability.
+ */
+double mixture_fitness(solution_t *solution){
+
+  int i;
+  
+  double mle;
+  double fitness = 0.0;
+
+  struct mixture_problem mp;
+  struct mixture_solution *ms = solution->private.ptr;
+
+  if ( ms->solved )
+    return ms->mle;
+
+  _mixture_problem(solution, &mp);
+
+  /* For each data point, calculate the MLE estimate. Then take the log, and
+   * finally add it into our fitness value. */
+  for ( i = 0; i < mp.sample_count; i++){
+
+    mle = _do_mle_point_estimate(ms, mp.samples[i]);
+    fitness += log(mle);
+
+  }
+
+  /* Since we want a value close to zero, we simply take an arbitrary ceiling
+   * value for the fitnees, and return the distance the computed MLE is from
+   * that fitness. */
+  ms->solved = 1;
+  ms->mle = FITNESS_CEILING - fitness;
+  return ms->mle;
+
+}
+
+/*
+ * Initialize a solution to hold a random guess as to what the mixture of
+ * distributions will be. We assume that each solution passed already has its
+ * functions set up properly, so we can ignore that part of initialization.
+ */
+int mixture_init(solution_t *solution){
+
+  int i;
+  double tmp = 0;
+  double mu, sigma;
+  struct mixture_problem mp;
+  struct mixture_solution *msol;
+  struct devol_controller *cont = solution->cont;
+
+  _mixture_problem(solution, &mp);
+
+  /* The engine hands us the genome slot; the parameters follow the struct
+   * in the same slot. */
+  msol = (struct mixture_solution *)solution->private.ptr;
+  if ( ! msol )
+    return -1;
+
+  msol->solved = 0;
+  msol->len = mp.norms_len;
+  for ( i = 0; i < mp.norms_len; i++){
+    /* Generate a random number on the mu interval. */
+    tmp = devol_rng_uniform(&cont->rng);
+    mu = (tmp * (mp.norms[i].mu_max - mp.norms[i].mu_min)) +
+      mp.norms[i].mu_min;
+
+    /* Generate a random number on the sigma interval. */
+    tmp = devol_rng_uniform(&cont->rng);
+    sigma = (tmp * (mp.norms[i].sigma_max - mp.norms[i].sigma_min)) +
+      mp.norms[i].sigma_min;
+    
+    /* And set the msol fields. */
+    MIXTURE_MU(msol)[i] = mu;
+    MIXTURE_SIGMA(msol)[i] = sigma;
+    MIXTURE_PROB(msol)[i] = 1.0 / mp.norms_len;
+
+  }
+
+  return 0;
+
+}
+
+/*
+ * Print a solution out. In a pretty way.
+ */
+void mixture_print_solution(solution_t *s){
+
+  int i;
+  struct mixture_solution *ms = s->private.ptr;
+
+  printf("# Solution: (fitness = %lf)\n", ms->mle);
+  for ( i = 0; i < ms->len; i++){
+    printf("#  mu = %.4lf sigma = %.4lf prob = %.4lf\n", 
+	   MIXTURE_MU(ms)[i], MIXTURE_SIGMA(ms)[i], MIXTURE_PROB(ms)[i]);
+  }
+
+}
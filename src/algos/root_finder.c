@@ -17,11 +17,21 @@
  *   variance      <double>             How much to vary each solution when it
  *                                      is bred.
  *   seed          <s1,s2,s3>           3 unsigned short integer seed values
- *                                      for the drand48() family of random 
- *                                      functions.
+ *                                      for the random number generator.
  *   converge      N/A                  If specified terminate the algorithm
  *                                      when the average population fitness is
  *                                      less than variance.
+ *   window        <integer>            With converge, also terminate if the
+ *                                      average or best fitness has not
+ *                                      improved over this many generations.
+ *   epsilon       <double>             Smallest change in fitness per
+ *                                      generation that counts as improving
+ *                                      (default 1e-6).
+ *   record        <file>               Append a binary record of each
+ *                                      generation to file (see devol2evol).
+ *   processes     <integer>            Evolve the population in this many
+ *                                      worker processes (one island each)
+ *                                      instead of sequentially.
  *   verbose       N/A                  Will be verbose.
  *   defaults      N/A                  Print the default values for the 
  *                                      variables w/ defaults.
@@ -37,6 +47,7 @@
  */
 
 #include <devol.h>
+#include <root_finder.h>
 
 #include <math.h>
 #include <stdio.h>
@@ -48,11 +59,6 @@
 /*
  * Prototypes for functions we need.
  */
-int     mutate(solution_t *par1, solution_t *par2, 
-	       solution_t *dest);
-double  fitness(solution_t *solution);
-int     init(solution_t *solution);
-int     destroy(solution_t *solution);
 double *parse_double_array(char *list, int *count);
 int    *parse_integer_array(char *list, int *count);
 void    die(char *msg);
@@ -65,17 +71,22 @@ int converge = 0;
 int verbose  = 0;
 int defaults = 0;
 int help     = 0;
+int stats    = 0;
+int perf     = 0;
+char *record_file = NULL;
+int processes = 0;
 
 /*
- * Default fields that define the behavior of this algorithm.
+ * Default fields that define the behavior of this algorithm. The polynomial,
+ * the search bounds and the variance live in root_finder_ops.c.
  */
-double *coeffs;
-int    num_coeffs;
-double x_min = -1.0;
-double x_max =  1.0;
 int    pop_size = 100;
 int    max_iter = 100;
-double variance = .001;
+
+struct devol_converge conv = {
+  .criteria = DEVOL_CONVERGE_TARGET,
+  .epsilon = 1e-6,
+};
 
 struct devol_params algo_params = {
 
@@ -109,10 +120,10 @@ struct devol_params algo_params = {
   /*
    * These are the functions used to actually run the algorithm.
    */
-  .mutate  = mutate,
-  .fitness = fitness,
-  .init    = init,
-  .destroy = destroy,
+  .mutate  = root_mutate,
+  .fitness = root_fitness,
+  .init    = root_init,
+  .destroy = root_destroy,
   .swap    = NULL,   /* This function is optional. */
 
 };
@@ -131,14 +142,20 @@ struct option rf_opts[] = {
   {"max-iter", 1, NULL, 'm'},
   {"variance", 1, NULL, 'V'},
   {"seed", 1, NULL, 's'},
+  {"window", 1, NULL, 'w'},
+  {"epsilon", 1, NULL, 'e'},
+  {"record", 1, NULL, 'O'},
+  {"processes", 1, NULL, 'j'},
   {"converge", 0, &converge, 'C'},
   {"verbose", 0, &verbose, 'v'},
+  {"stats", 0, &stats, 'T'},
+  {"perf", 0, &perf, 'P'},
   {"defaults", 0, &defaults, 'd'},
   {"help", 0, &help, 'h'},
   {NULL, 0, NULL, 0},
 
 };
-char *args = "c:N:X:p:r:b:m:V:s:Cvdh";
+char *args = "c:N:X:p:r:b:m:V:s:w:e:O:j:Cvdh";
 extern char *optarg;
 
 
@@ -211,6 +228,26 @@ int main(int argc, char **argv){
 	     rng_seed[0], rng_seed[1], rng_seed[2]);
       free(rng_seed);
       break;
+    case 'w': /* convergence window */
+      conv.window = (int) strtol(optarg, &not_ok, 0);
+      if ( *not_ok || conv.window < 0 )
+	die("Unable to parse convergence window.\n");
+      if ( conv.window )
+	conv.criteria |= DEVOL_CONVERGE_DERIVATIVE | DEVOL_CONVERGE_STAGNATION;
+      break;
+    case 'e': /* convergence epsilon */
+      conv.epsilon = strtod(optarg, &not_ok);
+      if ( *not_ok )
+	die("Unable to parse convergence epsilon.\n");
+      break;
+    case 'O': /* where to record the generations */
+      record_file = strdup(optarg);
+      break;
+    case 'j': /* worker processes */
+      processes = (int) strtol(optarg, &not_ok, 0);
+      if ( *not_ok || processes < 0 )
+	die("Unable to parse the number of processes.\n");
+      break;
     case 'C': /* We should check for convergence. */
       converge = 1;
       break;
@@ -266,10 +303,17 @@ int run(){
 
   int i;
   int iterations = 0;
-  double avg_fitness;
   struct gene_pool seq_pool;
 
-  gene_pool_create_seq(&seq_pool, pop_size, algo_params);
+  algo_params.perf = perf;
+  if ( processes ){
+    if ( gene_pool_create_mp(&seq_pool, pop_size, processes, algo_params) )
+      die("Unable to start the worker processes.\n");
+  } else {
+    gene_pool_create_seq(&seq_pool, pop_size, algo_params);
+  }
+  if ( record_file && gene_pool_record(&seq_pool, record_file) )
+    die("Unable to open the record file.\n");
 
   if ( verbose ){
     printf("Initial population:\n");
@@ -278,16 +322,21 @@ int run(){
 
   while ( iterations++ < max_iter ){
 
-    gene_pool_iterate_seq(&seq_pool);
+    if ( processes ){
+      if ( gene_pool_iterate(&seq_pool) )
+	die("A worker process died.\n");
+    } else {
+      gene_pool_iterate_seq(&seq_pool);
+    }
 
     if ( converge ){
-      avg_fitness = gene_pool_avg_fitness(&seq_pool);
-      if ( avg_fitness <= variance ){
-	printf("Convergence after %d iterations: avg fitness=%lf\n",
-	       iterations, avg_fitness);
+      conv.target = variance;
+      if ( gene_pool_converged(&seq_pool, &conv) ){
+	printf("Convergence after %d iterations (%s): avg fitness=%lf\n",
+	       iterations, devol_converge_name(conv.fired), conv.avg);
 	break;
       } else {
-	printf("Iteration (%d): %lf\n", iterations, avg_fitness);
+	printf("Iteration (%d): %lf\n", iterations, conv.avg);
       }
     }
 
@@ -302,75 +351,15 @@ int run(){
     }	 
   }
 
-  return 0;
-
-}
-
-/*
- * Very simple. Just modify the X value by a small amount.
- */
-int mutate(solution_t *par1, solution_t *par2, 
-	   solution_t *dest){
-
-  double tmp;
-  double base;
-  double variation;
-
-  /* Pick the better solution of the two and then vary it by a little bit. */
-  if ( par1->fitness_val >= par2->fitness_val )
-    base = par1->private.dp_fp;
-  else
-    base = par2->private.dp_fp;
-
-  /* And vary it by a little bit. */
-  devol_rand48(par1->cont->rstate, &(par1->cont->rdata), &tmp);
-  variation = (tmp * variance) - (variance/2);
-
-  /* Initialize and set the destination solution. */
-  dest->private.dp_fp = base + variation;  
-
-  return 0;
-
-}
-
-/*
- * Compute the polynomial for the passed solution's x value.
- */
-double fitness(solution_t *solution){
-
-  int i;
-  double x = solution->private.dp_fp;
-  double power = 1;
-  double sum = 0.0;
-  
-  for ( i = num_coeffs-1; i >= 0; i--){
-    sum += (coeffs[i] * power);
-    power *= x;
-  }
-
-  return fabs(sum);
-
-}
-
-/*
- * Generate a solution randomly on the interval [x_min,x_max].
- */
-int init(solution_t *solution){
-
-  double sol;
-
-  /* This gets a random number in the same window size as [x_min,x_max]. Then
-   * scale it to the correct offset by subtracting x_min. */
-  sol = erand48(algo_params.rstate) * (x_max - x_min);
-  sol += x_min;
-
-  solution->private.dp_fp = sol;
-
-  return 0;
-
-}
+  if ( record_file && gene_pool_record_stop(&seq_pool) )
+    fprintf(stderr, "Unable to write all of %s.\n", record_file);
 
-int destroy(solution_t *solution){
+  if ( stats )
+    gene_pool_print_stats(&seq_pool, stdout);
+  if ( perf )
+    gene_pool_print_perf(&seq_pool, stdout);
+  if ( processes )
+    gene_pool_destroy_mp(&seq_pool);
 
   return 0;
 
@@ -0,0 +1,36 @@
+/*
+ * The root finding problem. See root_finder_ops.c.
+ */
+
+#ifndef _ROOT_FINDER_H
+#define _ROOT_FINDER_H
+
+struct solution;
+
+/*
+ * One set up of the problem. A gene pool whose params.problem points at one
+ * of these solves that; otherwise the globals below are used.
+ */
+struct root_problem {
+
+  double *coeffs;
+  int     num_coeffs;
+  double  x_min;
+  double  x_max;
+  double  variance;
+
+};
+
+extern double *coeffs;
+extern int     num_coeffs;
+extern double  x_min;
+extern double  x_max;
+extern double  variance;
+
+int    root_mutate(struct solution *par1, struct solution *par2,
+		   struct solution *dest);
+double root_fitness(struct solution *solution);
+int    root_init(struct solution *solution);
+int    root_destroy(struct solution *solution);
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * The root finding problem: the call backs the engine uses to find a root of
+ * a polynomial. Used by root_finder.c and by the benchmarks; with the
+ * coefficients 1,0,-5 this is the square root of 5 problem.
+ */
+
+#include <devol.h>
+#include <root_finder.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * The polynomial, where to start looking and how much to vary each solution
+ * when it is bred.
+ */
+double *coeffs;
+int    num_coeffs;
+double x_min = -1.0;
+double x_max =  1.0;
+double variance = .001;
+
+/*
+ * The problem solution is being solved for: its gene pool's, or the globals.
+ */
+static void _root_problem(solution_t *solution, struct root_problem *rp){
+
+  struct root_problem *p = (struct root_problem *)devol_problem(solution);
+
+  if ( p ){
+    *rp = *p;
+    return;
+  }
+
+  rp->coeffs = coeffs;
+  rp->num_coeffs = num_coeffs;
+  rp->x_min = x_min;
+  rp->x_max = x_max;
+  rp->variance = variance;
+
+}
+
+/*
+ * Very simple. Just modify the X value by a small amount.
+ */
+int root_mutate(solution_t *par1, solution_t *par2, 
+		solution_t *dest){
+
+  double tmp;
+  double base;
+  double variation;
+  struct root_problem rp;
+
+  _root_problem(par1, &rp);
+
+  /* Pick the better solution of the two and then vary it by a little bit. */
+  if ( par1->fitness_val >= par2->fitness_val )
+    base = par1->private.dp_fp;
+  else
+    base = par2->private.dp_fp;
+
+  /* And vary it by a little bit. */
+  tmp = devol_rng_uniform(&par1->cont->rng);
+  rp.variance *= devol_mutation_scale(dest);
+  variation = (tmp * rp.variance) - (rp.variance/2);
+
+  /* Initialize and set the destination solution. */
+  dest->private.dp_fp = base + variation;  
+
+  return 0;
+
+}
+
+/*
+ * Compute the polynomial for the passed solution's x value.
+ */
+double root_fitness(solution_t *solution){
+
+  int i;
+  double x = solution->private.dp_fp;
+  double power = 1;
+  double sum = 0.0;
+  struct root_problem rp;
+
+  _root_problem(solution, &rp);
+  for ( i = rp.num_coeffs-1; i >= 0; i--){
+    sum += (rp.coeffs[i] * power);
+    power *= x;
+  }
+
+  return fabs(sum);
+
+}
+
+/*
+ * Generate a solution randomly on the interval [x_min,x_max].
+ */
+int root_init(solution_t *solution){
+
+  double sol;
+  struct root_problem rp;
+
+  _root_problem(solution, &rp);
+
+  /* This gets a random number in the same window size as [x_min,x_max]. Then
+   * scale it to the correct offset by subtracting x_min. */
+  sol = devol_rng_uniform(&solution->cont->rng) * (rp.x_max - rp.x_min);
+  sol += rp.x_min;
+
+  solution->private.dp_fp = sol;
+
+  return 0;
+
+}
+
+int root_destroy(solution_t *solution){
+
+  return 0;
+
+}
@@ -0,0 +1,259 @@
+/*
+ * Test asynchronous fitness evaluation. Evaluations are handed to a few
+ * "simulator" threads that sit on them for a moment and complete them in
+ * whatever order they finish. The same deterministic problem is evolved
+ * with plain fitness() calls and then asynchronously with the sequential
+ * algorithm, with threads and with a pipeline, and the final populations have
+ * to be bitwise identical. The number of evaluations out at once must never
+ * go over what was asked for.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define GENES      4
+#define SIMULATORS 3
+#define IN_FLIGHT  8
+
+int    mutate(solution_t *par1, solution_t *par2, solution_t *dest);
+double fitness(solution_t *solution);
+int    init(solution_t *solution);
+int    submit(solution_t *solution, struct devol_async *handle, void *arg);
+
+struct devol_params params = {
+
+  .mutate = mutate,
+  .fitness = fitness,
+  .init = init,
+  .destroy = NULL,
+  .swap = NULL,
+
+  .gene_dispersal_factor = .05,
+  .reproduction_rate = .5,
+  .breed_fitness = .3,
+  .rstate = { 2837, 345, 99 },
+
+  .genome_size = sizeof(double) * GENES,
+  .islands = 6,
+  .deterministic = 1,
+
+};
+
+int solutions = 300;
+int generations = 30;
+
+/* Jobs waiting for a simulator. */
+struct job {
+  solution_t         *solution;
+  struct devol_async *handle;
+};
+
+pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  jobs_cond = PTHREAD_COND_INITIALIZER;
+struct job      jobs[4096];
+int             job_count = 0;
+int             stopping = 0;
+
+/* Evaluations out right now, and the most there ever were. */
+volatile int    outstanding = 0;
+volatile int    most = 0;
+
+int mutate(solution_t *par1, solution_t *par2, solution_t *dest){
+
+  int i, cut;
+  double r[GENES];
+  double *a = (double *)par1->private.ptr;
+  double *b = (double *)par2->private.ptr;
+  double *d = (double *)dest->private.ptr;
+
+  cut = devol_rng_u32(&par1->cont->rng) % GENES;
+  devol_rng_fill(&par1->cont->rng, r, GENES);
+  for ( i = 0; i < GENES; i++)
+    d[i] = (i < cut ? a[i] : b[i]) + ((r[i] - .5) * .01);
+
+  return 0;
+
+}
+
+double fitness(solution_t *solution){
+
+  int i;
+  double f = 0;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    f += fabs((g[i] * g[i]) - 5);
+
+  return f;
+
+}
+
+int init(solution_t *solution){
+
+  int i;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    g[i] = devol_rng_uniform(&solution->cont->rng) * 10.0;
+
+  return 0;
+
+}
+
+int submit(solution_t *solution, struct devol_async *handle, void *arg){
+
+  int now;
+
+  pthread_mutex_lock(&jobs_lock);
+  if ( job_count == sizeof(jobs) / sizeof(jobs[0]) ){
+    pthread_mutex_unlock(&jobs_lock);
+    return -1;
+  }
+  jobs[job_count].solution = solution;
+  jobs[job_count++].handle = handle;
+  now = ++outstanding;
+  if ( now > most )
+    most = now;
+  pthread_cond_signal(&jobs_cond);
+  pthread_mutex_unlock(&jobs_lock);
+
+  return 0;
+
+}
+
+/*
+ * Take the newest job, think about it for a bit and complete it.
+ */
+void *simulator(void *arg){
+
+  struct job job;
+  struct timespec nap = { 0, 20000 };
+
+  for ( ; ; ){
+
+    pthread_mutex_lock(&jobs_lock);
+    while ( ! job_count && ! stopping )
+      pthread_cond_wait(&jobs_cond, &jobs_lock);
+    if ( ! job_count ){
+      pthread_mutex_unlock(&jobs_lock);
+      break;
+    }
+    job = jobs[--job_count];
+    pthread_mutex_unlock(&jobs_lock);
+
+    nanosleep(&nap, NULL);
+
+    pthread_mutex_lock(&jobs_lock);
+    outstanding--;
+    pthread_mutex_unlock(&jobs_lock);
+    devol_complete(job.handle, job.solution, fitness(job.solution));
+
+  }
+
+  return NULL;
+
+}
+
+/*
+ * Evolve with threads threads (0 for the sequential algorithm) or a
+ * pipeline of breeders and one evaluator, and copy out the population.
+ */
+int evolve(int async, int threads, int breeders, double *out){
+
+  int i, g;
+  struct gene_pool pool;
+  struct devol_params p = params;
+
+  if ( async ){
+    p.submit = submit;
+    p.in_flight = IN_FLIGHT;
+  }
+
+  if ( breeders )
+    i = gene_pool_create_pipeline(&pool, solutions, breeders, 1, p);
+  else if ( threads )
+    i = gene_pool_create(&pool, solutions, threads, p);
+  else
+    i = gene_pool_create_seq(&pool, solutions, p);
+  if ( i )
+    return DEVOL_ERR;
+
+  for ( g = 0; g < generations; g++){
+    if ( threads || breeders )
+      gene_pool_iterate(&pool);
+    else
+      gene_pool_iterate_seq(&pool);
+  }
+
+  for ( i = 0; i < solutions; i++){
+    out[i * (GENES + 1)] = pool.solutions[i].fitness_val;
+    memcpy(&out[(i * (GENES + 1)) + 1], pool.solutions[i].private.ptr,
+	   sizeof(double) * GENES);
+  }
+
+  gene_pool_destroy(&pool);
+
+  return DEVOL_OK;
+
+}
+
+int main(int argc, char **argv){
+
+  int i, fail = 0;
+  size_t len = sizeof(double) * solutions * (GENES + 1);
+  double *ref = (double *)malloc(len);
+  double *pop = (double *)malloc(len);
+  pthread_t sims[SIMULATORS];
+
+  struct {
+    char *name;
+    int   threads;
+    int   breeders;
+    int   limit;
+  } runs[] = {
+    { "sequential", 0, 0, IN_FLIGHT },
+    { "3 threads", 3, 0, 3 * IN_FLIGHT },
+    { "2+1 pipeline", 0, 2, 3 * IN_FLIGHT },
+  };
+
+  for ( i = 0; i < SIMULATORS; i++)
+    pthread_create(&sims[i], NULL, simulator, NULL);
+
+  if ( evolve(0, 0, 0, ref) ){
+    printf("FAIL: unable to run the problem.\n");
+    return 1;
+  }
+
+  for ( i = 0; i < sizeof(runs) / sizeof(runs[0]); i++){
+
+    most = 0;
+    if ( evolve(1, runs[i].threads, runs[i].breeders, pop) ){
+      printf("%s: unable to run the problem\n", runs[i].name);
+      fail = 1;
+      continue;
+    }
+
+    printf("%s: %s, at most %d in flight\n", runs[i].name,
+	   memcmp(ref, pop, len) ? "population differs" : "identical", most);
+    if ( memcmp(ref, pop, len) || most > runs[i].limit || most < 2 )
+      fail = 1;
+
+  }
+
+  pthread_mutex_lock(&jobs_lock);
+  stopping = 1;
+  pthread_cond_broadcast(&jobs_cond);
+  pthread_mutex_unlock(&jobs_lock);
+  for ( i = 0; i < SIMULATORS; i++)
+    pthread_join(sims[i], NULL);
+
+  printf("%s\n", fail ? "FAIL" : "PASS");
+
+  return fail;
+
+}
@@ -0,0 +1,334 @@
+/*
+ * Make sure deterministic mode really is deterministic: evolve the same
+ * problem with the sequential algorithm, with a bunch of different thread
+ * counts and with a few pipelines of breeders and evaluators, and check that
+ * the final populations are bitwise identical. So must the fitness statistics
+ * and the hall of fame the engine keeps. Then it all happens again with the
+ * reproduction rate, breed fitness and dispersal changed halfway through by
+ * gene_pool_set_params(), worker processes included, and once more with
+ * migration along a torus whose interval adapts to the islands' diversity,
+ * and with every island given settings of its own, by island_spread and
+ * then from a list.
+ *
+ * The problem is a small vector version of the square root of 5 problem with
+ * its genome in an engine arena, so dispersal has something to move around.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define GENES 4
+
+int    mutate(solution_t *par1, solution_t *par2, solution_t *dest);
+double fitness(solution_t *solution);
+int    init(solution_t *solution);
+
+struct devol_params params = {
+
+  .mutate = mutate,
+  .fitness = fitness,
+  .init = init,
+  .destroy = NULL,
+  .swap = NULL,
+
+  .gene_dispersal_factor = .05,
+  .reproduction_rate = .5,
+  .breed_fitness = .3,
+  .rstate = { 2837, 345, 99 },
+
+  .genome_size = sizeof(double) * GENES,
+  .islands = 12,
+  .deterministic = 1,
+  .hall_of_fame = 8,
+
+};
+
+int solutions = 600;
+int generations = 100;
+
+/* Thread counts to try; 0 is the sequential algorithm. Then the pipelines as
+ * breeders, evaluators. */
+int runs[] = { 0, 1, 2, 3, 4, 5, 8, 16 };
+int pipelines[][2] = { { 1, 1 }, { 1, 3 }, { 3, 1 }, { 4, 4 } };
+
+/* If set, evolve() switches to these params halfway through. */
+int retune = 0;
+struct devol_params retuned;
+
+int mutate(solution_t *par1, solution_t *par2, solution_t *dest){
+
+  int i, cut;
+  double r[GENES];
+  double *a = (double *)par1->private.ptr;
+  double *b = (double *)par2->private.ptr;
+  double *d = (double *)dest->private.ptr;
+  double scale = devol_mutation_scale(dest);
+
+  cut = devol_rng_u32(&par1->cont->rng) % GENES;
+  devol_rng_fill(&par1->cont->rng, r, GENES);
+  for ( i = 0; i < GENES; i++)
+    d[i] = (i < cut ? a[i] : b[i]) + ((r[i] - .5) * .01 * scale);
+
+  return 0;
+
+}
+
+double fitness(solution_t *solution){
+
+  int i;
+  double f = 0;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    f += fabs((g[i] * g[i]) - 5);
+
+  return f;
+
+}
+
+int init(solution_t *solution){
+
+  int i;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    g[i] = devol_rng_uniform(&solution->cont->rng) * 10.0;
+
+  return 0;
+
+}
+
+/* What gets compared besides the population: the fitness statistics and the
+ * hall of fame's fitnesses and genomes. */
+#define EXTRA (5 + (8 * (GENES + 1)))
+
+/*
+ * Run the problem and copy out each solution's fitness and genome, then the
+ * extras.
+ */
+int evolve(int threads, int breeders, int evaluators, int processes,
+	   double *out){
+
+  int i, g, len;
+  struct gene_pool pool;
+  struct devol_fitness fit;
+  solution_t *hof;
+
+  if ( processes )
+    i = gene_pool_create_mp(&pool, solutions, processes, params);
+  else if ( breeders )
+    i = gene_pool_create_pipeline(&pool, solutions, breeders, evaluators,
+				  params);
+  else if ( threads )
+    i = gene_pool_create(&pool, solutions, threads, params);
+  else
+    i = gene_pool_create_seq(&pool, solutions, params);
+  if ( i )
+    return DEVOL_ERR;
+
+  for ( g = 0; g < generations; g++){
+    if ( retune && g == generations / 2 )
+      gene_pool_set_params(&pool, retuned);
+    if ( threads || breeders || processes )
+      gene_pool_iterate(&pool);
+    else
+      gene_pool_iterate_seq(&pool);
+  }
+
+  for ( i = 0; i < solutions; i++){
+    out[i * (GENES + 1)] = pool.solutions[i].fitness_val;
+    memcpy(&out[(i * (GENES + 1)) + 1], pool.solutions[i].private.ptr,
+	   sizeof(double) * GENES);
+  }
+
+  out += solutions * (GENES + 1);
+  memset(out, 0, sizeof(double) * EXTRA);
+  gene_pool_get_fitness(&pool, &fit);
+  out[0] = fit.mean;
+  out[1] = fit.variance;
+  out[2] = fit.min;
+  out[3] = fit.max;
+  out[4] = gene_pool_best_fitness(&pool);
+  hof = gene_pool_hall_of_fame(&pool, &len);
+  for ( i = 0; i < len; i++){
+    out[5 + (i * (GENES + 1))] = hof[i].fitness_val;
+    memcpy(&out[6 + (i * (GENES + 1))], hof[i].private.ptr,
+	   sizeof(double) * GENES);
+  }
+
+  gene_pool_destroy(&pool);
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Check that 3 threads, a 2+2 pipeline and 3 worker processes all end up
+ * where the sequential run in ref did.
+ */
+int followers(char *what, double *ref, double *pop, size_t len){
+
+  int r, failed = 0;
+
+  for ( r = 0; r < 3; r++){
+
+    if ( evolve(r == 0 ? 3 : 0, r == 1 ? 2 : 0, 2, r == 2 ? 3 : 0, pop) ){
+      printf("Unable to make a gene pool.\n");
+      return 1;
+    }
+
+    printf("%s, %s: %s\n", what,
+	   r == 0 ? "3 threads" : (r == 1 ? "2+2 pipeline" : "3 processes"),
+	   memcmp(ref, pop, len) ? "population differs from the sequential run"
+	   : "identical");
+    if ( memcmp(ref, pop, len) )
+      failed = 1;
+
+  }
+
+  return failed;
+
+}
+
+int main(int argc, char **argv){
+
+  int r;
+  int failed = 0;
+  size_t len = sizeof(double) * ((solutions * (GENES + 1)) + EXTRA);
+  double *ref = (double *)malloc(len);
+  double *pop = (double *)malloc(len);
+  struct devol_island_params list[params.islands];
+  struct gene_pool refused;
+
+  printf("solutions=%d islands=%d generations=%d\n",
+	 solutions, params.islands, generations);
+
+  for ( r = 0; r < sizeof(runs) / sizeof(runs[0]); r++){
+
+    if ( evolve(runs[r], 0, 0, 0, r ? pop : ref) ){
+      printf("Unable to make a gene pool.\n");
+      return 1;
+    }
+    if ( r == 0 ){
+      printf("sequential: best fitness %lf, mean %lf\n",
+	     ref[solutions * (GENES + 1) + 4], ref[solutions * (GENES + 1)]);
+      continue;
+    }
+
+    if ( memcmp(ref, pop, len) ){
+      printf("%2d threads: population differs from the sequential run\n",
+	     runs[r]);
+      failed = 1;
+    } else {
+      printf("%2d threads: identical\n", runs[r]);
+    }
+
+  }
+
+  for ( r = 0; r < sizeof(pipelines) / sizeof(pipelines[0]); r++){
+
+    if ( evolve(0, pipelines[r][0], pipelines[r][1], 0, pop) ){
+      printf("Unable to make a gene pool.\n");
+      return 1;
+    }
+
+    if ( memcmp(ref, pop, len) ){
+      printf("%d+%d pipeline: population differs from the sequential run\n",
+	     pipelines[r][0], pipelines[r][1]);
+      failed = 1;
+    } else {
+      printf("%d+%d pipeline: identical\n", pipelines[r][0], pipelines[r][1]);
+    }
+
+  }
+
+  /* Retuned halfway: the sequential run has to come out different from
+   * before, and everything else has to follow it. */
+  retune = 1;
+  retuned = params;
+  retuned.reproduction_rate = .3;
+  retuned.breed_fitness = .15;
+  retuned.gene_dispersal_factor = .2;
+
+  if ( evolve(0, 0, 0, 0, pop) ){
+    printf("Unable to make a gene pool.\n");
+    return 1;
+  }
+  if ( ! memcmp(ref, pop, len) ){
+    printf("retuned: sequential run did not change\n");
+    failed = 1;
+  }
+  memcpy(ref, pop, len);
+  failed |= followers("retuned", ref, pop, len);
+
+  /* Migration on a torus instead of random swaps. */
+  retune = 0;
+  params.migration = DEVOL_MIGRATE_TORUS;
+  params.migrants = 2;
+  params.migration_interval = 8;
+  params.migration_diversity = .2;
+
+  if ( evolve(0, 0, 0, 0, pop) ){
+    printf("Unable to make a gene pool.\n");
+    return 1;
+  }
+  if ( ! memcmp(ref, pop, len) ){
+    printf("torus: sequential run did not change\n");
+    failed = 1;
+  }
+  memcpy(ref, pop, len);
+  failed |= followers("torus", ref, pop, len);
+
+  /* And with the islands spread over a range of settings. */
+  params.island_spread = 3;
+
+  if ( evolve(0, 0, 0, 0, pop) ){
+    printf("Unable to make a gene pool.\n");
+    return 1;
+  }
+  if ( ! memcmp(ref, pop, len) ){
+    printf("spread: sequential run did not change\n");
+    failed = 1;
+  }
+  memcpy(ref, pop, len);
+  failed |= followers("spread", ref, pop, len);
+
+  /* Then a list of settings, one per island. Without islands set there is
+   * no telling how long the list is, so that has to be refused. */
+  for ( r = 0; r < params.islands; r++){
+    list[r].reproduction_rate = .2 + (.05 * r);
+    list[r].breed_fitness = .1 + (.05 * (r % 5));
+    list[r].mutation_scale = .5 + (.5 * (r % 4));
+  }
+  params.island_spread = 0;
+  params.island_params = list;
+
+  r = params.islands;
+  params.islands = 0;
+  if ( ! gene_pool_create_seq(&refused, solutions, params) ){
+    printf("list: made a gene pool without islands set\n");
+    gene_pool_destroy(&refused);
+    failed = 1;
+  }
+  params.islands = r;
+
+  if ( evolve(0, 0, 0, 0, pop) ){
+    printf("Unable to make a gene pool.\n");
+    return 1;
+  }
+  if ( ! memcmp(ref, pop, len) ){
+    printf("list: sequential run did not change\n");
+    failed = 1;
+  }
+  memcpy(ref, pop, len);
+  failed |= followers("list", ref, pop, len);
+
+  printf("%s\n", failed ? "FAIL" : "PASS");
+
+  return failed;
+
+}
@@ -0,0 +1,146 @@
+/*
+ * Watch a running gene pool that is publishing its stats with
+ * gene_pool_export().
+ *
+ * Usage:
+ *
+ *   ./devol-top [-n seconds] [-1] <pid|name>
+ *
+ *   -n   Seconds between updates (default 1).
+ *   -1   Print the stats once and exit instead of refreshing the screen.
+ *
+ * Give it the pid of a program that exported with the default name (e.g.
+ * mixture --export) or the shared memory name it used. Runs until the gene
+ * pool stops exporting.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+void die(char *msg){
+
+  fprintf(stderr, "%s", msg);
+  exit(1);
+
+}
+
+void show(struct devol_export *e, struct devol_export *last, double secs){
+
+  int i, p;
+  uint64_t total;
+  double gps = 0;
+  char *phases[] = { "fitness", "sort", "breed", "replace", "wait",
+		     "disperse" };
+
+  if ( last && secs > 0 )
+    gps = (e->generation - last->generation) / secs;
+
+  printf("pid %d: %u solutions on %u islands, %u threads%s\n", e->pid,
+	 e->population, e->islands, e->thread_count,
+	 e->done ? " (done)" : "");
+  printf("generation %u (%.1lf/s), running for %.1lf s\n", e->generation,
+	 gps, (e->updated - e->started) / 1.0e9);
+  printf("evaluations %llu (%.0lf/s)\n",
+	 (unsigned long long)e->evaluations, e->rate);
+  if ( e->fitness.count )
+    printf("fitness mean %lf  stddev %lf\n"
+	   "fitness min %lf  max %lf  best ever %lf\n", e->fitness.mean,
+	   sqrt(e->fitness.variance), e->fitness.min, e->fitness.max, e->best);
+
+  printf("\n%-8s", "thread");
+  for ( p = 0; p < DEVOL_PHASES; p++)
+    printf(" %10s", phases[p]);
+  printf("     busy %%\n");
+
+  for ( i = 0; i <= (int)e->thread_count; i++){
+
+    if ( i < (int)e->thread_count )
+      printf("%-8d", i);
+    else
+      printf("%-8s", "main");
+
+    total = 0;
+    for ( p = 0; p < DEVOL_PHASES; p++){
+      printf(" %10.1lf", e->threads[i][p] / 1.0e6);
+      total += e->threads[i][p];
+    }
+    /* The calling thread's waits are not timed when there are workers. */
+    if ( i == (int)e->thread_count && e->thread_count )
+      printf(" %10s\n", "-");
+    else
+      printf(" %10.1lf\n", total ?
+	     100.0 * (total - e->threads[i][DEVOL_PHASE_WAIT]) / total : 0);
+
+  }
+  printf("(phase times in ms)\n");
+
+}
+
+int main(int argc, char **argv){
+
+  int opt;
+  int once = 0;
+  double interval = 1;
+  char name[64];
+  struct devol_export *page;
+  struct devol_export now, last;
+
+  while ( (opt = getopt(argc, argv, "n:1")) != -1 ){
+    switch ( opt ){
+    case 'n':
+      interval = atof(optarg);
+      break;
+    case '1':
+      once = 1;
+      break;
+    default:
+      die("Usage: devol-top [-n seconds] [-1] <pid|name>\n");
+    }
+  }
+
+  if ( optind >= argc || interval <= 0 )
+    die("Usage: devol-top [-n seconds] [-1] <pid|name>\n");
+
+  if ( isdigit(argv[optind][0]) )
+    snprintf(name, sizeof(name), DEVOL_EXPORT_NAME, atoi(argv[optind]));
+  else
+    snprintf(name, sizeof(name), "%s", argv[optind]);
+
+  page = devol_export_open(name);
+  if ( ! page )
+    die("No gene pool is exporting under that name.\n");
+
+  if ( devol_export_read(page, &last) )
+    die("Unable to get a consistent copy of the stats.\n");
+  if ( once ){
+    show(&last, NULL, 0);
+    return 0;
+  }
+
+  for ( ; ; ){
+
+    usleep(interval * 1.0e6);
+    if ( devol_export_read(page, &now) )
+      continue;
+
+    printf("\033[H\033[2J");
+    show(&now, &last, (now.updated - last.updated) / 1.0e9);
+    fflush(stdout);
+
+    if ( now.done )
+      break;
+    last = now;
+
+  }
+
+  devol_export_close(page);
+
+  return 0;
+
+}
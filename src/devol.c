@@ -6,6 +6,7 @@
 
 #include <devol.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -29,6 +30,10 @@ int  gene_pool_create(struct gene_pool *pool, int solutions, int threads,
   time_t t_stop;
   struct timeb tmp_time;
 
+  /* A list of island settings is only as long as the islands asked for. */
+  if ( params.island_params && params.islands < 1 )
+    return DEVOL_ERR;
+
   /* I lied in the above comment, actually copy in our params first. */
   pool->params = params;
   if ( pool->params.breed_fitness > .5 ){
@@ -36,11 +41,39 @@ int  gene_pool_create(struct gene_pool *pool, int solutions, int threads,
     pool->params.breed_fitness = .5;
   }
 
+  /* Dispersal happens on the calling thread; give it a stream of its own
+   * after the worker threads' streams. */
+  devol_rng_init(&pool->controller.rng, params.rng_type, params.rstate,
+		 threads);
+  memset(&pool->controller.stats, 0, sizeof(struct devol_stats));
+  pool->controller.perf = NULL;
+  pool->controller.trace = NULL;
+  pool->controller.async = NULL;
+  pool->controller.gene_pool = pool;
+  pool->recorder = NULL;
+  pool->exporter = NULL;
+  pool->mp = NULL;
+  pool->pipeline = NULL;
+
+  /* By default each thread gets one island. The islands are laid out over
+   * the solution array, so the thread pool needs to know its size too. */
+  pool->islands = params.islands > 0 ? params.islands : threads;
+  pool->generation = 0;
+  pool->solution_count = solutions;
+
   /* Init the thread pool. */
   err = thread_pool_init(&(pool->workers), pool, threads, solutions);
   if ( err )
     return DEVOL_ERR;
 
+  /* The threads wait on the sync_lock before touching anything so it is safe
+   * to hand out the genome arenas now. */
+  err = _gene_pool_init_arenas(pool, pool->workers.controllers, threads);
+  if ( ! err )
+    err = _gene_pool_init_batches(pool, pool->workers.controllers, threads);
+  if ( err )
+    return DEVOL_ERR;
+
   /* Here is the first use of the call back functions. We allocate a bunch
    * of solutions which we initialize with the provided call back function. */
   pool->solutions = (solution_t *)malloc(sizeof(solution_t) * solutions);
@@ -49,6 +82,20 @@ int  gene_pool_create(struct gene_pool *pool, int solutions, int threads,
 
   pool->solution_count = solutions;
 
+  if ( _gene_pool_init_fitness(pool) )
+    return DEVOL_ERR;
+
+  /* The workers are still waiting on the sync_lock so their rings can be
+   * handed out from here too. */
+  if ( params.trace ){
+    for ( i = 0; i < threads; i++){
+      if ( devol_trace_init(&pool->workers.controllers[i], params.trace) )
+	return DEVOL_ERR;
+    }
+    if ( devol_trace_init(&pool->controller, params.trace) )
+      return DEVOL_ERR;
+  }
+
   ftime(&tmp_time);
   t_start = (tmp_time.time * 1000) + tmp_time.millitm;
   INFO("Generating %d initial solutions... ", solutions);
@@ -66,7 +113,24 @@ int  gene_pool_create(struct gene_pool *pool, int solutions, int threads,
 	pool->solutions[i].cont = &(pool->workers.controllers[j]);
     }
 
+    if ( pool->arenas ){
+      pool->solutions[i].private.ptr = 
+	devol_arena_alloc(pool->solutions[i].cont->arena);
+      if ( ! pool->solutions[i].private.ptr ){
+	if ( pool->solutions[i].cont->trace )
+	  _devol_trace(pool->solutions[i].cont, DEVOL_EVENT_ALLOC_FAIL, i,
+		       devol_clock_ns(), 0);
+	return DEVOL_ERR;
+      }
+    }
+
+    if ( params.deterministic )
+      devol_rng_stream(&pool->solutions[i].cont->rng, params.rstate,
+		       0, i, DEVOL_STREAM_INIT);
+
     params.init(&(pool->solutions[i]));
+    pool->solutions[i].fitness_val = NAN;
+    pool->solutions[i].cont->stats.inits++;
 
   }
   INFO("Done\n");
@@ -95,6 +159,10 @@ int  gene_pool_create_seq(struct gene_pool *pool, int solutions,
   time_t t_stop;
   struct timeb tmp_time;
 
+  /* A list of island settings is only as long as the islands asked for. */
+  if ( params.island_params && params.islands < 1 )
+    return DEVOL_ERR;
+
   pool->params = params;
   if ( pool->params.breed_fitness > .5 ){
     printf("# Warning: breed fitness > .5. Setting to .5\n");
@@ -112,34 +180,45 @@ int  gene_pool_create_seq(struct gene_pool *pool, int solutions,
 
   pool->solution_count = solutions;
 
-  /* Here we calculate the gene_pool characteristics: breeder_window,
-   * reproduction rate, etc, and allocate out the new_colutions memory. We do
-   * this before we initialize the initial population of solutions so that if
-   * this call fails, we wont have to deinit the population before freeing
-   * that memory. */
-  pool->new_count = (int)(params.reproduction_rate * solutions);
-  pool->breeder_window = (int)(params.breed_fitness * solutions);
-  pool->new_solutions = 
-    (solution_t *)malloc(sizeof(solution_t) * pool->new_count);
-  if ( ! pool->new_solutions ){
-    free(pool->solutions);
-    return DEVOL_ERR;
-  }
+  /* The whole population is one island unless asked otherwise. */
+  pool->islands = params.islands > 0 ? params.islands : 1;
+  pool->generation = 0;
 
   /* Now we must initialize the gene_pool controller. */
   pool->controller.tid = 0;
   pool->controller.start = 0;
   pool->controller.stop = pool->solution_count;
+  pool->controller.island_start = 0;
+  pool->controller.island_stop = pool->islands;
+  memset(&pool->controller.stats, 0, sizeof(struct devol_stats));
+  pool->controller.perf = NULL;
+  pool->controller.trace = NULL;
+  pool->controller.async = NULL;
+  pool->recorder = NULL;
+  pool->exporter = NULL;
+  pool->mp = NULL;
+  pool->pipeline = NULL;
+  if ( params.perf )
+    devol_perf_open(&pool->controller);
   pool->controller.pool = NULL; /* NULL thread pool. */
   pool->controller.gene_pool = pool;
-  pool->controller.rstate[0] = params.rstate[0];
-  pool->controller.rstate[1] = params.rstate[1];
-  pool->controller.rstate[2] = params.rstate[2];
-#ifdef __sun__
-  memset(&(pool->controller.rdata), 0, sizeof(pool->controller.rdata));
-#else
-  memset(&(pool->controller.rdata), 0, sizeof(struct drand48_data)); 
-#endif
+  devol_rng_init(&pool->controller.rng, params.rng_type, params.rstate, 0);
+
+  if ( _gene_pool_init_arenas(pool, &pool->controller, 1) ||
+       _gene_pool_init_batches(pool, &pool->controller, 1) ){
+    free(pool->solutions);
+    return DEVOL_ERR;
+  }
+
+  if ( _gene_pool_init_fitness(pool) ){
+    free(pool->solutions);
+    return DEVOL_ERR;
+  }
+
+  if ( params.trace && devol_trace_init(&pool->controller, params.trace) ){
+    free(pool->solutions);
+    return DEVOL_ERR;
+  }
 
   ftime(&tmp_time);
   t_start = (tmp_time.time * 1000) + tmp_time.millitm;
@@ -152,7 +231,23 @@ int  gene_pool_create_seq(struct gene_pool *pool, int solutions,
     pool->solutions[i].destroy = params.destroy;
     pool->solutions[i].cont = &pool->controller;
 
+    if ( pool->arenas ){
+      pool->solutions[i].private.ptr = devol_arena_alloc(&pool->arenas[0]);
+      if ( ! pool->solutions[i].private.ptr ){
+	if ( pool->controller.trace )
+	  _devol_trace(&pool->controller, DEVOL_EVENT_ALLOC_FAIL, i,
+		       devol_clock_ns(), 0);
+	return DEVOL_ERR;
+      }
+    }
+
+    if ( params.deterministic )
+      devol_rng_stream(&pool->controller.rng, params.rstate,
+		       0, i, DEVOL_STREAM_INIT);
+
     params.init(&(pool->solutions[i]));
+    pool->solutions[i].fitness_val = NAN;
+    pool->controller.stats.inits++;
 
   }
   INFO("Done\n");
@@ -167,20 +262,186 @@ int  gene_pool_create_seq(struct gene_pool *pool, int solutions,
 
 }
 
+/*
+ * Tear down a gene pool made by any of the gene_pool_create*() functions:
+ * stop recording and exporting, hand each solution to destroy() if there is
+ * one, stop whatever threads or processes the pool has and free everything
+ * the engine allocated. The pool can be created again afterwards.
+ */
+void gene_pool_destroy(struct gene_pool *pool){
+
+  int i, arenas = 0;
+  struct devol_controller *conts = pool->workers.controllers;
+
+  gene_pool_record_stop(pool);
+  gene_pool_export_stop(pool);
+
+  if ( pool->params.destroy ){
+    for ( i = 0; i < pool->solution_count; i++)
+      pool->params.destroy(&pool->solutions[i]);
+  }
+
+  /* Everything of a multi process pool's lives and dies with its mapping. */
+  if ( pool->flags == GPOOL_MP ){
+    gene_pool_destroy_mp(pool);
+    return;
+  }
+
+  /* The workers are parked between generations so their traces, arenas and
+   * fitness stats can go before they do. Breeders have arenas, evaluators
+   * don't. */
+  for ( i = 0; i < pool->workers.thread_count; i++)
+    devol_trace_destroy(&conts[i]);
+  devol_trace_destroy(&pool->controller);
+
+  if ( pool->flags == GPOOL_SEQ )
+    _gene_pool_free_batches(&pool->controller, 1);
+  else
+    _gene_pool_free_batches(conts, pool->workers.thread_count);
+
+  if ( pool->flags == GPOOL_SEQ )
+    arenas = 1;
+  else
+    while ( arenas < pool->workers.thread_count && conts[arenas].arena )
+      arenas++;
+  if ( pool->arenas ){
+    for ( i = 0; i < arenas; i++)
+      devol_arena_destroy(&pool->arenas[i]);
+    free(pool->arenas);
+    pool->arenas = NULL;
+  }
+
+  _gene_pool_free_fitness(pool);
+
+  if ( pool->flags == GPOOL_SMP ){
+    thread_pool_destroy(&pool->workers);
+  } else if ( pool->flags == GPOOL_PIPE ){
+    gene_pool_destroy_pipeline(pool);
+    free(conts);
+  }
+  memset(&pool->workers, 0, sizeof(struct thread_pool));
+
+  devol_perf_free(&pool->controller);
+  devol_async_destroy(&pool->controller);
+  free(pool->solutions);
+  pool->solutions = NULL;
+  pool->solution_count = 0;
+
+}
+
+/*
+ * Change the reproduction rate, breed fitness, gene dispersal factor and
+ * per island settings (island_params or island_spread) of a gene pool that
+ * is already running, without stopping its threads or starting over with a
+ * new population. Everything else in params is fixed once the gene pool is
+ * made and is ignored here. Passing island_params = NULL drops any list
+ * given before and puts every island back on the gene pool's own settings,
+ * spread by island_spread if that is set. Call it between generations, not
+ * while gene_pool_iterate() is running; a scheduler job's generation()
+ * callback is fine. Worker threads read these afresh every generation and
+ * worker processes are handed them when they are woken, so the next
+ * generation uses the new values.
+ */
+void gene_pool_set_params(struct gene_pool *pool, struct devol_params params){
+
+  pool->params.reproduction_rate = params.reproduction_rate;
+  pool->params.breed_fitness = params.breed_fitness;
+  pool->params.gene_dispersal_factor = params.gene_dispersal_factor;
+  pool->params.island_spread = params.island_spread;
+
+  /* A new list of island settings has to be for the islands the gene pool
+   * has; otherwise keep the one it was given before. */
+  if ( params.island_params && params.islands != pool->islands )
+    printf("# Warning: island_params needs islands = %d. Ignoring it.\n",
+	   pool->islands);
+  else
+    pool->params.island_params = params.island_params;
+
+  if ( pool->params.breed_fitness > .5 ){
+    printf("# Warning: breed fitness > .5. Setting to .5\n");
+    pool->params.breed_fitness = .5;
+  }
+
+  _gene_pool_set_islands(pool);
+
+}
+
 /*
  * Here is the sequential version of the evolutionary algorithm. The multi
  * threaded version is in devol_threads.c.
  *
  * Some assumptions this function makes. When created in sequential mode, a
- * gene_pool will have one controller and it will have the requried sequential
- * data precalculated (breeder_window, etc).
+ * gene_pool will have one controller and that controller owns every island.
  */
 int gene_pool_iterate_seq(struct gene_pool *pool){
 
   int i;
-  int s1_ind, s2_ind, die_ind;
-  double tmp;
-  solution_t *s1, *s2, *die;
+
+  for ( i = 0; i < pool->islands; i++)
+    _gene_pool_evolve_island_p(&pool->controller, i);
+
+  _gene_pool_merge_fitness(pool);
+
+  /* With only one island there is nowhere for solutions to travel to. */
+  if ( pool->islands > 1 )
+    gene_pool_disperse(pool);
+
+  pool->controller.stats.generations++;
+  pool->generation++;
+
+  if ( pool->recorder )
+    _gene_pool_record_generation(pool);
+  if ( pool->exporter )
+    _gene_pool_export_generation(pool);
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Find the block of the solution array that makes up an island. Islands are
+ * an even split of the population with any extras going to the last island;
+ * with one island per thread this is exactly how the thread pool has always
+ * split up the work.
+ */
+void _gene_pool_island_bounds(struct gene_pool *pool, int island,
+			      int *start, int *stop){
+
+  int block_size = pool->solution_count / pool->islands;
+
+  *start = island * block_size;
+  if ( island == pool->islands - 1 )
+    *stop = pool->solution_count;
+  else
+    *stop = *start + block_size;
+
+}
+
+/*
+ * Run one generation on one island. This is called by the worker threads for
+ * each of their islands and by the sequential algorithm for every island.
+ */
+void _gene_pool_evolve_island_p(struct devol_controller *controller,
+				int island){
+
+  int start, stop;
+  int new_count, breeder_window;
+  double rr, bf;
+  uint64_t t;
+  struct gene_pool *pool = controller->gene_pool;
+
+  t = devol_phase_begin(controller);
+  _gene_pool_island_bounds(pool, island, &start, &stop);
+
+  /* Take in any migrants sent to this island last generation. */
+  if ( pool->migrants && pool->migrate_pull ){
+    _gene_pool_migrate_pull_p(controller, island, start, stop);
+    t = devol_phase_end(controller, DEVOL_PHASE_DISPERSE, t);
+  }
+
+  _gene_pool_island_rates(pool, island, &rr, &bf);
+  new_count = (int)(rr * (stop - start));
+  breeder_window = (int)(bf * (stop - start));
 
   /*
    * Here is where we start doing the work. The algorithm is as follows:
@@ -191,48 +452,172 @@ int gene_pool_iterate_seq(struct gene_pool *pool){
    *  3) Create new solutions by breeding good solutions randomly.
    *  4) Replace the worst solutions with the newly created solutions.
    */
-  _gene_pool_calculate_fitnesses_p(pool, 0, pool->solution_count);
+  _gene_pool_evaluate_p(controller, start, stop);
+  t = devol_phase_end(controller, DEVOL_PHASE_FITNESS, t);
 
-  /* Sort the solutions. */
-  qsort(pool->solutions, pool->solution_count, 
+  /*
+   * This could potentially give rise to superlinear speedups. This is because
+   * sort algorithms scale super-linearly with problem size. I.e the run time
+   * for qsort is O(N * log(N)). Thus as N gets larger, the sequential program
+   * starts to hurt more than k subsections of an N sized problem.
+   */
+  qsort(&(pool->solutions[start]), stop - start,
 	sizeof(solution_t), _compare_solutions);
+  t = devol_phase_end(controller, DEVOL_PHASE_SORT, t);
+
+  /* Breed new solutions into the worst spots of the island. It takes two to
+   * breed. With asynchronous evaluation each child is submitted as it is
+   * bred. */
+  if ( breeder_window > 1 && pool->params.submit )
+    _gene_pool_breed_async_p(controller, start, stop, new_count,
+			     breeder_window);
+  else if ( breeder_window > 1 )
+    _gene_pool_breed_p(controller, start, stop, new_count, breeder_window);
+  t = devol_phase_end(controller, DEVOL_PHASE_BREED, t);
+
+  /* Compute the fitnesses of new solutions. Only the children need it. Then
+   * while the island is still warm in the cache, its share of the stats. */
+  if ( pool->params.submit )
+    _gene_pool_async_wait_p(controller);
+  else
+    _gene_pool_evaluate_p(controller, start, stop);
+  _gene_pool_island_fitness_p(controller, island, start, stop);
+  devol_phase_end(controller, DEVOL_PHASE_REPLACE, t);
 
-  /* Make some new solutions. */
-  INFO("%d new solutions...\n", pool->new_count);
-  for ( i = 0; i < pool->new_count; i++){
+}
 
-    /* Generate the two parent solution indexes. */
-    devol_rand48(pool->controller.rstate, &(pool->controller.rdata), &tmp);
-    s1_ind = (int)(tmp * pool->breeder_window);
-    do {
-      devol_rand48(pool->controller.rstate, &(pool->controller.rdata), &tmp);
-      s2_ind = (int)(tmp * pool->breeder_window);
-    } while (s1_ind == s2_ind);
-
-    /* Get the parent solution addresses. */
-    s1 = (solution_t *)&(pool->solutions[s1_ind]);
-    s2 = (solution_t *)&(pool->solutions[s2_ind]);
-
-    /* And make a new solution. */
-    pool->new_solutions[i].mutate = s1->mutate;
-    pool->new_solutions[i].fitness = s1->fitness;
-    pool->new_solutions[i].init = s1->init;
-    pool->new_solutions[i].destroy = s1->destroy;
-    pool->new_solutions[i].cont = &pool->controller;
-    s1->mutate(s1, s2, &(pool->new_solutions[i]));
-
-    /* Now that we have a solution, find another solution to kill and 
-     * replace. */
-    die_ind = pool->solution_count - (i % pool->breeder_window) - 1;
-    die = (solution_t *)&(pool->solutions[die_ind]);
-    die->destroy(die);
-
-    *die = pool->new_solutions[i];
+/*
+ * Breed new_count new solutions out of the best breeder_window solutions in
+ * the block start to stop and use them to replace the worst solutions in the
+ * block. The block must already be sorted. This is the heart of both the
+ * sequential and the SMP algorithms.
+ *
+ * Each child is built directly on top of the solution it replaces: mutate()
+ * gets the dying solution as its destination and reuses its genome. Since
+ * breed_fitness is at most .5 the breeders and the dying never overlap. No
+ * allocation, initialization or copying happens per child.
+ */
+void _gene_pool_breed_p(struct devol_controller *controller,
+			int start, int stop,
+			int new_count, int breeder_window){
 
-  }
+  int i;
+
+  /* This is kinda complex... basically we have to randomly choose some of the
+   * the better solutions to breed. This is affected by the param 
+   * reproduction_rate. The higher the reproduction rate, the more solutions
+   * we make per generation. 
+   */
+  for ( i = 0; i < new_count; i++)
+    _gene_pool_breed_one_p(controller, start, stop, i, breeder_window);
+
+}
 
-  /* Compute the fitnesses of new solutions. */
-  _gene_pool_calculate_fitnesses_p(pool, 0, pool->solution_count);
+/*
+ * Breed the i'th child of a breeding round; see _gene_pool_breed_p(). Returns
+ * the index of the slot the child was bred into.
+ */
+int _gene_pool_breed_one_p(struct devol_controller *controller,
+			   int start, int stop, int i, int breeder_window){
+
+  int s1_ind, s2_ind;
+  int die_index;
+  solution_t *s1, *s2, *die;
+  struct gene_pool *pool = controller->gene_pool;
+
+  controller->stats.mutates++;
+
+  /* Now choose a solution to die and be replaced. We will start killing
+   * solutions starting with the bad. We will wrap around if necessary; i.e:
+   * more solutions are bred than we have room for. */
+  die_index = stop - (i % breeder_window) - 1;
+
+  /* In deterministic mode everything this child draws, its parents
+   * included, comes from the stream belonging to its slot. Wrapping around
+   * replaces a slot twice, so the breeding round is part of the id. */
+  if ( pool->params.deterministic )
+    devol_rng_stream(&controller->rng, pool->params.rstate,
+		     pool->generation, die_index,
+		     DEVOL_STREAM_BREED + ((i / breeder_window) << 2));
+
+  /* Generate a new solution from the two randomly selected in the
+   * breeder_window. */
+  s1_ind = (int)(devol_rng_uniform(&controller->rng) * breeder_window);
+  do {
+    s2_ind = (int)(devol_rng_uniform(&controller->rng) * breeder_window);
+  } while (s1_ind == s2_ind);
+
+  /* Get the addresses of the solution data in the solution pool of the
+   * gene pool. The sort will put the better solutions in the lower indexes
+   * of our block, thus we need only use the start of our block and add the
+   * random component of our index in order to get the random solution in the
+   * breeder window. */
+  s1 = (solution_t *)&(pool->solutions[start + s1_ind]);
+  s2 = (solution_t *)&(pool->solutions[start + s2_ind]);
+  DEBUG("Mutating solutions: %d(%lf) and %d(%lf).\n", 
+	s1_ind, s1->fitness_val, 
+	s2_ind, s2->fitness_val);
+
+  DEBUG("  Killing %d\n", die_index);
+  die = (solution_t *)&(pool->solutions[die_index]);
+
+  /* And make the new solution in its place. */
+  s1->mutate(s1, s2, die);
+  die->fitness_val = NAN;
+
+  return die_index;
+
+}
+
+/*
+ * Give each of the passed controllers a genome arena if the problem has asked
+ * the engine to manage its genomes. Each arena has a slot for each solution
+ * in the controller's block; children reuse the slots of the dead.
+ */
+int _gene_pool_init_arenas(struct gene_pool *pool,
+			   struct devol_controller *controllers, int count){
+
+  int i, slots;
+  void *mem;
+
+  pool->arenas = NULL;
+  for ( i = 0; i < count; i++)
+    controllers[i].arena = NULL;
+
+  if ( ! pool->params.genome_size )
+    return DEVOL_OK;
+
+  pool->arenas = (struct devol_arena *)
+    malloc(sizeof(struct devol_arena) * count);
+  if ( ! pool->arenas )
+    return DEVOL_ERR;
+
+  for ( i = 0; i < count; i++){
+    /* A multi process pool's genomes have to be in its shared memory. */
+    if ( pool->mp ){
+      slots = controllers[i].stop - controllers[i].start;
+      mem = _gene_pool_alloc(pool, devol_arena_size(pool->params.genome_size,
+						      slots));
+      if ( slots && ! mem ){
+	free(pool->arenas);
+	pool->arenas = NULL;
+	return DEVOL_ERR;
+      }
+      devol_arena_init_at(&pool->arenas[i], pool->params.genome_size, slots,
+			  mem);
+      controllers[i].arena = &pool->arenas[i];
+      continue;
+    }
+    if ( devol_arena_init(&pool->arenas[i], pool->params.genome_size,
+			  controllers[i].stop - controllers[i].start) ){
+      while ( i-- > 0 )
+	devol_arena_destroy(&pool->arenas[i]);
+      free(pool->arenas);
+      pool->arenas = NULL;
+      return DEVOL_ERR;
+    }
+    controllers[i].arena = &pool->arenas[i];
+  }
 
   return DEVOL_OK;
 
@@ -246,23 +631,44 @@ int gene_pool_iterate_seq(struct gene_pool *pool){
  */
 void gene_pool_disperse(struct gene_pool *pool){
 
-  int disperse;
+  int disperse, swaps;
   int s1, s2;
+  uint64_t t;
+
+  /* Migration along a topology is done by the islands themselves; all that
+   * is left here is deciding when. */
+  if ( pool->migrants ){
+    t = devol_phase_begin(&pool->controller);
+    _gene_pool_migrate_plan(pool);
+    devol_phase_end(&pool->controller, DEVOL_PHASE_DISPERSE, t);
+    if ( pool->controller.trace && pool->migrate_send )
+      _devol_trace(&pool->controller, DEVOL_EVENT_MIGRATION,
+		   pool->migrants * pool->islands, t, 0);
+    return;
+  }
 
-  /* Don't do dispersal if no swap() function is defined. */
-  if ( pool->params.swap == NULL)
+  /* Don't do dispersal if no swap() function is defined and we can't swap
+   * the genomes ourselves. */
+  if ( pool->params.swap == NULL && ! pool->arenas )
     return;
 
+  t = devol_phase_begin(&pool->controller);
+
   disperse = (int)(pool->params.gene_dispersal_factor * pool->solution_count);
+  swaps = disperse > 0 ? disperse : 0;
+
+  if ( pool->params.deterministic )
+    devol_rng_stream(&pool->controller.rng, pool->params.rstate,
+		     pool->generation, 0, DEVOL_STREAM_DISPERSE);
 
   //printf("# Doing gene dispersal: %d swaps\n", disperse);
 
   while ( disperse-- > 0 ){
 
     /* Pick two solutions and swap them. */
-    s1 = nrand48(pool->controller.rstate) % pool->solution_count;
+    s1 = devol_rng_u32(&pool->controller.rng) % pool->solution_count;
     do {
-      s2 = nrand48(pool->controller.rstate) % pool->solution_count;
+      s2 = devol_rng_u32(&pool->controller.rng) % pool->solution_count;
     } while (s1 == s2);
     //printf("#> s1=%d s2=%d\n", s1, s2);
 
@@ -271,8 +677,42 @@ void gene_pool_disperse(struct gene_pool *pool){
      * Unfortunately this is slower (by a lot potentially) than a shallow
      * copy. But if a shallow copy is all thats needed, the implementing
      * function can do that so w/e. */
-    pool->params.swap(&pool->solutions[s1], &pool->solutions[s2]);
+    _gene_pool_swap(pool, &pool->solutions[s1], &pool->solutions[s2]);
 
   }
 
+  devol_phase_end(&pool->controller, DEVOL_PHASE_DISPERSE, t);
+  if ( pool->controller.trace )
+    _devol_trace(&pool->controller, DEVOL_EVENT_MIGRATION, swaps, t, 0);
+
+}
+
+/*
+ * Swap the genomes of two solutions. Each solution stays where it is (and so
+ * keeps its controller); only what it holds moves. If the engine owns the
+ * genomes this is just a pointer swap, otherwise the problem's swap() has to
+ * do it.
+ */
+void _gene_pool_swap(struct gene_pool *pool, solution_t *a, solution_t *b){
+
+  double t_fitness;
+  void *t_genome;
+
+  /* We cannot know what the problem's swap() does with the fitnesses so
+   * have both solutions evaluated again. */
+  if ( pool->params.swap ){
+    pool->params.swap(a, b);
+    a->fitness_val = NAN;
+    b->fitness_val = NAN;
+    return;
+  }
+
+  t_genome = a->private.ptr;
+  a->private.ptr = b->private.ptr;
+  b->private.ptr = t_genome;
+
+  t_fitness = a->fitness_val;
+  a->fitness_val = b->fitness_val;
+  b->fitness_val = t_fitness;
+
 }
@@ -0,0 +1,108 @@
+/*
+ * Turn a record file written by gene_pool_record() into the text .evol
+ * format: one line per generation with the generation number and the average
+ * fitness, separated by a tab.
+ *
+ * Usage:
+ *
+ *   ./devol2evol [-f mean|min|max] [-a] <records> [output]
+ *
+ *   -f   Which fitness to write (default mean, which is what the .evol files
+ *        in data/ hold).
+ *   -a   Write every field of each record instead: generation, count, min,
+ *        mean, max, evaluations and each phase time in ms.
+ *
+ * output defaults to stdout.
+ */
+
+#include <devol.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+void die(char *msg){
+
+  fprintf(stderr, "%s", msg);
+  exit(1);
+
+}
+
+int main(int argc, char **argv){
+
+  int p, opt;
+  int all = 0;
+  char *field = "mean";
+  double f;
+  FILE *in, *out = stdout;
+  struct devol_record r;
+  struct devol_record_header hdr;
+
+  while ( (opt = getopt(argc, argv, "f:a")) != -1 ){
+    switch ( opt ){
+    case 'f':
+      field = optarg;
+      break;
+    case 'a':
+      all = 1;
+      break;
+    default:
+      die("Usage: devol2evol [-f mean|min|max] [-a] <records> [output]\n");
+    }
+  }
+
+  if ( optind >= argc )
+    die("Usage: devol2evol [-f mean|min|max] [-a] <records> [output]\n");
+  if ( strcmp(field, "mean") && strcmp(field, "min") && strcmp(field, "max") )
+    die("The field must be one of mean, min or max.\n");
+
+  in = fopen(argv[optind], "rb");
+  if ( ! in )
+    die("Unable to open the record file.\n");
+  if ( optind + 1 < argc ){
+    out = fopen(argv[optind + 1], "w");
+    if ( ! out )
+      die("Unable to open the output file.\n");
+  }
+
+  if ( fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+       memcmp(hdr.magic, DEVOL_RECORD_MAGIC, sizeof(hdr.magic)) )
+    die("Not a record file.\n");
+  if ( hdr.version != DEVOL_RECORD_VERSION ||
+       hdr.record_size != sizeof(struct devol_record) ||
+       hdr.phases != DEVOL_PHASES )
+    die("Record file from a different version of the library.\n");
+
+  if ( all )
+    fprintf(out, "# generation\tcount\tmin\tmean\tmax\tevaluations\t"
+	    "fitness\tsort\tbreed\treplace\twait\tdisperse\n");
+
+  while ( fread(&r, sizeof(r), 1, in) == 1 ){
+
+    if ( all ){
+      fprintf(out, "%u\t%u\t%lf\t%lf\t%lf\t%llu", r.generation, r.count,
+	      r.min, r.mean, r.max, (unsigned long long)r.evaluations);
+      for ( p = 0; p < DEVOL_PHASES; p++)
+	fprintf(out, "\t%.3lf", r.ns[p] / 1.0e6);
+      fprintf(out, "\n");
+      continue;
+    }
+
+    if ( strcmp(field, "min") == 0 )
+      f = r.min;
+    else if ( strcmp(field, "max") == 0 )
+      f = r.max;
+    else
+      f = r.mean;
+    fprintf(out, "%u\t%lf\n", r.generation, f);
+
+  }
+
+  fclose(in);
+  if ( out != stdout )
+    fclose(out);
+
+  return 0;
+
+}
@@ -0,0 +1,103 @@
+/*
+ * Genome arenas. When a problem tells the engine how big its genome is
+ * (devol_params.genome_size) the engine hands out the genome memory itself:
+ * each controller gets an arena of fixed size slots, one per solution in its
+ * block, handed out once when the gene pool is made. Children are bred right
+ * into the slot of the solution they replace, so after that the problem
+ * never has to allocate or free anything and the arena never changes.
+ *
+ * Slots are all the same size, so a genome can sit in any arena in the gene
+ * pool. That lets dispersal move genomes between controllers by simply
+ * swapping pointers.
+ */
+
+#include <devol.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* Slots are rounded up so that each one is aligned well enough for any
+ * genome. */
+static size_t _arena_slot_size(size_t slot_size){
+
+  if ( slot_size < sizeof(void *) )
+    slot_size = sizeof(void *);
+  return (slot_size + 15) & ~((size_t)15);
+
+}
+
+/*
+ * How much memory an arena of slots slots needs.
+ */
+size_t devol_arena_size(size_t slot_size, int slots){
+
+  return slots > 0 ? _arena_slot_size(slot_size) * slots : 0;
+
+}
+
+/*
+ * Set up an arena in memory the caller provides, devol_arena_size() bytes of
+ * it aligned to 16 bytes. The memory stays the caller's.
+ */
+void devol_arena_init_at(struct devol_arena *arena, size_t slot_size,
+			 int slots, void *mem){
+
+  slot_size = _arena_slot_size(slot_size);
+
+  arena->base = slots > 0 ? mem : NULL;
+  arena->slot_size = slot_size;
+  arena->slots = slots;
+  arena->cursor = (char *)arena->base;
+  arena->limit = (char *)arena->base + (slot_size * slots);
+  arena->owned = 0;
+
+}
+
+/*
+ * Set up an arena with the given number of slots.
+ */
+int devol_arena_init(struct devol_arena *arena, size_t slot_size, int slots){
+
+  void *mem = NULL;
+
+  /* A controller with no islands gets an empty arena. */
+  if ( slots > 0 ){
+    mem = malloc(devol_arena_size(slot_size, slots));
+    if ( ! mem )
+      return DEVOL_ERR;
+  }
+
+  devol_arena_init_at(arena, slot_size, slots, mem);
+  arena->owned = 1;
+
+  return DEVOL_OK;
+
+}
+
+void devol_arena_destroy(struct devol_arena *arena){
+
+  if ( arena->owned )
+    free(arena->base);
+  arena->base = NULL;
+  arena->cursor = NULL;
+  arena->limit = NULL;
+
+}
+
+/*
+ * Get the next slot. Returns NULL once every slot has been handed out.
+ */
+void *devol_arena_alloc(struct devol_arena *arena){
+
+  void *slot;
+
+  if ( arena->cursor >= arena->limit )
+    return NULL;
+
+  slot = arena->cursor;
+  arena->cursor += arena->slot_size;
+
+  return slot;
+
+}
@@ -0,0 +1,189 @@
+/*
+ * Asynchronous fitness evaluation. Each controller gets a struct devol_async
+ * the first time it submits something: an eventfd that devol_complete()
+ * adds one to per finished evaluation, and a count of how many it has out.
+ * The controller's thread only blocks when it has params.in_flight out or has
+ * nothing left to do but wait, and then one read() collects every completion
+ * that came in since the last one.
+ *
+ * devol_complete() writes the fitness into the solution before it signals,
+ * so the engine only has to count completions, not match them up.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#define DEVOL_ASYNC_IN_FLIGHT  64
+
+static struct devol_async *_async_get(struct devol_controller *controller){
+
+  int fds[2];
+  struct devol_async *async;
+
+  if ( controller->async )
+    return controller->async;
+
+  async = (struct devol_async *)malloc(sizeof(struct devol_async));
+  if ( ! async )
+    return NULL;
+
+#ifdef __linux__
+  fds[0] = fds[1] = eventfd(0, EFD_CLOEXEC);
+  if ( fds[0] < 0 ){
+    free(async);
+    return NULL;
+  }
+#else
+  if ( pipe(fds) ){
+    free(async);
+    return NULL;
+  }
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+  async->rfd = fds[0];
+  async->wfd = fds[1];
+  async->in_flight = 0;
+  async->max = controller->gene_pool->params.in_flight > 0 ?
+    controller->gene_pool->params.in_flight : DEVOL_ASYNC_IN_FLIGHT;
+  controller->async = async;
+
+  return async;
+
+}
+
+/*
+ * Block until at least one evaluation completes and take every completion
+ * there is.
+ */
+static void _async_collect(struct devol_async *async){
+
+  ssize_t n;
+#ifdef __linux__
+  uint64_t count;
+
+  do {
+    n = read(async->rfd, &count, sizeof(count));
+  } while ( n < 0 && errno == EINTR );
+  if ( n == sizeof(count) )
+    async->in_flight -= (int)count;
+#else
+  char buf[DEVOL_ASYNC_IN_FLIGHT];
+
+  do {
+    n = read(async->rfd, buf, sizeof(buf));
+  } while ( n < 0 && errno == EINTR );
+  if ( n > 0 )
+    async->in_flight -= (int)n;
+#endif
+
+}
+
+/*
+ * Called by whoever evaluated solution, from any thread, to hand the fitness
+ * back to the engine.
+ */
+void devol_complete(struct devol_async *handle, solution_t *solution,
+		    double fitness){
+
+  ssize_t n;
+#ifdef __linux__
+  uint64_t one = 1;
+#else
+  char one = 1;
+#endif
+
+  solution->fitness_val = fitness;
+  __sync_synchronize();
+
+  do {
+    n = write(handle->wfd, &one, sizeof(one));
+  } while ( n < 0 && errno == EINTR );
+
+}
+
+/*
+ * Start evaluating solution, first waiting for room if the controller has as
+ * many evaluations out as it is allowed.
+ */
+void _gene_pool_submit_p(struct devol_controller *controller,
+			 solution_t *solution){
+
+  struct gene_pool *pool = controller->gene_pool;
+  struct devol_async *async = _async_get(controller);
+
+  controller->stats.evaluations++;
+
+  if ( async ){
+    while ( async->in_flight >= async->max )
+      _async_collect(async);
+    async->in_flight++;
+    if ( pool->params.submit(solution, async, pool->params.submit_arg) == 0 )
+      return;
+    async->in_flight--;
+  }
+
+  solution->fitness_val = solution->fitness(solution);
+
+}
+
+/*
+ * Wait for all of the controller's evaluations to come back.
+ */
+void _gene_pool_async_wait_p(struct devol_controller *controller){
+
+  struct devol_async *async = controller->async;
+
+  if ( ! async )
+    return;
+
+  while ( async->in_flight > 0 )
+    _async_collect(async);
+  __sync_synchronize();
+
+}
+
+/*
+ * _gene_pool_breed_p() for asynchronous evaluation: each child is submitted
+ * as soon as it is bred, unless a later one of the round is going to replace
+ * it anyway. The caller waits for them.
+ */
+void _gene_pool_breed_async_p(struct devol_controller *controller,
+			      int start, int stop,
+			      int new_count, int breeder_window){
+
+  int i, slot;
+  struct gene_pool *pool = controller->gene_pool;
+
+  for ( i = 0; i < new_count; i++){
+    slot = _gene_pool_breed_one_p(controller, start, stop, i, breeder_window);
+    if ( i >= new_count - breeder_window )
+      _gene_pool_submit_p(controller, &pool->solutions[slot]);
+  }
+
+}
+
+void devol_async_destroy(struct devol_controller *controller){
+
+  struct devol_async *async = controller->async;
+
+  if ( ! async )
+    return;
+
+  _gene_pool_async_wait_p(controller);
+  close(async->rfd);
+  if ( async->wfd != async->rfd )
+    close(async->wfd);
+  free(async);
+  controller->async = NULL;
+
+}
@@ -0,0 +1,113 @@
+/*
+ * Convergence detection. A program fills in a struct devol_converge with the
+ * criteria it cares about and calls gene_pool_converged() after each
+ * generation; as soon as one of the criteria is met it returns which one.
+ *
+ * Everything is worked out from the fitness statistics the engine keeps as it
+ * runs each generation (see devol_fitness.c), so checking costs nothing.
+ *
+ * The criteria:
+ *
+ *   DEVOL_CONVERGE_DERIVATIVE   The average fitness has stopped improving: a
+ *                               running average of its improvement per
+ *                               generation, taken over about window
+ *                               generations, is within epsilon of 0.
+ *   DEVOL_CONVERGE_STAGNATION   The best fitness has not improved by more than
+ *                               epsilon in window generations.
+ *   DEVOL_CONVERGE_TARGET       The average fitness is down to target.
+ *
+ * epsilon is in the problem's own fitness units. It is not relative since
+ * fitnesses are often offset (the mixture problem's are 1e12 minus the log
+ * likelihood) which would make any relative change look tiny.
+ *
+ * A program can also plug in its own check() which sees the same numbers.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/*
+ * Check for convergence after a generation. Returns the DEVOL_CONVERGE_*
+ * criterion that was met or 0 if the pool should keep going.
+ */
+int gene_pool_converged(struct gene_pool *pool, struct devol_converge *conv){
+
+  double avg, best, alpha;
+  int window = conv->window > 0 ? conv->window : 1;
+
+  avg = pool->fitness.mean;
+  best = pool->fitness.min;
+
+  if ( conv->generations == 0 ){
+    conv->slope = HUGE_VAL;
+    conv->best_seen = best;
+    conv->best_generation = 0;
+  } else {
+    /* An exponential moving average with the same center of mass as a plain
+     * average over window generations; no history to keep. */
+    alpha = 2.0 / (window + 1);
+    if ( conv->generations == 1 )
+      conv->slope = conv->avg - avg;
+    else
+      conv->slope += alpha * (conv->avg - avg - conv->slope);
+    if ( conv->best_seen - best > conv->epsilon ){
+      conv->best_seen = best;
+      conv->best_generation = conv->generations;
+    }
+  }
+
+  conv->avg = avg;
+  conv->best = best;
+  conv->generations++;
+
+  conv->fired = 0;
+  if ( (conv->criteria & DEVOL_CONVERGE_TARGET) && avg <= conv->target )
+    conv->fired = DEVOL_CONVERGE_TARGET;
+  else if ( (conv->criteria & DEVOL_CONVERGE_DERIVATIVE) &&
+	    conv->generations > window && fabs(conv->slope) <= conv->epsilon )
+    conv->fired = DEVOL_CONVERGE_DERIVATIVE;
+  else if ( (conv->criteria & DEVOL_CONVERGE_STAGNATION) &&
+	    conv->generations - conv->best_generation > window )
+    conv->fired = DEVOL_CONVERGE_STAGNATION;
+  else if ( conv->check && conv->check(conv) )
+    conv->fired = DEVOL_CONVERGE_CUSTOM;
+
+  return conv->fired;
+
+}
+
+/*
+ * Forget everything seen so far, e.g. to reuse conv for another run.
+ */
+void devol_converge_reset(struct devol_converge *conv){
+
+  conv->generations = 0;
+  conv->fired = 0;
+
+}
+
+/*
+ * A name for a criterion, for printing.
+ */
+char *devol_converge_name(int criterion){
+
+  switch ( criterion ){
+
+  case DEVOL_CONVERGE_DERIVATIVE:
+    return "derivative";
+  case DEVOL_CONVERGE_STAGNATION:
+    return "stagnation";
+  case DEVOL_CONVERGE_TARGET:
+    return "target";
+  case DEVOL_CONVERGE_CUSTOM:
+    return "custom";
+  default:
+    return "none";
+
+  }
+
+}
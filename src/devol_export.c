@@ -0,0 +1,245 @@
+/*
+ * Live stats. gene_pool_export() publishes a page of the gene pool's current
+ * state (struct devol_export: the generation, the fitness statistics, the
+ * evaluation rate and each thread's phase times) in a POSIX shared memory
+ * object so that another process, such as devol-top, can watch a long run.
+ *
+ * The page is updated by the calling thread at the end of each generation,
+ * when the workers are parked, so the workers never see any of this. The
+ * page is guarded by a seqlock: the writer never waits on a reader, a reader
+ * just copies the page again if it changed while it was copying.
+ */
+
+#include <devol.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct devol_exporter {
+
+  struct devol_export *page;
+  char                *name;
+
+  /* Evaluations and time at the last update, for the rate. */
+  uint64_t             evaluations;
+  uint64_t             when;
+
+};
+
+/*
+ * Start publishing the gene pool's stats under name, which should look like
+ * "/something" (see shm_open(3)). Anything already there is replaced. If name
+ * is NULL the page is called DEVOL_EXPORT_NAME with our pid filled in, which
+ * is what devol-top looks for when given a pid.
+ */
+int gene_pool_export(struct gene_pool *pool, const char *name){
+
+  int fd;
+  char def[32];
+  struct devol_export *page;
+  struct devol_exporter *exp;
+
+  if ( pool->exporter )
+    return DEVOL_ERR;
+
+  if ( ! name ){
+    snprintf(def, sizeof(def), DEVOL_EXPORT_NAME, (int)getpid());
+    name = def;
+  }
+
+  exp = (struct devol_exporter *)malloc(sizeof(struct devol_exporter));
+  if ( ! exp )
+    return DEVOL_ERR;
+  exp->name = strdup(name);
+  if ( ! exp->name ){
+    free(exp);
+    return DEVOL_ERR;
+  }
+
+  fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if ( fd < 0 || ftruncate(fd, sizeof(struct devol_export)) ){
+    if ( fd >= 0 ){
+      close(fd);
+      shm_unlink(name);
+    }
+    free(exp->name);
+    free(exp);
+    return DEVOL_ERR;
+  }
+
+  page = (struct devol_export *)mmap(NULL, sizeof(struct devol_export),
+				     PROT_READ | PROT_WRITE, MAP_SHARED,
+				     fd, 0);
+  close(fd);
+  if ( page == MAP_FAILED ){
+    shm_unlink(name);
+    free(exp->name);
+    free(exp);
+    return DEVOL_ERR;
+  }
+
+  /* ftruncate() left the page zeroed, so seq is already 0. The magic goes in
+   * last so a reader never takes a half made page for a real one. */
+  page->version = DEVOL_EXPORT_VERSION;
+  page->pid = getpid();
+  page->population = pool->solution_count;
+  page->islands = pool->islands;
+  page->thread_count = pool->workers.thread_count < DEVOL_EXPORT_THREADS ?
+    pool->workers.thread_count : DEVOL_EXPORT_THREADS;
+  page->started = devol_clock_ns();
+  page->updated = page->started;
+  page->best = gene_pool_best_fitness(pool);
+  __sync_synchronize();
+  memcpy(page->magic, DEVOL_EXPORT_MAGIC, sizeof(page->magic));
+
+  exp->page = page;
+  exp->evaluations = 0;
+  exp->when = page->started;
+  pool->exporter = exp;
+
+  _gene_pool_export_generation(pool);
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Bring the page up to date. Called by the iterate functions once the
+ * generation is completely done.
+ */
+void _gene_pool_export_generation(struct gene_pool *pool){
+
+  int i, p;
+  uint64_t now, evaluations = 0;
+  struct devol_controller *c;
+  struct devol_exporter *exp = pool->exporter;
+  struct devol_export *page = exp->page;
+
+  page->seq++;
+  __sync_synchronize();
+
+  for ( i = 0; i <= (int)page->thread_count; i++){
+    c = i < (int)page->thread_count ? &pool->workers.controllers[i] :
+      &pool->controller;
+    for ( p = 0; p < DEVOL_PHASES; p++)
+      page->threads[i][p] = c->stats.ns[p];
+    evaluations += c->stats.evaluations;
+  }
+  /* Threads past DEVOL_EXPORT_THREADS still count towards the rate. */
+  for ( ; i <= pool->workers.thread_count; i++)
+    evaluations += pool->workers.controllers[i - 1].stats.evaluations;
+
+  now = devol_clock_ns();
+  page->generation = pool->generation;
+  page->fitness = pool->fitness;
+  page->best = gene_pool_best_fitness(pool);
+  page->evaluations = evaluations;
+  if ( now > exp->when )
+    page->rate = (evaluations - exp->evaluations) * 1.0e9 / (now - exp->when);
+  page->updated = now;
+
+  __sync_synchronize();
+  page->seq++;
+
+  exp->evaluations = evaluations;
+  exp->when = now;
+
+}
+
+/*
+ * Stop publishing. The page is marked done for anyone still watching and the
+ * name is removed.
+ */
+void gene_pool_export_stop(struct gene_pool *pool){
+
+  struct devol_exporter *exp = pool->exporter;
+
+  if ( ! exp )
+    return;
+
+  exp->page->seq++;
+  __sync_synchronize();
+  exp->page->done = 1;
+  __sync_synchronize();
+  exp->page->seq++;
+
+  munmap(exp->page, sizeof(struct devol_export));
+  shm_unlink(exp->name);
+  free(exp->name);
+  free(exp);
+  pool->exporter = NULL;
+
+}
+
+/*
+ * Map somebody else's page, read only. Returns NULL if there is no such page
+ * or it was published by a different version of the library.
+ */
+struct devol_export *devol_export_open(const char *name){
+
+  int fd;
+  struct stat st;
+  struct devol_export *page;
+
+  fd = shm_open(name, O_RDONLY, 0);
+  if ( fd < 0 )
+    return NULL;
+  if ( fstat(fd, &st) || st.st_size < (off_t)sizeof(struct devol_export) ){
+    close(fd);
+    return NULL;
+  }
+
+  page = (struct devol_export *)mmap(NULL, sizeof(struct devol_export),
+				     PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if ( page == MAP_FAILED )
+    return NULL;
+
+  if ( memcmp(page->magic, DEVOL_EXPORT_MAGIC, sizeof(page->magic)) ||
+       page->version != DEVOL_EXPORT_VERSION ){
+    munmap(page, sizeof(struct devol_export));
+    return NULL;
+  }
+
+  return page;
+
+}
+
+/*
+ * Take a consistent copy of a page. Gives up and returns DEVOL_ERR if the
+ * writer keeps getting in the way, which would take a very fast generation.
+ */
+int devol_export_read(struct devol_export *page, struct devol_export *copy){
+
+  int tries;
+  uint32_t seq;
+
+  for ( tries = 0; tries < 1000; tries++){
+
+    seq = page->seq;
+    if ( seq & 1 )
+      continue;
+    __sync_synchronize();
+
+    memcpy(copy, page, sizeof(struct devol_export));
+
+    __sync_synchronize();
+    if ( page->seq == seq )
+      return DEVOL_OK;
+
+  }
+
+  return DEVOL_ERR;
+
+}
+
+void devol_export_close(struct devol_export *page){
+
+  munmap(page, sizeof(struct devol_export));
+
+}
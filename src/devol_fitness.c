@@ -0,0 +1,322 @@
+/*
+ * Population fitness statistics and the hall of fame. These are kept up as a
+ * by product of each generation so that monitoring a gene pool costs nothing:
+ *
+ *   1) As each island finishes a generation its controller makes one pass
+ *      over the island's (just computed) fitnesses, keeping a running mean
+ *      and sum of squares (Welford), the min and max, and the indexes of the
+ *      island's best few solutions. It also folds its best fitness into the
+ *      pool's best with a compare and swap, so the best fitness seen so far
+ *      can be read at any time without a lock.
+ *   2) Once every island is done, before dispersal moves anything, the gene
+ *      pool combines the islands' partial sums (in island order, so the
+ *      numbers do not depend on the thread count) and merges their best
+ *      solutions into the hall of fame, which keeps copies of the best
+ *      solutions ever seen.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/*
+ * Allocate the per island stats and the hall of fame. Called when the gene
+ * pool is created, once the number of islands is known.
+ */
+int _gene_pool_init_fitness(struct gene_pool *pool){
+
+  int i, len, top_len;
+  int *top;
+  char *genomes = NULL;
+
+  len = pool->params.hall_of_fame > 0 ? pool->params.hall_of_fame : 1;
+
+  /* Each island's top list has to cover its migrants too. */
+  top_len = _gene_pool_migrants(pool);
+  if ( top_len < len )
+    top_len = len;
+
+  /* The islands' parts are written by whoever evolves them, which for a
+   * multi process gene pool means they have to be in shared memory. */
+  pool->island_stats = (struct devol_island *)
+    _gene_pool_alloc(pool, sizeof(struct devol_island) * pool->islands);
+  top = (int *)_gene_pool_alloc(pool, sizeof(int) * top_len * pool->islands);
+  pool->hall_of_fame = (solution_t *)malloc(sizeof(solution_t) * len);
+  if ( pool->params.genome_size )
+    genomes = (char *)malloc(pool->params.genome_size * len);
+
+  if ( ! pool->island_stats || ! top || ! pool->hall_of_fame ||
+       (pool->params.genome_size && ! genomes) ){
+    _gene_pool_free(pool, pool->island_stats);
+    _gene_pool_free(pool, top);
+    free(pool->hall_of_fame);
+    free(genomes);
+    return DEVOL_ERR;
+  }
+
+  memset(pool->island_stats, 0, sizeof(struct devol_island) * pool->islands);
+  for ( i = 0; i < pool->islands; i++)
+    pool->island_stats[i].top = &top[i * top_len];
+
+  /* Each hall of fame entry owns a genome buffer for good. Entries move
+   * around as better ones come in but the buffers just move with them. */
+  memset(pool->hall_of_fame, 0, sizeof(solution_t) * len);
+  if ( genomes ){
+    for ( i = 0; i < len; i++)
+      pool->hall_of_fame[i].private.ptr =
+	genomes + (i * pool->params.genome_size);
+  }
+
+  pool->hall_of_fame_genomes = genomes;
+  pool->hall_of_fame_len = len;
+  pool->hall_of_fame_count = 0;
+  pool->top_len = top_len;
+  memset(&pool->fitness, 0, sizeof(struct devol_fitness));
+  pool->best = DEVOL_FITNESS_NONE;
+
+  if ( _gene_pool_init_migration(pool) || _gene_pool_init_islands(pool) ){
+    _gene_pool_free_fitness(pool);
+    return DEVOL_ERR;
+  }
+
+  return DEVOL_OK;
+
+}
+
+void _gene_pool_free_fitness(struct gene_pool *pool){
+
+  if ( ! pool->island_stats )
+    return;
+
+  _gene_pool_free_migration(pool);
+  _gene_pool_free_islands(pool);
+  _gene_pool_free(pool, pool->island_stats[0].top);
+  _gene_pool_free(pool, pool->island_stats);
+  free(pool->hall_of_fame);
+  free(pool->hall_of_fame_genomes);
+  pool->island_stats = NULL;
+  pool->hall_of_fame = NULL;
+  pool->hall_of_fame_genomes = NULL;
+
+}
+
+/*
+ * One pass over an island that has just been evaluated. Runs on the thread
+ * evolving the island.
+ */
+void _gene_pool_island_fitness_p(struct devol_controller *controller,
+				 int island, int start, int stop){
+
+  int i, j;
+  int len;
+  double f, d;
+  uint64_t key, cur;
+  struct gene_pool *pool = controller->gene_pool;
+  struct devol_island *is = &pool->island_stats[island];
+
+  len = pool->top_len;
+  is->count = 0;
+  is->mean = 0;
+  is->m2 = 0;
+  is->min = HUGE_VAL;
+  is->max = -HUGE_VAL;
+  is->top_count = 0;
+
+  for ( i = start; i < stop; i++){
+
+    f = pool->solutions[i].fitness_val;
+    if ( isnan(f) )
+      continue;
+
+    is->count++;
+    d = f - is->mean;
+    is->mean += d / is->count;
+    is->m2 += d * (f - is->mean);
+    if ( f < is->min )
+      is->min = f;
+    if ( f > is->max )
+      is->max = f;
+
+    /* The sort leaves most of the island in order so this is rarely more
+     * than a compare. */
+    if ( is->top_count == len &&
+	 f >= pool->solutions[is->top[len - 1]].fitness_val )
+      continue;
+    j = is->top_count < len ? is->top_count++ : len - 1;
+    for ( ; j > 0 && pool->solutions[is->top[j - 1]].fitness_val > f; j--)
+      is->top[j] = is->top[j - 1];
+    is->top[j] = i;
+
+  }
+
+  _gene_pool_migrate_send_p(controller, island);
+
+  if ( ! is->count )
+    return;
+
+  key = devol_fitness_key(is->min);
+  do {
+    cur = pool->best;
+    if ( cur <= key )
+      break;
+  } while ( ! __sync_bool_compare_and_swap(&pool->best, cur, key) );
+
+}
+
+/*
+ * Is sol already in the hall of fame? Surviving solutions show up again every
+ * generation.
+ */
+static int _hall_of_fame_has(struct gene_pool *pool, solution_t *sol){
+
+  int i;
+  solution_t *h;
+
+  for ( i = 0; i < pool->hall_of_fame_count; i++){
+    h = &pool->hall_of_fame[i];
+    if ( h->fitness_val != sol->fitness_val )
+      continue;
+    /* A copy made with copy() need not match its original byte for byte,
+     * so the same fitness has to do. */
+    if ( pool->params.genome_size && pool->params.copy )
+      return 1;
+    if ( pool->params.genome_size ){
+      if ( memcmp(h->private.ptr, sol->private.ptr,
+		  pool->params.genome_size) == 0 )
+	return 1;
+    } else if ( h->private.uint_64 == sol->private.uint_64 ){
+      return 1;
+    }
+  }
+
+  return 0;
+
+}
+
+static void _hall_of_fame_add(struct gene_pool *pool, solution_t *sol){
+
+  int p, last;
+  void *genome;
+  solution_t *hof = pool->hall_of_fame;
+
+  if ( pool->hall_of_fame_count < pool->hall_of_fame_len )
+    last = pool->hall_of_fame_count;
+  else if ( sol->fitness_val < hof[pool->hall_of_fame_len - 1].fitness_val )
+    last = pool->hall_of_fame_len - 1;
+  else
+    return;
+
+  if ( _hall_of_fame_has(pool, sol) )
+    return;
+
+  /* The entry falling off the end (or the next free one) gives up its genome
+   * buffer to the new entry. */
+  genome = hof[last].private.ptr;
+  for ( p = last; p > 0 && hof[p - 1].fitness_val > sol->fitness_val; p--)
+    hof[p] = hof[p - 1];
+
+  hof[p] = *sol;
+  if ( pool->params.genome_size ){
+    hof[p].private.ptr = genome;
+    if ( pool->params.copy )
+      pool->params.copy(genome, sol->private.ptr);
+    else
+      memcpy(genome, sol->private.ptr, pool->params.genome_size);
+  }
+
+  if ( pool->hall_of_fame_count < pool->hall_of_fame_len )
+    pool->hall_of_fame_count++;
+
+}
+
+/*
+ * Combine the islands. Runs on the calling thread after every island is done
+ * with the generation and before dispersal.
+ */
+void _gene_pool_merge_fitness(struct gene_pool *pool){
+
+  int i, j, n;
+  double d;
+  struct devol_island *is;
+  struct devol_fitness *fit = &pool->fitness;
+  double mean = 0, m2 = 0;
+
+  fit->count = 0;
+  fit->min = HUGE_VAL;
+  fit->max = -HUGE_VAL;
+
+  for ( i = 0; i < pool->islands; i++){
+
+    is = &pool->island_stats[i];
+    if ( ! is->count )
+      continue;
+
+    /* Chan et al's pairwise update. */
+    n = fit->count + is->count;
+    d = is->mean - mean;
+    mean += d * is->count / n;
+    m2 += is->m2 + (d * d * fit->count * is->count) / n;
+    fit->count = n;
+
+    if ( is->min < fit->min )
+      fit->min = is->min;
+    if ( is->max > fit->max )
+      fit->max = is->max;
+
+    for ( j = 0; j < is->top_count && j < pool->hall_of_fame_len; j++)
+      _hall_of_fame_add(pool, &pool->solutions[is->top[j]]);
+
+  }
+
+  fit->mean = mean;
+  fit->variance = fit->count ? m2 / fit->count : 0;
+
+  /* Worker processes can't fold their islands into best themselves. */
+  if ( fit->count && devol_fitness_key(fit->min) < pool->best )
+    pool->best = devol_fitness_key(fit->min);
+
+}
+
+/*
+ * The population's fitness statistics as of the end of the last generation.
+ * All zero before the first generation.
+ */
+void gene_pool_get_fitness(struct gene_pool *pool,
+			   struct devol_fitness *fitness){
+
+  *fitness = pool->fitness;
+
+}
+
+/*
+ * The best fitness ever seen. Safe to call from any thread at any time;
+ * NAN before the first generation.
+ */
+double gene_pool_best_fitness(struct gene_pool *pool){
+
+  return devol_fitness_value(pool->best);
+
+}
+
+/*
+ * A copy of the best solution ever seen, or NULL before the first
+ * generation. Only good until the next generation.
+ */
+solution_t *gene_pool_best(struct gene_pool *pool){
+
+  return pool->hall_of_fame_count ? &pool->hall_of_fame[0] : NULL;
+
+}
+
+/*
+ * Copies of the best solutions ever seen, best first.
+ */
+solution_t *gene_pool_hall_of_fame(struct gene_pool *pool, int *count){
+
+  *count = pool->hall_of_fame_count;
+  return pool->hall_of_fame;
+
+}
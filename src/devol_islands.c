@@ -0,0 +1,136 @@
+/*
+ * Per island evolution parameters. Normally every island breeds with the gene
+ * pool's own reproduction rate and breed fitness, but each island can have
+ * its own, along with a mutation scale the problem applies through
+ * devol_mutation_scale(). Then one run tries out a range of settings at once
+ * and migration carries whatever works between the islands, where a sweep
+ * would need a run per setting.
+ *
+ * The settings are worked out when the gene pool is made and again by
+ * gene_pool_set_params(), on the calling thread, and kept in memory the
+ * workers share, so worker processes see them too. The islands only ever
+ * read them.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* The plastic number; its powers give the steps of an R3 sequence, which
+ * spreads points over a cube about as evenly as anything can for any count. */
+#define DEVOL_PLASTIC  1.2207440846057596
+
+int _gene_pool_init_islands(struct gene_pool *pool){
+
+  pool->island_params = (struct devol_island_params *)
+    _gene_pool_alloc(pool, sizeof(struct devol_island_params) * pool->islands);
+  if ( ! pool->island_params )
+    return DEVOL_ERR;
+
+  _gene_pool_set_islands(pool);
+
+  return DEVOL_OK;
+
+}
+
+void _gene_pool_free_islands(struct gene_pool *pool){
+
+  _gene_pool_free(pool, pool->island_params);
+  pool->island_params = NULL;
+
+}
+
+/*
+ * Work out each island's settings from pool->params: copied out of
+ * island_params if there is a list, spread around the gene pool's own if
+ * island_spread is set, or just the gene pool's own.
+ *
+ * The spread multiplies the reproduction rate, breed fitness and mutation
+ * scale of island i by spread^(2u - 1) for the i-th point u of an R3
+ * sequence, one coordinate each, so the factors run from 1/spread to spread
+ * and every mix of high and low settings turns up somewhere.
+ */
+void _gene_pool_set_islands(struct gene_pool *pool){
+
+  int i, d;
+  double u, alpha, f[3];
+  struct devol_params *params = &pool->params;
+  struct devol_island_params *ip;
+
+  if ( ! pool->island_params )
+    return;
+
+  for ( i = 0; i < pool->islands; i++){
+
+    ip = &pool->island_params[i];
+
+    if ( params->island_params ){
+      *ip = params->island_params[i];
+    } else {
+      f[0] = f[1] = f[2] = 1;
+      if ( params->island_spread > 1 && pool->islands > 1 ){
+	for ( d = 0, alpha = 1; d < 3; d++){
+	  alpha /= DEVOL_PLASTIC;
+	  u = fmod(.5 + (alpha * (i + 1)), 1.0);
+	  f[d] = pow(params->island_spread, (2 * u) - 1);
+	}
+      }
+      ip->reproduction_rate = params->reproduction_rate * f[0];
+      ip->breed_fitness = params->breed_fitness * f[1];
+      ip->mutation_scale = f[2];
+    }
+
+    /* Keep the island breeding something sensible. */
+    if ( ip->reproduction_rate > 1 )
+      ip->reproduction_rate = 1;
+    if ( ip->breed_fitness > .5 )
+      ip->breed_fitness = .5;
+    if ( ip->mutation_scale <= 0 )
+      ip->mutation_scale = 1;
+
+  }
+
+}
+
+/*
+ * The reproduction rate and breed fitness island breeds with.
+ */
+void _gene_pool_island_rates(struct gene_pool *pool, int island,
+			     double *reproduction_rate, double *breed_fitness){
+
+  if ( pool->island_params ){
+    *reproduction_rate = pool->island_params[island].reproduction_rate;
+    *breed_fitness = pool->island_params[island].breed_fitness;
+    return;
+  }
+
+  *reproduction_rate = pool->params.reproduction_rate;
+  *breed_fitness = pool->params.breed_fitness;
+
+}
+
+/*
+ * Print each island's settings and how it did last generation, so a run with
+ * a spread of settings can be read like a sweep.
+ */
+void gene_pool_print_islands(struct gene_pool *pool, FILE *out){
+
+  int i;
+  double rr, bf;
+  struct devol_island *is;
+
+  fprintf(out, "# %-6s %9s %9s %9s %6s %14s %14s\n", "island", "rep rate",
+	  "breed fit", "mut scale", "count", "mean", "min");
+
+  for ( i = 0; i < pool->islands; i++){
+    is = &pool->island_stats[i];
+    _gene_pool_island_rates(pool, i, &rr, &bf);
+    fprintf(out, "  %-6d %9.4lf %9.4lf %9.4lf %6d %14lf %14lf\n", i, rr, bf,
+	    pool->island_params ? pool->island_params[i].mutation_scale : 1,
+	    is->count, is->count ? is->mean : NAN, is->count ? is->min : NAN);
+  }
+
+}
@@ -0,0 +1,309 @@
+/*
+ * Migration between islands along a topology: a ring, a torus or every island
+ * to every other. This takes the place of the random swaps of
+ * gene_pool_disperse() when devol_params.migration asks for it.
+ *
+ * Each island has an outbox with room for its migrants. When a generation is
+ * one that sends, each island copies its best few solutions into its outbox
+ * as it finishes (the island's fitness pass already knows which they are),
+ * on whichever thread or process evolved it. At the start of the next
+ * generation each island pulls in the migrants from the outboxes of the
+ * islands connected to it, each one replacing the island's worst solution if
+ * it is better, again on the thread evolving the island. So the copying is
+ * spread over the workers and the calling thread only decides when to
+ * migrate. The outboxes are double buffered by generation so an island that
+ * is already finishing a generation can't overwrite what a slower one is
+ * still pulling in from the one before.
+ *
+ * Migrants only ever come from the outboxes, which are filled and read in
+ * island order, so results don't depend on the thread count. Genomes go in
+ * and out with devol_params.copy() if the problem gave one, so a genome that
+ * points into itself still does on the other island.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+/*
+ * How many migrants each island sends, or 0 for no topology migration.
+ */
+int _gene_pool_migrants(struct gene_pool *pool){
+
+  int k;
+
+  if ( pool->params.migration == DEVOL_MIGRATE_RANDOM ||
+       ! pool->params.genome_size || pool->islands < 2 )
+    return 0;
+
+  k = pool->params.migrants > 0 ? pool->params.migrants : 1;
+  if ( k > pool->solution_count / pool->islands )
+    k = pool->solution_count / pool->islands;
+
+  return k;
+
+}
+
+/*
+ * Make the outboxes. Called by _gene_pool_init_fitness() once the island
+ * stats are there.
+ */
+int _gene_pool_init_migration(struct gene_pool *pool){
+
+  int slots;
+
+  pool->migrants = _gene_pool_migrants(pool);
+  pool->migrant_genomes = NULL;
+  pool->migrant_fitness = NULL;
+  pool->migrant_count = NULL;
+  pool->migrate_send = 0;
+  pool->migrate_pull = 0;
+  pool->migrate_since = 0;
+  pool->migrate_interval = pool->params.migration_interval > 0 ?
+    pool->params.migration_interval : 1;
+
+  if ( ! pool->migrants )
+    return DEVOL_OK;
+
+  slots = 2 * pool->islands * pool->migrants;
+  pool->migrant_genomes = (char *)
+    _gene_pool_alloc(pool, pool->params.genome_size * slots);
+  pool->migrant_fitness = (double *)
+    _gene_pool_alloc(pool, sizeof(double) * slots);
+  pool->migrant_count = (int *)
+    _gene_pool_alloc(pool, sizeof(int) * 2 * pool->islands);
+  if ( ! pool->migrant_genomes || ! pool->migrant_fitness ||
+       ! pool->migrant_count ){
+    _gene_pool_free_migration(pool);
+    return DEVOL_ERR;
+  }
+  memset(pool->migrant_count, 0, sizeof(int) * 2 * pool->islands);
+
+  return DEVOL_OK;
+
+}
+
+void _gene_pool_free_migration(struct gene_pool *pool){
+
+  _gene_pool_free(pool, pool->migrant_genomes);
+  _gene_pool_free(pool, pool->migrant_fitness);
+  _gene_pool_free(pool, pool->migrant_count);
+  pool->migrant_genomes = NULL;
+  pool->migrant_fitness = NULL;
+  pool->migrant_count = NULL;
+  pool->migrants = 0;
+
+}
+
+/*
+ * The islands island takes migrants from, in the order it takes them. A ring
+ * sends each island's migrants on to the next one. A torus lays the islands
+ * out in as square a grid as divides them and connects each to the islands
+ * left, right, above and below it, wrapping around.
+ */
+static int _migrate_sources(struct gene_pool *pool, int island, int *src){
+
+  int i, j, n = 0;
+  int rows, cols, r, c;
+  int cand[4];
+
+  switch ( pool->params.migration ){
+
+  case DEVOL_MIGRATE_RING:
+    src[n++] = (island + pool->islands - 1) % pool->islands;
+    break;
+
+  case DEVOL_MIGRATE_TORUS:
+    for ( rows = (int)sqrt(pool->islands); pool->islands % rows; rows--)
+      ;
+    cols = pool->islands / rows;
+    r = island / cols;
+    c = island % cols;
+    cand[0] = (r * cols) + ((c + cols - 1) % cols);
+    cand[1] = (r * cols) + ((c + 1) % cols);
+    cand[2] = (((r + rows - 1) % rows) * cols) + c;
+    cand[3] = (((r + 1) % rows) * cols) + c;
+    for ( i = 0; i < 4; i++){
+      if ( cand[i] == island )
+	continue;
+      for ( j = 0; j < n && src[j] != cand[i]; j++)
+	;
+      if ( j == n )
+	src[n++] = cand[i];
+    }
+    break;
+
+  case DEVOL_MIGRATE_FULL:
+    for ( i = 0; i < pool->islands; i++){
+      if ( i != island )
+	src[n++] = i;
+    }
+    break;
+
+  }
+
+  return n;
+
+}
+
+/*
+ * Copy a genome into another slot, an outbox's or a solution's.
+ */
+static void _migrate_copy(struct gene_pool *pool, void *dest, void *src){
+
+  if ( pool->params.copy )
+    pool->params.copy(dest, src);
+  else
+    memcpy(dest, src, pool->params.genome_size);
+
+}
+
+/*
+ * Copy island's best solutions into its outbox, if this generation sends.
+ * Runs on the thread evolving the island, right after its fitness pass.
+ */
+void _gene_pool_migrate_send_p(struct devol_controller *controller,
+			       int island){
+
+  int i, box;
+  size_t size;
+  struct gene_pool *pool = controller->gene_pool;
+  struct devol_island *is = &pool->island_stats[island];
+
+  if ( ! pool->migrants || ! pool->migrate_send )
+    return;
+
+  size = pool->params.genome_size;
+  box = (((pool->generation & 1) * pool->islands) + island) * pool->migrants;
+
+  for ( i = 0; i < pool->migrants && i < is->top_count; i++){
+    _migrate_copy(pool, pool->migrant_genomes + ((box + i) * size),
+		  pool->solutions[is->top[i]].private.ptr);
+    pool->migrant_fitness[box + i] = pool->solutions[is->top[i]].fitness_val;
+  }
+  pool->migrant_count[((pool->generation & 1) * pool->islands) + island] = i;
+
+}
+
+/*
+ * Take in the migrants sent to the island start to stop last generation.
+ * Runs on the thread evolving the island before anything else is done to it.
+ */
+void _gene_pool_migrate_pull_p(struct devol_controller *controller,
+			       int island, int start, int stop){
+
+  int i, m, n, s, box, worst, count;
+  double f;
+  size_t size;
+  struct gene_pool *pool = controller->gene_pool;
+  int src[pool->islands];
+
+  if ( ! pool->migrants || ! pool->migrate_pull )
+    return;
+
+  size = pool->params.genome_size;
+  n = _migrate_sources(pool, island, src);
+
+  for ( s = 0; s < n; s++){
+
+    box = ((((pool->generation - 1) & 1) * pool->islands) + src[s]);
+    count = pool->migrant_count[box];
+    box *= pool->migrants;
+
+    for ( m = 0; m < count; m++){
+
+      /* The island's worst solution; anything not evaluated counts as worse
+       * than everything. */
+      worst = start;
+      for ( i = start + 1; i < stop &&
+	      ! isnan(pool->solutions[worst].fitness_val); i++){
+	f = pool->solutions[i].fitness_val;
+	if ( isnan(f) || f > pool->solutions[worst].fitness_val )
+	  worst = i;
+      }
+
+      /* The rest of this island's migrants are no better. */
+      f = pool->migrant_fitness[box + m];
+      if ( ! isnan(pool->solutions[worst].fitness_val) &&
+	   f >= pool->solutions[worst].fitness_val )
+	break;
+
+      _migrate_copy(pool, pool->solutions[worst].private.ptr,
+		    pool->migrant_genomes + ((box + m) * size));
+      pool->solutions[worst].fitness_val = f;
+
+    }
+
+  }
+
+}
+
+/*
+ * How far apart the islands are: the standard deviation of the islands' mean
+ * fitnesses, each weighted by the island's size, over the standard deviation
+ * of the whole population. The population's variance is the islands' own
+ * variances plus the variance of their means, so this runs from 0 when the
+ * islands look alike to 1 when everything that tells solutions apart is which
+ * island they are on.
+ */
+static double _migrate_diversity(struct gene_pool *pool){
+
+  int i;
+  double d, between = 0;
+  struct devol_island *is;
+  struct devol_fitness *fit = &pool->fitness;
+
+  if ( fit->count < 2 || ! (fit->variance > 0) )
+    return 0;
+
+  for ( i = 0; i < pool->islands; i++){
+    is = &pool->island_stats[i];
+    if ( ! is->count )
+      continue;
+    d = is->mean - fit->mean;
+    between += is->count * d * d;
+  }
+
+  return sqrt((between / fit->count) / fit->variance);
+
+}
+
+/*
+ * Decide what the next generation does. Runs on the calling thread at the
+ * end of a generation, in place of the random dispersal. Whatever was sent
+ * this generation gets pulled in next generation; whether the next one sends
+ * depends on the interval, which adapts to the islands' diversity if
+ * migration_diversity is set: islands that have drifted apart are sent
+ * migrants more and more often, which brings them back together, and then
+ * less and less often again.
+ */
+void _gene_pool_migrate_plan(struct gene_pool *pool){
+
+  int max = pool->params.migration_interval > 0 ?
+    pool->params.migration_interval : 1;
+
+  pool->migrate_pull = pool->migrate_send;
+  pool->migrate_send = 0;
+
+  if ( pool->params.gene_dispersal_factor <= 0 )
+    return;
+
+  if ( pool->params.migration_diversity > 0 ){
+    if ( _migrate_diversity(pool) > pool->params.migration_diversity )
+      pool->migrate_interval = pool->migrate_interval > 1 ?
+	pool->migrate_interval / 2 : 1;
+    else
+      pool->migrate_interval = pool->migrate_interval * 2 < max ?
+	pool->migrate_interval * 2 : max;
+  } else {
+    pool->migrate_interval = max;
+  }
+
+  if ( ++pool->migrate_since >= pool->migrate_interval ){
+    pool->migrate_send = 1;
+    pool->migrate_since = 0;
+  }
+
+}
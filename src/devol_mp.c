@@ -0,0 +1,512 @@
+/*
+ * Evolve the islands in worker processes instead of threads.
+ *
+ * Everything the workers and the calling process both touch lives in one
+ * shared memory mapping made before the workers are forked: the solutions,
+ * the controllers, the islands' fitness stats and the genome arenas. So does
+ * a struct devol_mp, which holds the process shared lock and conditions the
+ * generations are synchronized with. Everything else, the gene_pool struct
+ * included, is each process' own copy; fork() puts the copies at the same
+ * addresses so pointers into them work anywhere.
+ *
+ * Each generation the calling process bumps the epoch and wakes the workers.
+ * Each worker evolves its islands, exactly as a thread would, and counts
+ * itself finished. Then the calling process merges the fitness stats and
+ * does the dispersal as usual. Since fitness() runs in the workers, problems
+ * whose fitness functions keep global state (or are just not reentrant) are
+ * fine here, and a worker that crashes takes only itself down: the calling
+ * process notices and gene_pool_iterate() fails from then on.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+/* Everything in the mapping is aligned to this. */
+#define DEVOL_MP_ALIGN  128
+
+/* How often the calling process checks for dead workers, in ms. */
+#define DEVOL_MP_POLL   50
+
+struct devol_mp {
+
+  /* Protects everything below. start is signalled when epoch changes and
+   * done when finished reaches processes. */
+  pthread_mutex_t lock;
+  pthread_cond_t  start;
+  pthread_cond_t  done;
+
+  unsigned int    epoch;
+  unsigned int    generation;
+  int             finished;
+  int             die;
+
+  /* The params gene_pool_set_params() can change, passed on to the workers
+   * with each generation since their params are their own copies. */
+  double          reproduction_rate;
+  double          breed_fitness;
+
+  /* Likewise whether the generation sends and takes in migrants. */
+  int             migrate_send;
+  int             migrate_pull;
+
+  /* Set once a worker has died; the gene pool is no good after that. */
+  int             crashed;
+
+  /* The worker processes. A pid is 0 once it has been reaped. */
+  int             processes;
+  pid_t          *pids;
+
+  /* The mapping, this struct first, and how much of it is handed out. */
+  size_t          size;
+  size_t          used;
+
+};
+
+static size_t _mp_round(size_t size){
+
+  return (size + DEVOL_MP_ALIGN - 1) & ~((size_t)DEVOL_MP_ALIGN - 1);
+
+}
+
+/*
+ * Get memory for the gene pool's own use: from the shared mapping if it is a
+ * multi process gene pool, malloc() otherwise.
+ */
+void *_gene_pool_alloc(struct gene_pool *pool, size_t size){
+
+  char *ptr;
+
+  if ( ! pool->mp )
+    return malloc(size);
+
+  size = _mp_round(size);
+  if ( pool->mp->used + size > pool->mp->size )
+    return NULL;
+
+  ptr = (char *)pool->mp + pool->mp->used;
+  pool->mp->used += size;
+
+  return ptr;
+
+}
+
+/*
+ * The shared mapping goes all at once in gene_pool_destroy_mp().
+ */
+void _gene_pool_free(struct gene_pool *pool, void *ptr){
+
+  if ( ! pool->mp )
+    free(ptr);
+
+}
+
+/*
+ * Lock the shared lock. If a worker died holding it, whatever it was doing
+ * is lost anyway, so just mark the lock usable again.
+ */
+static void _mp_lock(struct devol_mp *mp){
+
+  if ( pthread_mutex_lock(&mp->lock) == EOWNERDEAD )
+    pthread_mutex_consistent(&mp->lock);
+
+}
+
+/*
+ * What a worker process does with its life.
+ */
+static void _mp_worker(struct gene_pool *pool, struct devol_controller *cont){
+
+  int island;
+  unsigned int epoch = 0;
+  struct devol_mp *mp = pool->mp;
+
+#ifdef __linux__
+  /* Don't outlive the calling process. */
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+
+  for ( ; ; ){
+
+    _mp_lock(mp);
+    while ( mp->epoch == epoch && ! mp->die )
+      pthread_cond_wait(&mp->start, &mp->lock);
+    if ( mp->die ){
+      pthread_mutex_unlock(&mp->lock);
+      _exit(0);
+    }
+    epoch = mp->epoch;
+    pool->generation = mp->generation;
+    pool->params.reproduction_rate = mp->reproduction_rate;
+    pool->params.breed_fitness = mp->breed_fitness;
+    pool->migrate_send = mp->migrate_send;
+    pool->migrate_pull = mp->migrate_pull;
+    pthread_mutex_unlock(&mp->lock);
+
+    for ( island = cont->island_start; island < cont->island_stop; island++)
+      _gene_pool_evolve_island_p(cont, island);
+
+    cont->stats.generations++;
+    cont->work_end = devol_clock_ns();
+
+    _mp_lock(mp);
+    if ( ++mp->finished == mp->processes )
+      pthread_cond_signal(&mp->done);
+    pthread_mutex_unlock(&mp->lock);
+
+  }
+
+}
+
+/*
+ * Reap any workers that have died. Returns how many did.
+ */
+static int _mp_reap(struct devol_mp *mp){
+
+  int i, status, dead = 0;
+
+  for ( i = 0; i < mp->processes; i++){
+    if ( ! mp->pids[i] || waitpid(mp->pids[i], &status, WNOHANG) <= 0 )
+      continue;
+    if ( WIFSIGNALED(status) )
+      fprintf(stderr, "# Worker %d (pid %d) killed by signal %d.\n", i,
+	      (int)mp->pids[i], WTERMSIG(status));
+    else
+      fprintf(stderr, "# Worker %d (pid %d) exited with status %d.\n", i,
+	      (int)mp->pids[i], WEXITSTATUS(status));
+    mp->pids[i] = 0;
+    dead++;
+  }
+
+  return dead;
+
+}
+
+/*
+ * Kill off and reap every worker that is left.
+ */
+static void _mp_kill(struct devol_mp *mp){
+
+  int i;
+
+  for ( i = 0; i < mp->processes; i++){
+    if ( ! mp->pids[i] )
+      continue;
+    kill(mp->pids[i], SIGKILL);
+    waitpid(mp->pids[i], NULL, 0);
+    mp->pids[i] = 0;
+  }
+
+}
+
+/*
+ * Make a gene pool whose islands are evolved by processes worker processes.
+ * Works like gene_pool_create() otherwise, and gene_pool_iterate() runs it.
+ * Per thread perf counters and tracing are not available to the workers so
+ * params.perf and params.trace are ignored. If params.evaluate is set it is
+ * called in the workers, so it had better not depend on state that can't be
+ * shared across a fork() (grid_evaluate()'s servers, for one).
+ *
+ * Solutions are made before the workers are forked, so genomes that live
+ * outside the engine's arenas (genome_size 0) are copied into each worker
+ * and the calling process never sees the workers' changes to them. Use
+ * genome_size for anything that has to be read back.
+ */
+int  gene_pool_create_mp(struct gene_pool *pool, int solutions, int processes,
+			 struct devol_params params){
+
+  int i, j, len, migrants;
+  size_t size;
+  pid_t pid;
+  struct devol_mp *mp;
+  struct devol_controller *conts = NULL;
+  pthread_mutexattr_t mattr;
+  pthread_condattr_t cattr;
+
+  if ( processes < 1 )
+    return DEVOL_ERR;
+
+  /* A list of island settings is only as long as the islands asked for. */
+  if ( params.island_params && params.islands < 1 )
+    return DEVOL_ERR;
+
+  pool->params = params;
+  if ( pool->params.breed_fitness > .5 ){
+    printf("# Warning: breed fitness > .5. Setting to .5\n");
+    pool->params.breed_fitness = .5;
+  }
+  pool->params.perf = 0;
+  pool->params.trace = 0;
+
+  pool->islands = params.islands > 0 ? params.islands : processes;
+  pool->generation = 0;
+  pool->solution_count = solutions;
+  pool->recorder = NULL;
+  pool->exporter = NULL;
+  pool->pipeline = NULL;
+
+  /* Work out how big the mapping needs to be: everything put in it below
+   * plus the slack from rounding each piece up. */
+  len = params.hall_of_fame > 0 ? params.hall_of_fame : 1;
+  migrants = _gene_pool_migrants(pool);
+  if ( len < migrants )
+    len = migrants;
+  size = sizeof(struct devol_mp) + (sizeof(pid_t) * processes) +
+    (sizeof(solution_t) * solutions) +
+    (sizeof(struct devol_controller) * processes) +
+    (sizeof(struct devol_island) * pool->islands) +
+    (sizeof(int) * len * pool->islands) +
+    devol_arena_size(params.genome_size, solutions) +
+    ((params.genome_size + sizeof(double)) * 2 * pool->islands * migrants) +
+    (sizeof(int) * 2 * pool->islands) +
+    (sizeof(struct devol_island_params) * pool->islands) +
+    (DEVOL_MP_ALIGN * (processes + 10));
+  size = _mp_round(size);
+
+  mp = (struct devol_mp *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+			       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if ( mp == MAP_FAILED )
+    return DEVOL_ERR;
+
+  memset(mp, 0, sizeof(struct devol_mp));
+  mp->size = size;
+  mp->used = _mp_round(sizeof(struct devol_mp));
+  mp->processes = processes;
+  pool->mp = mp;
+
+  pthread_mutexattr_init(&mattr);
+  pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&mp->lock, &mattr);
+  pthread_mutexattr_destroy(&mattr);
+
+  pthread_condattr_init(&cattr);
+  pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+  pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&mp->start, &cattr);
+  pthread_cond_init(&mp->done, &cattr);
+  pthread_condattr_destroy(&cattr);
+
+  mp->pids = (pid_t *)_gene_pool_alloc(pool, sizeof(pid_t) * processes);
+  pool->solutions = (solution_t *)
+    _gene_pool_alloc(pool, sizeof(solution_t) * solutions);
+  conts = (struct devol_controller *)
+    _gene_pool_alloc(pool, sizeof(struct devol_controller) * processes);
+  if ( ! mp->pids || ! pool->solutions || ! conts )
+    goto fail;
+  memset(conts, 0, sizeof(struct devol_controller) * processes);
+
+  /* There are no threads, just their controllers, one per worker. The
+   * calling process keeps its own for the dispersal. */
+  memset(&pool->workers, 0, sizeof(struct thread_pool));
+  pool->workers.thread_count = processes;
+  pool->workers.controllers = conts;
+  _devol_split_islands(conts, processes, pool, solutions);
+  for ( i = 0; i < processes; i++){
+    conts[i].tid = i;
+    conts[i].die = 0;
+    conts[i].state = DEVOL_TSTATE_FINISHED;
+    conts[i].pool = &pool->workers;
+    conts[i].gene_pool = pool;
+    conts[i].work_end = 0;
+    conts[i].perf = NULL;
+    conts[i].trace = NULL;
+    conts[i].async = NULL;
+    memset(&conts[i].stats, 0, sizeof(struct devol_stats));
+    devol_rng_init(&conts[i].rng, params.rng_type, params.rstate, i);
+  }
+
+  devol_rng_init(&pool->controller.rng, params.rng_type, params.rstate,
+		 processes);
+  memset(&pool->controller.stats, 0, sizeof(struct devol_stats));
+  pool->controller.perf = NULL;
+  pool->controller.trace = NULL;
+  pool->controller.async = NULL;
+  pool->controller.gene_pool = pool;
+
+  if ( _gene_pool_init_arenas(pool, conts, processes) )
+    goto fail;
+  /* Made before the fork, so each worker gets its own copy. */
+  if ( _gene_pool_init_batches(pool, conts, processes) )
+    goto fail;
+  if ( _gene_pool_init_fitness(pool) )
+    goto fail;
+
+  for ( i = 0; i < solutions; i++){
+
+    pool->solutions[i].mutate = params.mutate;
+    pool->solutions[i].fitness = params.fitness;
+    pool->solutions[i].init = params.init;
+    pool->solutions[i].destroy = params.destroy;
+
+    for ( j = 0; j < processes; j++){
+      if ( i >= conts[j].start && i < conts[j].stop )
+	pool->solutions[i].cont = &conts[j];
+    }
+
+    if ( pool->arenas ){
+      pool->solutions[i].private.ptr =
+	devol_arena_alloc(pool->solutions[i].cont->arena);
+      if ( ! pool->solutions[i].private.ptr )
+	goto fail;
+    }
+
+    if ( params.deterministic )
+      devol_rng_stream(&pool->solutions[i].cont->rng, params.rstate,
+		       0, i, DEVOL_STREAM_INIT);
+
+    params.init(&(pool->solutions[i]));
+    pool->solutions[i].fitness_val = NAN;
+    pool->solutions[i].cont->stats.inits++;
+
+  }
+
+  /* Anything buffered would be written out once per process otherwise. */
+  fflush(stdout);
+  fflush(stderr);
+
+  for ( i = 0; i < processes; i++){
+    pid = fork();
+    if ( pid < 0 ){
+      _mp_kill(mp);
+      goto fail;
+    }
+    if ( pid == 0 )
+      _mp_worker(pool, &conts[i]);
+    mp->pids[i] = pid;
+  }
+
+  pool->flags = GPOOL_MP;
+
+  return DEVOL_OK;
+
+ fail:
+  if ( conts )
+    _gene_pool_free_batches(conts, processes);
+  munmap(mp, size);
+  free(pool->arenas);
+  pool->arenas = NULL;
+  pool->mp = NULL;
+  return DEVOL_ERR;
+
+}
+
+/*
+ * Stop the worker processes and let go of the shared memory. Everything
+ * that was in it (solutions and genomes included) goes with it.
+ */
+void gene_pool_destroy_mp(struct gene_pool *pool){
+
+  int i;
+  struct devol_mp *mp = pool->mp;
+
+  if ( ! mp )
+    return;
+
+  _mp_lock(mp);
+  mp->die = 1;
+  pthread_cond_broadcast(&mp->start);
+  pthread_mutex_unlock(&mp->lock);
+
+  for ( i = 0; i < mp->processes; i++){
+    if ( mp->pids[i] )
+      waitpid(mp->pids[i], NULL, 0);
+    mp->pids[i] = 0;
+  }
+
+  _gene_pool_free_fitness(pool);
+  _gene_pool_free_batches(pool->workers.controllers, mp->processes);
+  free(pool->arenas);
+  pool->arenas = NULL;
+  pool->solutions = NULL;
+  pool->workers.controllers = NULL;
+  pool->workers.thread_count = 0;
+
+  munmap(mp, mp->size);
+  pool->mp = NULL;
+
+}
+
+/*
+ * gene_pool_iterate() for a multi process gene pool. Returns DEVOL_ERR if a
+ * worker died, in which case the rest are killed off too and the population
+ * is left as it was when that was noticed.
+ */
+int _gene_pool_iterate_mp(struct gene_pool *gene_pool){
+
+  int i;
+  uint64_t now;
+  struct timespec ts;
+  struct devol_mp *mp = gene_pool->mp;
+  struct devol_controller *cont;
+
+  if ( mp->crashed )
+    return DEVOL_ERR;
+
+  _mp_lock(mp);
+  mp->generation = gene_pool->generation;
+  mp->reproduction_rate = gene_pool->params.reproduction_rate;
+  mp->breed_fitness = gene_pool->params.breed_fitness;
+  mp->migrate_send = gene_pool->migrate_send;
+  mp->migrate_pull = gene_pool->migrate_pull;
+  mp->finished = 0;
+  mp->epoch++;
+  pthread_cond_broadcast(&mp->start);
+
+  /* A dead worker never finishes, so don't wait on the condition for good. */
+  while ( mp->finished < mp->processes ){
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_nsec += DEVOL_MP_POLL * 1000000L;
+    if ( ts.tv_nsec >= 1000000000L ){
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    if ( pthread_cond_timedwait(&mp->done, &mp->lock, &ts) == EOWNERDEAD )
+      pthread_mutex_consistent(&mp->lock);
+    if ( mp->finished < mp->processes && _mp_reap(mp) ){
+      mp->crashed = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&mp->lock);
+
+  if ( mp->crashed ){
+    fprintf(stderr, "# Lost a worker in generation %u; stopping the rest.\n",
+	    gene_pool->generation);
+    _mp_kill(mp);
+    return DEVOL_ERR;
+  }
+
+  /* Same as for threads: everyone waited on the slowest worker. */
+  now = devol_clock_ns();
+  for ( i = 0; i < mp->processes; i++){
+    cont = &gene_pool->workers.controllers[i];
+    cont->stats.ns[DEVOL_PHASE_WAIT] += now - cont->work_end;
+  }
+
+  _gene_pool_merge_fitness(gene_pool);
+  gene_pool_disperse(gene_pool);
+
+  gene_pool->generation++;
+
+  if ( gene_pool->recorder )
+    _gene_pool_record_generation(gene_pool);
+  if ( gene_pool->exporter )
+    _gene_pool_export_generation(gene_pool);
+
+  return DEVOL_OK;
+
+}
@@ -0,0 +1,282 @@
+/*
+ * Hardware performance counters for the engine's phases. If a gene pool is
+ * made with devol_params.perf set, each controller opens a group of counters
+ * (cycles, instructions, last level cache misses and branch misses) for its
+ * own thread with perf_event_open(). The phase timers in devol.h then read
+ * the group at every phase boundary and charge the difference to the phase
+ * that just ended.
+ *
+ * This is Linux only. Anywhere else, or if the kernel will not give us the
+ * counters (no PMU in a VM, perf_event_paranoid, etc), the controllers simply
+ * run without them and gene_pool_get_perf() says so.
+ */
+
+#include <devol.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+struct devol_perf {
+
+  /* The group leader is fd[DEVOL_PERF_CYCLES]; -1 for counters that could
+   * not be opened. */
+  int      fd[DEVOL_PERF_COUNTERS];
+
+  /* Where each open counter shows up in a group read. */
+  int      slot[DEVOL_PERF_COUNTERS];
+  int      nr;
+
+  /* The counter values at the last phase boundary. */
+  uint64_t last[DEVOL_PERF_COUNTERS];
+
+  /* Accumulated counts for each phase. */
+  uint64_t counts[DEVOL_PHASES][DEVOL_PERF_COUNTERS];
+
+};
+
+/* Only complain about missing counters once. */
+static volatile int perf_warned = 0;
+
+#ifdef __linux__
+
+static int _perf_event_open(uint64_t config, int group_fd){
+
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.disabled = group_fd == -1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  /* This thread, any CPU. */
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+
+}
+
+/*
+ * Open the counters for the calling thread and hang them off the controller.
+ * Must be called on the thread that runs the controller.
+ */
+int devol_perf_open(struct devol_controller *controller){
+
+  int i;
+  struct devol_perf *perf;
+  uint64_t configs[DEVOL_PERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+  };
+
+  perf = (struct devol_perf *)malloc(sizeof(struct devol_perf));
+  if ( ! perf )
+    return DEVOL_ERR;
+  memset(perf, 0, sizeof(struct devol_perf));
+
+  /* Without cycles there is no group. The others are nice to have. */
+  perf->fd[0] = _perf_event_open(configs[0], -1);
+  if ( perf->fd[0] < 0 ){
+    if ( ! perf_warned ){
+      perf_warned = 1;
+      fprintf(stderr, "# Hardware counters unavailable (%s).\n",
+	      strerror(errno));
+    }
+    free(perf);
+    return DEVOL_ERR;
+  }
+  perf->slot[0] = perf->nr++;
+
+  for ( i = 1; i < DEVOL_PERF_COUNTERS; i++){
+    perf->fd[i] = _perf_event_open(configs[i], perf->fd[0]);
+    perf->slot[i] = perf->fd[i] < 0 ? -1 : perf->nr++;
+  }
+
+  ioctl(perf->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(perf->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+  controller->perf = perf;
+  _devol_perf_sample(controller, -1);
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Read the group and charge what happened since the last read to phase. A
+ * phase of -1 just marks the start of a phase.
+ */
+void _devol_perf_sample(struct devol_controller *controller, int phase){
+
+  int i;
+  uint64_t now;
+  uint64_t buf[1 + DEVOL_PERF_COUNTERS];
+  struct devol_perf *perf = controller->perf;
+
+  if ( read(perf->fd[0], buf, sizeof(uint64_t) * (1 + perf->nr)) <= 0 )
+    return;
+
+  for ( i = 0; i < DEVOL_PERF_COUNTERS; i++){
+    if ( perf->slot[i] < 0 )
+      continue;
+    now = buf[1 + perf->slot[i]];
+    if ( phase >= 0 )
+      perf->counts[phase][i] += now - perf->last[i];
+    perf->last[i] = now;
+  }
+
+}
+
+/*
+ * Stop counting. The accumulated counts stay around to be read.
+ */
+void devol_perf_close(struct devol_controller *controller){
+
+  int i;
+  struct devol_perf *perf = controller->perf;
+
+  if ( ! perf )
+    return;
+
+  for ( i = DEVOL_PERF_COUNTERS - 1; i >= 0; i--){
+    if ( perf->fd[i] >= 0 )
+      close(perf->fd[i]);
+    perf->fd[i] = -1;
+  }
+
+}
+
+#else
+
+int devol_perf_open(struct devol_controller *controller){
+
+  if ( ! perf_warned ){
+    perf_warned = 1;
+    fprintf(stderr, "# Hardware counters are only supported on Linux.\n");
+  }
+
+  return DEVOL_ERR;
+
+}
+
+void _devol_perf_sample(struct devol_controller *controller, int phase){}
+void devol_perf_close(struct devol_controller *controller){}
+
+#endif
+
+/*
+ * Stop counting and throw the counts away. Called when the controller goes,
+ * once nothing can ask for its counts any more.
+ */
+void devol_perf_free(struct devol_controller *controller){
+
+  devol_perf_close(controller);
+  free(controller->perf);
+  controller->perf = NULL;
+
+}
+
+static void _perf_add(struct devol_controller *controller, int phase,
+		      uint64_t counts[DEVOL_PERF_COUNTERS], int *found){
+
+  int i;
+
+  if ( ! controller->perf )
+    return;
+
+  for ( i = 0; i < DEVOL_PERF_COUNTERS; i++){
+    if ( controller->perf->slot[i] < 0 )
+      counts[i] = DEVOL_PERF_NONE;
+    else if ( counts[i] != DEVOL_PERF_NONE )
+      counts[i] += controller->perf->counts[phase][i];
+  }
+  *found = 1;
+
+}
+
+/*
+ * Sum the counts for a phase over the gene pool's controllers. Counters that
+ * are not available are set to DEVOL_PERF_NONE. Returns DEVOL_ERR if nothing
+ * was counted at all.
+ */
+int gene_pool_get_perf(struct gene_pool *pool, int phase,
+		       uint64_t counts[DEVOL_PERF_COUNTERS]){
+
+  int i;
+  int found = 0;
+
+  memset(counts, 0, sizeof(uint64_t) * DEVOL_PERF_COUNTERS);
+  if ( ! pool || phase < 0 || phase >= DEVOL_PHASES )
+    return DEVOL_ERR;
+
+  _perf_add(&pool->controller, phase, counts, &found);
+  for ( i = 0; i < pool->workers.thread_count; i++)
+    _perf_add(&pool->workers.controllers[i], phase, counts, &found);
+
+  return found ? DEVOL_OK : DEVOL_ERR;
+
+}
+
+/*
+ * Print IPC and misses per thousand instructions for the phases the worker
+ * threads run.
+ */
+void gene_pool_print_perf(struct gene_pool *pool, FILE *out){
+
+  int p;
+  uint64_t c[DEVOL_PERF_COUNTERS];
+  char *names[] = { "fitness", "sort", "breed", "replace" };
+  char llc[16], br[16];
+
+  if ( gene_pool_get_perf(pool, DEVOL_PHASE_FITNESS, c) ){
+    fprintf(out, "# Hardware counters: not available.\n");
+    return;
+  }
+
+  fprintf(out, "# Hardware counters:\n");
+  fprintf(out, "#   phase          Mcycles      Minstr    IPC"
+	  "  LLC-MPKI  br-MPKI\n");
+  for ( p = DEVOL_PHASE_FITNESS; p <= DEVOL_PHASE_REPLACE; p++){
+
+    gene_pool_get_perf(pool, p, c);
+
+    if ( c[DEVOL_PERF_INSTRUCTIONS] == DEVOL_PERF_NONE ||
+	 ! c[DEVOL_PERF_INSTRUCTIONS] ){
+      fprintf(out, "#   %-8s %12.3lf           -      -         -        -\n",
+	      names[p], c[DEVOL_PERF_CYCLES] / 1.0e6);
+      continue;
+    }
+
+    if ( c[DEVOL_PERF_LLC_MISSES] == DEVOL_PERF_NONE )
+      snprintf(llc, sizeof(llc), "-");
+    else
+      snprintf(llc, sizeof(llc), "%.3lf",
+	       (1000.0 * c[DEVOL_PERF_LLC_MISSES]) /
+	       c[DEVOL_PERF_INSTRUCTIONS]);
+    if ( c[DEVOL_PERF_BRANCH_MISSES] == DEVOL_PERF_NONE )
+      snprintf(br, sizeof(br), "-");
+    else
+      snprintf(br, sizeof(br), "%.3lf",
+	       (1000.0 * c[DEVOL_PERF_BRANCH_MISSES]) /
+	       c[DEVOL_PERF_INSTRUCTIONS]);
+
+    fprintf(out, "#   %-8s %12.3lf %11.3lf %6.2lf %9s %8s\n", names[p],
+	    c[DEVOL_PERF_CYCLES] / 1.0e6, c[DEVOL_PERF_INSTRUCTIONS] / 1.0e6,
+	    (double)c[DEVOL_PERF_INSTRUCTIONS] / c[DEVOL_PERF_CYCLES],
+	    llc, br);
+
+  }
+
+}
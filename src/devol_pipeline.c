@@ -0,0 +1,449 @@
+/*
+ * A pipelined gene pool: instead of each thread evaluating, sorting, breeding
+ * and then evaluating the children of its islands in turn, breeding and
+ * evaluation are done by separate threads and overlap.
+ *
+ *   breeders    Each owns a block of islands, as a worker thread would. For
+ *               each island it sorts, breeds the children into the slots of
+ *               the worst solutions and pushes each child's index onto a
+ *               lock free queue as soon as it is made.
+ *
+ *   evaluators  Take children off of the queue, a few at a time, and work
+ *               out their fitnesses (with params.evaluate() if there is one).
+ *
+ *   replace     The calling thread. Once every child of an island has been
+ *               evaluated the island is done: it takes the island's share of
+ *               the fitness stats and its best solutions, island by island,
+ *               while the breeders and evaluators carry on with the rest.
+ *
+ * Children are bred straight into the slots they replace (see
+ * _gene_pool_breed_p()) so there is nothing to copy back in; the replace
+ * stage only has to wait for them. A slot bred into twice in a generation
+ * (reproduction_rate > breed_fitness) is only queued the last time, as its
+ * first child never got evaluated before either. The result is the same as
+ * the other algorithms: bitwise the same population in deterministic mode.
+ *
+ * How many breeders and evaluators to have depends on how expensive mutate()
+ * is compared to fitness(); most problems want a breeder or two and the rest
+ * evaluators.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <sched.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* How many children an evaluator takes off of the queue at once. */
+#define DEVOL_PIPE_BATCH  16
+
+struct devol_pipeline {
+
+  /* Generations are started and finished under lock: start is signalled when
+   * epoch changes and done when finished reaches the thread count. */
+  pthread_mutex_t lock;
+  pthread_cond_t  start;
+  pthread_cond_t  done;
+  unsigned int    epoch;
+  int             finished;
+  int             die;
+
+  int             breeders;
+  int             evaluators;
+
+  /* Children waiting for evaluation. */
+  struct devol_queue queue;
+
+  /* Breeders that have not finished the generation yet. */
+  volatile int    breeding;
+
+  /* For each island, how many children it got this generation (-1 until its
+   * breeder is done with it) and how many of them have been evaluated. */
+  volatile int   *children;
+  volatile int   *evaluated;
+
+};
+
+/*
+ * The island a solution index is in; see _gene_pool_island_bounds().
+ */
+static int _pipe_island(struct gene_pool *pool, int index){
+
+  int island = index / (int)(pool->solution_count / pool->islands);
+
+  return island < pool->islands ? island : pool->islands - 1;
+
+}
+
+static void _pipe_breed(struct devol_controller *cont){
+
+  int i, island, start, stop, slot, count;
+  int new_count, breeder_window;
+  double rr, bf;
+  uint64_t t;
+  struct gene_pool *pool = cont->gene_pool;
+  struct devol_pipeline *pipe = pool->pipeline;
+
+  for ( island = cont->island_start; island < cont->island_stop; island++){
+
+    t = devol_phase_begin(cont);
+    _gene_pool_island_bounds(pool, island, &start, &stop);
+
+    if ( pool->migrants && pool->migrate_pull ){
+      _gene_pool_migrate_pull_p(cont, island, start, stop);
+      t = devol_phase_end(cont, DEVOL_PHASE_DISPERSE, t);
+    }
+
+    /* Only the first generation has anything to evaluate here. */
+    _gene_pool_evaluate_p(cont, start, stop);
+    t = devol_phase_end(cont, DEVOL_PHASE_FITNESS, t);
+
+    qsort(&(pool->solutions[start]), stop - start,
+	  sizeof(solution_t), _compare_solutions);
+    t = devol_phase_end(cont, DEVOL_PHASE_SORT, t);
+
+    _gene_pool_island_rates(pool, island, &rr, &bf);
+    new_count = (int)(rr * (stop - start));
+    breeder_window = (int)(bf * (stop - start));
+
+    count = 0;
+    for ( i = 0; breeder_window > 1 && i < new_count; i++){
+      slot = _gene_pool_breed_one_p(cont, start, stop, i, breeder_window);
+      if ( i < new_count - breeder_window )
+	continue;
+      while ( devol_queue_push(&pipe->queue, slot) )
+	sched_yield();
+      count++;
+    }
+
+    /* The children have to be in the queue before the count is. */
+    __sync_synchronize();
+    pipe->children[island] = count;
+    devol_phase_end(cont, DEVOL_PHASE_BREED, t);
+
+  }
+
+  __sync_fetch_and_sub(&pipe->breeding, 1);
+
+}
+
+static void _pipe_evaluate(struct devol_controller *cont){
+
+  int i, n, index, done;
+  uint64_t t;
+  solution_t *batch[DEVOL_PIPE_BATCH];
+  int islands[DEVOL_PIPE_BATCH];
+  struct gene_pool *pool = cont->gene_pool;
+  struct devol_pipeline *pipe = pool->pipeline;
+
+  t = devol_phase_begin(cont);
+  for ( ; ; ){
+
+    /* If the breeders were done before the queue was found empty there is
+     * nothing more coming. */
+    done = pipe->breeding == 0;
+    __sync_synchronize();
+
+    n = 0;
+    while ( n < DEVOL_PIPE_BATCH &&
+	    devol_queue_pop(&pipe->queue, &index) == DEVOL_OK ){
+      batch[n] = &pool->solutions[index];
+      islands[n++] = _pipe_island(pool, index);
+    }
+
+    if ( ! n ){
+      if ( done )
+	break;
+      sched_yield();
+      continue;
+    }
+
+    t = devol_phase_end(cont, DEVOL_PHASE_WAIT, t);
+    _gene_pool_evaluate_list_p(cont, batch, n);
+    __sync_synchronize();
+    for ( i = 0; i < n; i++)
+      __sync_fetch_and_add(&pipe->evaluated[islands[i]], 1);
+    t = devol_phase_end(cont, DEVOL_PHASE_FITNESS, t);
+
+  }
+  devol_phase_end(cont, DEVOL_PHASE_WAIT, t);
+
+}
+
+static void *_devol_pipe_main(void *data){
+
+  unsigned int epoch = 0;
+  struct devol_controller *cont = (struct devol_controller *)data;
+  struct devol_pipeline *pipe = cont->gene_pool->pipeline;
+
+  if ( cont->gene_pool->params.perf )
+    devol_perf_open(cont);
+
+  for ( ; ; ){
+
+    pthread_mutex_lock(&pipe->lock);
+    while ( pipe->epoch == epoch && ! pipe->die )
+      pthread_cond_wait(&pipe->start, &pipe->lock);
+    epoch = pipe->epoch;
+    pthread_mutex_unlock(&pipe->lock);
+
+    if ( pipe->die )
+      break;
+
+    if ( cont->tid < pipe->breeders )
+      _pipe_breed(cont);
+    else
+      _pipe_evaluate(cont);
+
+    cont->stats.generations++;
+    cont->work_end = devol_clock_ns();
+
+    pthread_mutex_lock(&pipe->lock);
+    if ( ++pipe->finished == pipe->breeders + pipe->evaluators )
+      pthread_cond_signal(&pipe->done);
+    pthread_mutex_unlock(&pipe->lock);
+
+  }
+
+  devol_perf_close(cont);
+
+  return NULL;
+
+}
+
+/*
+ * Make a gene pool that breeds with breeders threads and evaluates with
+ * evaluators threads. gene_pool_iterate() runs it. Islands are split among
+ * the breeders (by default one each) and the evaluators take children from
+ * any of them.
+ */
+int  gene_pool_create_pipeline(struct gene_pool *pool, int solutions,
+			       int breeders, int evaluators,
+			       struct devol_params params){
+
+  int i, j, threads;
+  struct devol_pipeline *pipe;
+  struct devol_controller *conts;
+
+  if ( breeders < 1 || evaluators < 1 )
+    return DEVOL_ERR;
+  threads = breeders + evaluators;
+
+  /* A list of island settings is only as long as the islands asked for. */
+  if ( params.island_params && params.islands < 1 )
+    return DEVOL_ERR;
+
+  pool->params = params;
+  if ( pool->params.breed_fitness > .5 ){
+    printf("# Warning: breed fitness > .5. Setting to .5\n");
+    pool->params.breed_fitness = .5;
+  }
+
+  pool->islands = params.islands > 0 ? params.islands : breeders;
+  pool->generation = 0;
+  pool->solution_count = solutions;
+  pool->recorder = NULL;
+  pool->exporter = NULL;
+  pool->mp = NULL;
+
+  pipe = (struct devol_pipeline *)malloc(sizeof(struct devol_pipeline));
+  if ( ! pipe )
+    return DEVOL_ERR;
+  memset(pipe, 0, sizeof(struct devol_pipeline));
+  pipe->breeders = breeders;
+  pipe->evaluators = evaluators;
+  pipe->children = (volatile int *)malloc(sizeof(int) * pool->islands);
+  pipe->evaluated = (volatile int *)malloc(sizeof(int) * pool->islands);
+  if ( ! pipe->children || ! pipe->evaluated ||
+       devol_queue_init(&pipe->queue, solutions) )
+    return DEVOL_ERR;
+  pthread_mutex_init(&pipe->lock, NULL);
+  pthread_cond_init(&pipe->start, NULL);
+  pthread_cond_init(&pipe->done, NULL);
+  pool->pipeline = pipe;
+
+  /* Breeders first, then evaluators. Only the breeders own solutions. */
+  memset(&pool->workers, 0, sizeof(struct thread_pool));
+  pool->workers.thread_count = threads;
+  pool->workers.threads = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+  conts = (struct devol_controller *)
+    malloc(sizeof(struct devol_controller) * threads);
+  if ( ! pool->workers.threads || ! conts )
+    return DEVOL_ERR;
+  memset(conts, 0, sizeof(struct devol_controller) * threads);
+  pool->workers.controllers = conts;
+
+  _devol_split_islands(conts, breeders, pool, solutions);
+  for ( i = 0; i < threads; i++){
+    conts[i].tid = i;
+    conts[i].state = DEVOL_TSTATE_FINISHED;
+    conts[i].pool = &pool->workers;
+    conts[i].gene_pool = pool;
+    devol_rng_init(&conts[i].rng, params.rng_type, params.rstate, i);
+  }
+
+  devol_rng_init(&pool->controller.rng, params.rng_type, params.rstate,
+		 threads);
+  memset(&pool->controller.stats, 0, sizeof(struct devol_stats));
+  pool->controller.perf = NULL;
+  pool->controller.trace = NULL;
+  pool->controller.async = NULL;
+  pool->controller.gene_pool = pool;
+
+  if ( _gene_pool_init_arenas(pool, conts, breeders) ||
+       _gene_pool_init_batches(pool, conts, breeders) )
+    return DEVOL_ERR;
+
+  pool->solutions = (solution_t *)malloc(sizeof(solution_t) * solutions);
+  if ( ! pool->solutions )
+    return DEVOL_ERR;
+
+  if ( _gene_pool_init_fitness(pool) )
+    return DEVOL_ERR;
+
+  if ( params.trace ){
+    for ( i = 0; i < threads; i++){
+      if ( devol_trace_init(&conts[i], params.trace) )
+	return DEVOL_ERR;
+    }
+    if ( devol_trace_init(&pool->controller, params.trace) )
+      return DEVOL_ERR;
+  }
+
+  for ( i = 0; i < solutions; i++){
+
+    pool->solutions[i].mutate = params.mutate;
+    pool->solutions[i].fitness = params.fitness;
+    pool->solutions[i].init = params.init;
+    pool->solutions[i].destroy = params.destroy;
+
+    for ( j = 0; j < breeders; j++){
+      if ( i >= conts[j].start && i < conts[j].stop )
+	pool->solutions[i].cont = &conts[j];
+    }
+
+    if ( pool->arenas ){
+      pool->solutions[i].private.ptr =
+	devol_arena_alloc(pool->solutions[i].cont->arena);
+      if ( ! pool->solutions[i].private.ptr )
+	return DEVOL_ERR;
+    }
+
+    if ( params.deterministic )
+      devol_rng_stream(&pool->solutions[i].cont->rng, params.rstate,
+		       0, i, DEVOL_STREAM_INIT);
+
+    params.init(&(pool->solutions[i]));
+    pool->solutions[i].fitness_val = NAN;
+    pool->solutions[i].cont->stats.inits++;
+
+  }
+
+  for ( i = 0; i < threads; i++){
+    if ( pthread_create(&pool->workers.threads[i], NULL, _devol_pipe_main,
+			&conts[i]) )
+      return DEVOL_ERR;
+  }
+
+  pool->flags = GPOOL_PIPE;
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Stop the pipeline's threads and free what the pipeline itself uses.
+ */
+void gene_pool_destroy_pipeline(struct gene_pool *pool){
+
+  int i;
+  struct devol_pipeline *pipe = pool->pipeline;
+
+  if ( ! pipe )
+    return;
+
+  pthread_mutex_lock(&pipe->lock);
+  pipe->die = 1;
+  pthread_cond_broadcast(&pipe->start);
+  pthread_mutex_unlock(&pipe->lock);
+
+  for ( i = 0; i < pool->workers.thread_count; i++){
+    pthread_join(pool->workers.threads[i], NULL);
+    devol_async_destroy(&pool->workers.controllers[i]);
+    devol_perf_free(&pool->workers.controllers[i]);
+  }
+
+  devol_queue_destroy(&pipe->queue);
+  free((void *)pipe->children);
+  free((void *)pipe->evaluated);
+  free(pipe);
+  free(pool->workers.threads);
+  pool->workers.threads = NULL;
+  pool->pipeline = NULL;
+
+}
+
+/*
+ * gene_pool_iterate() for a pipelined gene pool. The calling thread is the
+ * replace stage.
+ */
+int _gene_pool_iterate_pipeline(struct gene_pool *gene_pool){
+
+  int i, start, stop;
+  uint64_t t, now;
+  struct devol_pipeline *pipe = gene_pool->pipeline;
+  struct devol_controller *cont;
+
+  for ( i = 0; i < gene_pool->islands; i++){
+    pipe->children[i] = -1;
+    pipe->evaluated[i] = 0;
+  }
+  pipe->breeding = pipe->breeders;
+
+  pthread_mutex_lock(&pipe->lock);
+  pipe->finished = 0;
+  pipe->epoch++;
+  pthread_cond_broadcast(&pipe->start);
+  pthread_mutex_unlock(&pipe->lock);
+
+  /* Take each island as soon as its children are all in. */
+  t = devol_phase_begin(&gene_pool->controller);
+  for ( i = 0; i < gene_pool->islands; i++){
+    while ( pipe->children[i] < 0 || pipe->evaluated[i] != pipe->children[i] )
+      sched_yield();
+    __sync_synchronize();
+    t = devol_phase_end(&gene_pool->controller, DEVOL_PHASE_WAIT, t);
+    _gene_pool_island_bounds(gene_pool, i, &start, &stop);
+    _gene_pool_island_fitness_p(&gene_pool->controller, i, start, stop);
+    t = devol_phase_end(&gene_pool->controller, DEVOL_PHASE_REPLACE, t);
+  }
+
+  pthread_mutex_lock(&pipe->lock);
+  while ( pipe->finished < pipe->breeders + pipe->evaluators )
+    pthread_cond_wait(&pipe->done, &pipe->lock);
+  pthread_mutex_unlock(&pipe->lock);
+
+  now = devol_clock_ns();
+  for ( i = 0; i < gene_pool->workers.thread_count; i++){
+    cont = &gene_pool->workers.controllers[i];
+    cont->stats.ns[DEVOL_PHASE_WAIT] += now - cont->work_end;
+    if ( cont->trace )
+      _devol_trace(cont, DEVOL_EVENT_PHASE, DEVOL_PHASE_WAIT, cont->work_end,
+		   now - cont->work_end);
+  }
+
+  _gene_pool_merge_fitness(gene_pool);
+  gene_pool_disperse(gene_pool);
+
+  gene_pool->generation++;
+
+  if ( gene_pool->recorder )
+    _gene_pool_record_generation(gene_pool);
+  if ( gene_pool->exporter )
+    _gene_pool_export_generation(gene_pool);
+
+  return DEVOL_OK;
+
+}
@@ -0,0 +1,109 @@
+/*
+ * A bounded lock free queue for any number of producers and consumers, after
+ * Dmitry Vyukov's. Cell i of the ring starts with sequence number i. A
+ * producer that has claimed position pos may write the cell once its
+ * sequence is pos and then sets it to pos + 1; a consumer that has claimed
+ * pos may read it once its sequence is pos + 1 and then hands it on to the
+ * next lap by setting it to pos + size. Claiming a position is a compare and
+ * swap on head or tail, and that is all the contention there is.
+ */
+
+#include <devol.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Make a queue with room for size values; size is rounded up to a power of 2.
+ */
+int devol_queue_init(struct devol_queue *queue, int size){
+
+  uint64_t i, len = 2;
+
+  while ( len < (uint64_t)size )
+    len <<= 1;
+
+  memset(queue, 0, sizeof(struct devol_queue));
+  queue->cells = (struct devol_queue_cell *)
+    malloc(sizeof(struct devol_queue_cell) * len);
+  if ( ! queue->cells )
+    return DEVOL_ERR;
+
+  for ( i = 0; i < len; i++)
+    queue->cells[i].seq = i;
+  queue->mask = len - 1;
+
+  return DEVOL_OK;
+
+}
+
+void devol_queue_destroy(struct devol_queue *queue){
+
+  free(queue->cells);
+  queue->cells = NULL;
+
+}
+
+/*
+ * Add value to the queue. Returns DEVOL_ERR if it is full.
+ */
+int devol_queue_push(struct devol_queue *queue, int value){
+
+  int64_t diff;
+  uint64_t pos;
+  struct devol_queue_cell *cell;
+
+  pos = queue->head;
+  for ( ; ; ){
+    cell = &queue->cells[pos & queue->mask];
+    diff = (int64_t)cell->seq - (int64_t)pos;
+    if ( diff == 0 ){
+      if ( __sync_bool_compare_and_swap(&queue->head, pos, pos + 1) )
+	break;
+      pos = queue->head;
+    } else if ( diff < 0 ){
+      return DEVOL_ERR;
+    } else {
+      pos = queue->head;
+    }
+  }
+
+  cell->value = value;
+  __sync_synchronize();
+  cell->seq = pos + 1;
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Take the oldest value off of the queue. Returns DEVOL_ERR if it is empty.
+ */
+int devol_queue_pop(struct devol_queue *queue, int *value){
+
+  int64_t diff;
+  uint64_t pos;
+  struct devol_queue_cell *cell;
+
+  pos = queue->tail;
+  for ( ; ; ){
+    cell = &queue->cells[pos & queue->mask];
+    diff = (int64_t)cell->seq - (int64_t)(pos + 1);
+    if ( diff == 0 ){
+      if ( __sync_bool_compare_and_swap(&queue->tail, pos, pos + 1) )
+	break;
+      pos = queue->tail;
+    } else if ( diff < 0 ){
+      return DEVOL_ERR;
+    } else {
+      pos = queue->tail;
+    }
+  }
+
+  *value = cell->value;
+  __sync_synchronize();
+  cell->seq = pos + queue->mask + 1;
+
+  return DEVOL_OK;
+
+}
@@ -0,0 +1,209 @@
+/*
+ * Per generation records. gene_pool_record() makes a gene pool append a
+ * fixed size binary record (struct devol_record) to a file at the end of
+ * every generation: the fitness statistics, and the evaluations and time
+ * spent in each phase during that generation.
+ *
+ * The engine only copies the record into a ring; a background thread does the
+ * writing in big buffered chunks, so a generation never waits on the disk
+ * unless the ring is completely full. devol2evol turns a record file back
+ * into the text .evol format.
+ *
+ * The file is a struct devol_record_header followed by the records, in the
+ * byte order of the machine that wrote it.
+ */
+
+#include <devol.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Records in the ring, and how many to let pile up before waking the
+ * writer. */
+#define RECORD_RING   4096
+#define RECORD_BATCH  256
+
+struct devol_recorder {
+
+  FILE            *out;
+  pthread_t        thread;
+  pthread_mutex_t  lock;
+  pthread_cond_t   more;   /* Signalled when there is a batch to write. */
+  pthread_cond_t   room;   /* Signalled when the writer has made room. */
+
+  /* head is written by the engine, tail by the writer. */
+  struct devol_record ring[RECORD_RING];
+  uint64_t         head;
+  uint64_t         tail;
+  int              stop;
+  int              error;
+
+  /* The engine's totals at the last record, for working out the deltas. */
+  struct devol_stats last;
+
+};
+
+static void *_recorder_main(void *data){
+
+  uint64_t head, tail, n;
+  struct devol_recorder *rec = (struct devol_recorder *)data;
+
+  pthread_mutex_lock(&rec->lock);
+  for ( ; ; ){
+
+    while ( ! rec->stop && rec->head - rec->tail < RECORD_BATCH )
+      pthread_cond_wait(&rec->more, &rec->lock);
+
+    head = rec->head;
+    tail = rec->tail;
+    if ( head == tail && rec->stop )
+      break;
+
+    /* The records between tail and head are ours; write them without the
+     * lock, in at most two pieces since the ring wraps. */
+    pthread_mutex_unlock(&rec->lock);
+    while ( tail < head ){
+      n = RECORD_RING - (tail % RECORD_RING);
+      if ( n > head - tail )
+	n = head - tail;
+      if ( fwrite(&rec->ring[tail % RECORD_RING], sizeof(struct devol_record),
+		  n, rec->out) != n )
+	rec->error = 1;
+      tail += n;
+    }
+    pthread_mutex_lock(&rec->lock);
+
+    rec->tail = tail;
+    pthread_cond_signal(&rec->room);
+
+  }
+  pthread_mutex_unlock(&rec->lock);
+
+  return NULL;
+
+}
+
+/*
+ * Start recording the gene pool's generations to path. The file is
+ * truncated.
+ */
+int gene_pool_record(struct gene_pool *pool, const char *path){
+
+  struct devol_recorder *rec;
+  struct devol_record_header hdr;
+
+  if ( pool->recorder )
+    return DEVOL_ERR;
+
+  rec = (struct devol_recorder *)malloc(sizeof(struct devol_recorder));
+  if ( ! rec )
+    return DEVOL_ERR;
+  memset(rec, 0, sizeof(struct devol_recorder));
+
+  rec->out = fopen(path, "wb");
+  if ( ! rec->out ){
+    free(rec);
+    return DEVOL_ERR;
+  }
+  setvbuf(rec->out, NULL, _IOFBF, 1 << 16);
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, DEVOL_RECORD_MAGIC, sizeof(hdr.magic));
+  hdr.version = DEVOL_RECORD_VERSION;
+  hdr.record_size = sizeof(struct devol_record);
+  hdr.phases = DEVOL_PHASES;
+  hdr.population = pool->solution_count;
+  if ( fwrite(&hdr, sizeof(hdr), 1, rec->out) != 1 ){
+    fclose(rec->out);
+    free(rec);
+    return DEVOL_ERR;
+  }
+
+  gene_pool_get_stats(pool, &rec->last);
+
+  pthread_mutex_init(&rec->lock, NULL);
+  pthread_cond_init(&rec->more, NULL);
+  pthread_cond_init(&rec->room, NULL);
+  if ( pthread_create(&rec->thread, NULL, _recorder_main, rec) ){
+    fclose(rec->out);
+    free(rec);
+    return DEVOL_ERR;
+  }
+
+  pool->recorder = rec;
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Append the generation that just finished. Called by the iterate functions
+ * once the generation is completely done.
+ */
+void _gene_pool_record_generation(struct gene_pool *pool){
+
+  int p;
+  struct devol_stats now;
+  struct devol_record *r;
+  struct devol_recorder *rec = pool->recorder;
+
+  gene_pool_get_stats(pool, &now);
+
+  pthread_mutex_lock(&rec->lock);
+  while ( rec->head - rec->tail == RECORD_RING )
+    pthread_cond_wait(&rec->room, &rec->lock);
+  pthread_mutex_unlock(&rec->lock);
+
+  /* The writer never touches the slot at head. */
+  r = &rec->ring[rec->head % RECORD_RING];
+  r->generation = pool->generation;
+  r->count = pool->fitness.count;
+  r->min = pool->fitness.min;
+  r->mean = pool->fitness.mean;
+  r->max = pool->fitness.max;
+  r->evaluations = now.evaluations - rec->last.evaluations;
+  for ( p = 0; p < DEVOL_PHASES; p++)
+    r->ns[p] = now.ns[p] - rec->last.ns[p];
+  rec->last = now;
+
+  pthread_mutex_lock(&rec->lock);
+  rec->head++;
+  if ( rec->head - rec->tail >= RECORD_BATCH )
+    pthread_cond_signal(&rec->more);
+  pthread_mutex_unlock(&rec->lock);
+
+}
+
+/*
+ * Write out whatever is left and close the file. Returns DEVOL_ERR if any of
+ * the writes failed.
+ */
+int gene_pool_record_stop(struct gene_pool *pool){
+
+  int err;
+  struct devol_recorder *rec = pool->recorder;
+
+  if ( ! rec )
+    return DEVOL_OK;
+
+  pthread_mutex_lock(&rec->lock);
+  rec->stop = 1;
+  pthread_cond_signal(&rec->more);
+  pthread_mutex_unlock(&rec->lock);
+  pthread_join(rec->thread, NULL);
+
+  err = rec->error;
+  if ( fclose(rec->out) )
+    err = 1;
+
+  pthread_mutex_destroy(&rec->lock);
+  pthread_cond_destroy(&rec->more);
+  pthread_cond_destroy(&rec->room);
+  free(rec);
+  pool->recorder = NULL;
+
+  return err ? DEVOL_ERR : DEVOL_OK;
+
+}
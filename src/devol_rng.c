@@ -0,0 +1,292 @@
+/*
+ * The random number generators used by the engine and available to the
+ * problems through each solution's controller.
+ *
+ * The default generator is Philox4x32-10 (Salmon et al, "Parallel Random
+ * Numbers: As Easy as 1, 2, 3"). It is counter based: each block of 4 random
+ * words is a pure function of a 128 bit counter and a 64 bit key. Independent
+ * streams are just different counters, there is no state to update beyond
+ * incrementing the counter, and blocks can be computed independently of each
+ * other which makes bulk filling trivially vectorizable.
+ *
+ * The glibc *rand48_r() family is still available (DEVOL_RNG_RAND48) for
+ * comparison.
+ */
+
+#include <devol.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* Philox4x32 constants. */
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+/*
+ * Compute one Philox4x32-10 block.
+ */
+static inline void _philox4x32(const uint32_t ctr[4], const uint32_t key[2],
+			       uint32_t out[4]){
+
+  int r;
+  uint64_t p0, p1;
+  uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+  uint32_t k0 = key[0], k1 = key[1];
+
+  for ( r = 0; r < 10; r++){
+
+    p0 = (uint64_t)PHILOX_M0 * c0;
+    p1 = (uint64_t)PHILOX_M1 * c2;
+
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t)p1;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t)p0;
+
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+
+  }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+
+}
+
+/*
+ * Compute PHILOX_LANES consecutive blocks at once. Written lane by lane so
+ * that each round is the same operation on every lane; the compiler can turn
+ * that into SIMD multiplies. out gets the blocks one after the other.
+ */
+#define PHILOX_LANES 8
+
+static inline void _philox4x32_lanes(const uint32_t ctr[4],
+				     const uint32_t key[2], uint32_t *out){
+
+  int r, l;
+  uint64_t p0, p1;
+  uint32_t c0[PHILOX_LANES], c1[PHILOX_LANES];
+  uint32_t c2[PHILOX_LANES], c3[PHILOX_LANES];
+  uint32_t n0, n2;
+  uint32_t k0 = key[0], k1 = key[1];
+
+  /* Lane l gets counter + l. The carry into the high word is only possible
+   * for the last few lanes of a 2^32 block stretch; handle it exactly. */
+  for ( l = 0; l < PHILOX_LANES; l++){
+    c0[l] = ctr[0] + l;
+    c1[l] = ctr[1] + (c0[l] < ctr[0]);
+    c2[l] = ctr[2];
+    c3[l] = ctr[3];
+  }
+
+  for ( r = 0; r < 10; r++){
+    for ( l = 0; l < PHILOX_LANES; l++){
+      p0 = (uint64_t)PHILOX_M0 * c0[l];
+      p1 = (uint64_t)PHILOX_M1 * c2[l];
+      n0 = (uint32_t)(p1 >> 32) ^ c1[l] ^ k0;
+      n2 = (uint32_t)(p0 >> 32) ^ c3[l] ^ k1;
+      c1[l] = (uint32_t)p1;
+      c3[l] = (uint32_t)p0;
+      c0[l] = n0;
+      c2[l] = n2;
+    }
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  for ( l = 0; l < PHILOX_LANES; l++){
+    out[(4 * l)]     = c0[l];
+    out[(4 * l) + 1] = c1[l];
+    out[(4 * l) + 2] = c2[l];
+    out[(4 * l) + 3] = c3[l];
+  }
+
+}
+
+/*
+ * Bump the 64 bit block counter held in the first two counter words. The
+ * other two words identify the stream and are never touched.
+ */
+static inline void _philox_advance(uint32_t ctr[4], uint32_t blocks){
+
+  uint32_t old = ctr[0];
+
+  ctr[0] += blocks;
+  if ( ctr[0] < old )
+    ctr[1]++;
+
+}
+
+/*
+ * Set up a generator. The seed is the usual 3 shorts from devol_params and
+ * stream picks one of many independent sequences for that seed; the engine
+ * gives each controller its own stream.
+ */
+void devol_rng_init(struct devol_rng *rng, int type,
+		    const unsigned short seed[3], uint32_t stream){
+
+  memset(rng, 0, sizeof(struct devol_rng));
+  rng->type = type;
+  rng->idx = 4; /* Nothing buffered yet. */
+
+  switch ( type ){
+
+  case DEVOL_RNG_RAND48:
+    /* Same per thread offsets the thread pool has always used. */
+    rng->state.rand48.rstate[0] = seed[0] + stream;
+    rng->state.rand48.rstate[1] = seed[1] + stream + 1;
+    rng->state.rand48.rstate[2] = seed[2] + stream + 2;
+    break;
+
+  default:
+    rng->type = DEVOL_RNG_PHILOX;
+    rng->state.philox.key[0] = seed[0] | ((uint32_t)seed[1] << 16);
+    rng->state.philox.key[1] = seed[2];
+    rng->state.philox.ctr[2] = stream;
+    break;
+
+  }
+
+}
+
+/*
+ * Refill the output buffer. Called by devol_rng_u32() when it runs dry.
+ */
+void _devol_rng_refill(struct devol_rng *rng){
+
+  int i;
+  long int tmp;
+
+  switch ( rng->type ){
+
+  case DEVOL_RNG_RAND48:
+    for ( i = 0; i < 4; i++){
+      devol_jrand48(rng->state.rand48.rstate, &rng->state.rand48.rdata, &tmp);
+      rng->out[i] = (uint32_t)tmp;
+    }
+    break;
+
+  default:
+    _philox4x32(rng->state.philox.ctr, rng->state.philox.key, rng->out);
+    _philox_advance(rng->state.philox.ctr, 1);
+    break;
+
+  }
+
+  rng->idx = 0;
+
+}
+
+/*
+ * Fill d with count uniform doubles on [0,1). For Philox whole blocks are
+ * generated straight into the output; each block only depends on its counter
+ * so there is no serial dependency between iterations.
+ */
+void devol_rng_fill(struct devol_rng *rng, double *d, int count){
+
+  int i = 0, j, b, blocks;
+  uint32_t ctr[4];
+  uint32_t out[4 * PHILOX_LANES];
+
+  /* Use up anything still buffered first. */
+  while ( i < count && rng->idx < 4 )
+    d[i++] = rng->out[rng->idx++] * DEVOL_RNG_UNIT;
+
+  if ( rng->type != DEVOL_RNG_PHILOX ){
+    while ( i < count )
+      d[i++] = devol_rng_uniform(rng);
+    return;
+  }
+
+  memcpy(ctr, rng->state.philox.ctr, sizeof(ctr));
+
+  /* Most of it PHILOX_LANES blocks at a time... */
+  blocks = (count - i) / (4 * PHILOX_LANES);
+  for ( b = 0; b < blocks; b++){
+    _philox4x32_lanes(ctr, rng->state.philox.key, out);
+    for ( j = 0; j < 4 * PHILOX_LANES; j++)
+      d[i + j] = out[j] * DEVOL_RNG_UNIT;
+    i += 4 * PHILOX_LANES;
+    _philox_advance(ctr, PHILOX_LANES);
+  }
+
+  /* ...then single blocks... */
+  blocks = (count - i) / 4;
+  for ( b = 0; b < blocks; b++){
+    _philox4x32(ctr, rng->state.philox.key, out);
+    d[i++] = out[0] * DEVOL_RNG_UNIT;
+    d[i++] = out[1] * DEVOL_RNG_UNIT;
+    d[i++] = out[2] * DEVOL_RNG_UNIT;
+    d[i++] = out[3] * DEVOL_RNG_UNIT;
+    _philox_advance(ctr, 1);
+  }
+  memcpy(rng->state.philox.ctr, ctr, sizeof(ctr));
+
+  /* And the last partial block goes through the buffer. */
+  while ( i < count )
+    d[i++] = devol_rng_uniform(rng);
+
+}
+
+/*
+ * Mix the bits of a 64 bit word (the splitmix64 finalizer). Only used to
+ * spread a deterministic stream id over the 48 bits of rand48 state.
+ */
+static inline uint64_t _mix64(uint64_t x){
+
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+
+  return x;
+
+}
+
+/*
+ * Point a generator at the stream for (seed, generation, slot, tag). Used by
+ * the engine's deterministic mode: the numbers a draw sees depend only on
+ * what is being drawn for, never on which thread happens to draw them.
+ *
+ * For Philox this just sets the counter; the stream id takes the top three
+ * counter words and tag is never 0, so these streams cannot overlap the per
+ * controller streams from devol_rng_init(). rand48 has no such structure so
+ * its state is hashed from the stream id.
+ */
+void devol_rng_stream(struct devol_rng *rng, const unsigned short seed[3],
+		      uint32_t generation, uint32_t slot, uint32_t tag){
+
+  uint64_t h;
+
+  rng->idx = 4;
+
+  switch ( rng->type ){
+
+  case DEVOL_RNG_RAND48:
+    h = seed[0] | ((uint64_t)seed[1] << 16) | ((uint64_t)seed[2] << 32);
+    h = _mix64(h ^ ((uint64_t)tag << 48) ^ generation);
+    h = _mix64(h ^ slot);
+    rng->state.rand48.rstate[0] = (unsigned short)h;
+    rng->state.rand48.rstate[1] = (unsigned short)(h >> 16);
+    rng->state.rand48.rstate[2] = (unsigned short)(h >> 32);
+    memset(&rng->state.rand48.rdata, 0, sizeof(rdata_t));
+    break;
+
+  default:
+    rng->state.philox.key[0] = seed[0] | ((uint32_t)seed[1] << 16);
+    rng->state.philox.key[1] = seed[2];
+    rng->state.philox.ctr[0] = 0;
+    rng->state.philox.ctr[1] = generation;
+    rng->state.philox.ctr[2] = slot;
+    rng->state.philox.ctr[3] = tag;
+    break;
+
+  }
+
+}
@@ -0,0 +1,293 @@
+/*
+ * Run lots of gene pools on one set of threads. Making a thread pool per gene
+ * pool is fine for one big problem, but for many small independent ones (a fit
+ * per data set, say) it means creating threads over and over and far more of
+ * them than there are CPUs. Instead make each gene pool with
+ * gene_pool_create_seq() and hand it to a scheduler as a job.
+ *
+ * The scheduler's threads run jobs a generation at a time. Whenever a thread
+ * is free it takes the waiting job of the highest priority and, among those,
+ * the one that is furthest behind its share (stride scheduling: each
+ * generation a job runs moves its pass on by a stride inversely proportional
+ * to its weight, and the lowest pass goes next). A job is only ever run by one
+ * thread at a time, so any kind of gene pool works, but sequential ones make
+ * the most sense.
+ */
+
+#include <devol.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* A job's pass moves on by this over its weight each generation. */
+#define DEVOL_STRIDE  (1 << 20)
+
+struct devol_sched {
+
+  /* work is signalled when a job can be run (or the threads should exit)
+   * and done when a job finishes. */
+  pthread_mutex_t   lock;
+  pthread_cond_t    work;
+  pthread_cond_t    done;
+  int               die;
+
+  pthread_t        *threads;
+  int               thread_count;
+
+  /* Every job ever added, oldest first, and the pass of the last job that
+   * was run; new jobs start from there so they don't get to catch up on time
+   * from before they were added. */
+  struct devol_job *jobs;
+  struct devol_job *last;
+  uint64_t          pass;
+
+};
+
+/*
+ * The job to run next, or NULL if there is nothing waiting. Call with the
+ * lock held.
+ */
+static struct devol_job *_sched_pick(struct devol_sched *sched){
+
+  struct devol_job *job, *best = NULL;
+
+  for ( job = sched->jobs; job; job = job->next){
+    if ( job->state != DEVOL_JOB_QUEUED )
+      continue;
+    if ( ! best || job->priority > best->priority ||
+	 (job->priority == best->priority && job->pass < best->pass) )
+      best = job;
+  }
+
+  return best;
+
+}
+
+static int _sched_job_done(struct devol_job *job){
+
+  if ( job->ran >= job->generations )
+    return 1;
+  return job->conv && gene_pool_converged(job->pool, job->conv);
+
+}
+
+static void *_sched_main(void *data){
+
+  int done;
+  uint64_t t, evals;
+  struct devol_job *job;
+  struct devol_stats stats;
+  struct devol_sched *sched = (struct devol_sched *)data;
+
+  pthread_mutex_lock(&sched->lock);
+  for ( ; ; ){
+
+    while ( ! (job = _sched_pick(sched)) && ! sched->die )
+      pthread_cond_wait(&sched->work, &sched->lock);
+    if ( sched->die )
+      break;
+
+    job->state = DEVOL_JOB_RUNNING;
+    sched->pass = job->pass;
+    job->pass += DEVOL_STRIDE / (job->weight > 0 ? job->weight : 1);
+    if ( ! job->started )
+      job->started = devol_clock_ns();
+    pthread_mutex_unlock(&sched->lock);
+
+    gene_pool_get_stats(job->pool, &stats);
+    evals = stats.evaluations;
+    t = devol_clock_ns();
+
+    if ( job->pool->flags == GPOOL_SEQ )
+      gene_pool_iterate_seq(job->pool);
+    else
+      gene_pool_iterate(job->pool);
+    job->ran++;
+    done = _sched_job_done(job);
+    if ( job->generation && job->generation(job) )
+      done = 1;
+
+    gene_pool_get_stats(job->pool, &stats);
+
+    pthread_mutex_lock(&sched->lock);
+    job->busy += devol_clock_ns() - t;
+    job->evaluations += stats.evaluations - evals;
+    if ( done ){
+      job->finished = devol_clock_ns();
+      job->state = DEVOL_JOB_DONE;
+      pthread_cond_broadcast(&sched->done);
+    } else {
+      job->state = DEVOL_JOB_QUEUED;
+    }
+
+  }
+  pthread_mutex_unlock(&sched->lock);
+
+  return NULL;
+
+}
+
+/*
+ * Make a scheduler with threads threads. They sleep until there are jobs.
+ */
+struct devol_sched *devol_sched_create(int threads){
+
+  int i;
+  struct devol_sched *sched;
+
+  if ( threads < 1 )
+    return NULL;
+
+  sched = (struct devol_sched *)malloc(sizeof(struct devol_sched));
+  if ( ! sched )
+    return NULL;
+  memset(sched, 0, sizeof(struct devol_sched));
+
+  sched->threads = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+  if ( ! sched->threads ){
+    free(sched);
+    return NULL;
+  }
+
+  pthread_mutex_init(&sched->lock, NULL);
+  pthread_cond_init(&sched->work, NULL);
+  pthread_cond_init(&sched->done, NULL);
+
+  for ( i = 0; i < threads; i++){
+    if ( pthread_create(&sched->threads[i], NULL, _sched_main, sched) )
+      break;
+  }
+  sched->thread_count = i;
+  if ( ! i ){
+    free(sched->threads);
+    free(sched);
+    return NULL;
+  }
+
+  return sched;
+
+}
+
+/*
+ * Add a job. It starts running as soon as a thread is free for it. The job
+ * must stay around until the scheduler is destroyed.
+ */
+int devol_sched_add(struct devol_sched *sched, struct devol_job *job){
+
+  if ( ! job->pool )
+    return DEVOL_ERR;
+
+  pthread_mutex_lock(&sched->lock);
+
+  job->ran = 0;
+  job->started = 0;
+  job->finished = 0;
+  job->busy = 0;
+  job->evaluations = 0;
+  job->pass = sched->pass;
+  job->next = NULL;
+  job->state = job->generations > 0 ? DEVOL_JOB_QUEUED : DEVOL_JOB_DONE;
+
+  if ( sched->last )
+    sched->last->next = job;
+  else
+    sched->jobs = job;
+  sched->last = job;
+
+  pthread_cond_signal(&sched->work);
+  pthread_mutex_unlock(&sched->lock);
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Wait for a job to finish.
+ */
+void devol_sched_wait(struct devol_sched *sched, struct devol_job *job){
+
+  pthread_mutex_lock(&sched->lock);
+  while ( job->state != DEVOL_JOB_DONE )
+    pthread_cond_wait(&sched->done, &sched->lock);
+  pthread_mutex_unlock(&sched->lock);
+
+}
+
+/*
+ * Wait for every job to finish.
+ */
+void devol_sched_wait_all(struct devol_sched *sched){
+
+  struct devol_job *job;
+
+  pthread_mutex_lock(&sched->lock);
+  for ( job = sched->jobs; job; job = job->next){
+    while ( job->state != DEVOL_JOB_DONE )
+      pthread_cond_wait(&sched->done, &sched->lock);
+  }
+  pthread_mutex_unlock(&sched->lock);
+
+}
+
+/*
+ * Print how each job is getting on: generations run, how long it has been
+ * going, what share of a thread it has had, and its generations and
+ * evaluations per second of wall time.
+ */
+void devol_sched_print(struct devol_sched *sched, FILE *out){
+
+  int n = 0;
+  uint64_t now, wall;
+  struct devol_job *job;
+  char *states[] = { "queued", "running", "done" };
+
+  fprintf(out, "# %-16s %4s %6s %8s %7s %9s %6s %9s %12s %12s\n", "job",
+	  "prio", "weight", "state", "gens", "wall ms", "busy%",
+	  "gens/s", "evals/s", "best");
+
+  pthread_mutex_lock(&sched->lock);
+  now = devol_clock_ns();
+  for ( job = sched->jobs; job; job = job->next, n++){
+
+    wall = ! job->started ? 0 :
+      (job->finished ? job->finished : now) - job->started;
+
+    if ( job->name )
+      fprintf(out, "  %-16s", job->name);
+    else
+      fprintf(out, "  job %-12d", n);
+    fprintf(out, " %4d %6d %8s %7d %9.1lf %6.1lf %9.1lf %12.0lf %12lf\n",
+	    job->priority, job->weight > 0 ? job->weight : 1,
+	    states[job->state], job->ran, wall / 1.0e6,
+	    wall ? 100.0 * job->busy / wall : 0,
+	    wall ? job->ran * 1.0e9 / wall : 0,
+	    wall ? job->evaluations * 1.0e9 / wall : 0,
+	    gene_pool_best_fitness(job->pool));
+
+  }
+  pthread_mutex_unlock(&sched->lock);
+
+}
+
+/*
+ * Stop the scheduler's threads once they finish the generations they are
+ * running and free the scheduler. Jobs that are not done yet just stop; the
+ * gene pools are still the program's to destroy.
+ */
+void devol_sched_destroy(struct devol_sched *sched){
+
+  int i;
+
+  pthread_mutex_lock(&sched->lock);
+  sched->die = 1;
+  pthread_cond_broadcast(&sched->work);
+  pthread_mutex_unlock(&sched->lock);
+
+  for ( i = 0; i < sched->thread_count; i++)
+    pthread_join(sched->threads[i], NULL);
+
+  free(sched->threads);
+  free(sched);
+
+}
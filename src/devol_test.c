@@ -93,11 +93,10 @@ int main(int argc, char **argv){
 }
 
 /*
- * This function *must* be reentrant. This function must initialize the 
- * destination solution on its own. This allows optimizations to take place if
- * necessary. Use the controller's random number state and data. Its 
- * deliberatly passed so that each thread can use a renentrant the renentrant
- * erand4_r() function without storing state for each solution.
+ * This function *must* be reentrant. The destination solution is the one
+ * being replaced; just overwrite its value. Use the controller's random number
+ * generator. Each thread has its own so nothing has to be stored for each
+ * solution.
  */
 int mutate(struct solution *par1, struct solution *par2, 
 	   struct solution *dest){
@@ -113,7 +112,7 @@ int mutate(struct solution *par1, struct solution *par2,
     base = par2->private.dp_fp;
 
   /* And vary it by a little bit. */
-  devol_rand48(par1->cont->rstate, &(par1->cont->rdata), &tmp);
+  tmp = devol_rng_uniform(&par1->cont->rng);
   variation = (tmp * variance) - (variance/2);
 
   /* Initialize and set the destination solution. */
@@ -9,11 +9,48 @@
 #include <stdlib.h>
 #include <unistd.h>
 
-#include <sys/timeb.h>
-
 /* Some function prototypes. */
 void *_devol_thread_main(void *data);
 
+/*
+ * Hand each of count controllers a contiguous run of whole islands and the
+ * block of solutions they make up. If there are more controllers than islands
+ * the extra ones get nothing.
+ */
+void _devol_split_islands(struct devol_controller *controllers, int count,
+			  struct gene_pool *gene_pool, int solutions){
+
+  int i;
+  int islands;
+  int start, stop, tmp;
+
+  islands = gene_pool ? gene_pool->islands : 0;
+
+  for ( i = 0; i < count; i++){
+    controllers[i].island_start = (i * islands) / count;
+    controllers[i].island_stop = ((i + 1) * islands) / count;
+  }
+
+  for ( i = 0; i < count; i++){
+    if ( ! gene_pool ){
+      /* No gene pool, so nothing to evolve. Still split the solutions up
+       * the same way they would be anyway. */
+      start = (solutions / count) * i;
+      stop = i == count - 1 ? solutions : start + (solutions / count);
+    } else if ( controllers[i].island_start == controllers[i].island_stop ){
+      start = stop = 0;
+    } else {
+      _gene_pool_island_bounds(gene_pool, controllers[i].island_start,
+			       &start, &tmp);
+      _gene_pool_island_bounds(gene_pool, controllers[i].island_stop - 1,
+			       &tmp, &stop);
+    }
+    controllers[i].start = start;
+    controllers[i].stop = stop;
+  }
+
+}
+
 /*
  * Initialize the the thread pool. Nothing particularly interesting here.
  */
@@ -22,8 +59,6 @@ int thread_pool_init(struct thread_pool *pool,
 
   int i;
   int err;
-  int block_size;
-  int start, stop;
 
   pool->thread_count = threads;
   pool->term_ready = 0;
@@ -48,27 +83,14 @@ int thread_pool_init(struct thread_pool *pool,
   }
 
   /* 
-   * We have to allocate out blocks of the gene pool to each thread. Thus we
-   * must figure out exactly where each block starts and ends. This is more of
-   * a pain that I thought it would be. Oh, then make sure the thread 
-   * controllers are updated with these values.
+   * We have to allocate out blocks of the gene pool to each thread. The
+   * population is split into islands independently of the thread count and
+   * each thread gets a contiguous run of whole islands; with the default of
+   * one island per thread that is one island each. If there are more threads
+   * than islands the extra threads just sit idle. Oh, then make sure the
+   * thread controllers are updated with these values.
    */
-  block_size = solutions / threads;
-  start = 0;
-  stop = block_size;
-
-  for ( i = 0; i < threads; i++){
-    pool->controllers[i].start = start;
-    pool->controllers[i].stop = stop;
-    start = stop;
-    stop += block_size;
-  }
-
-  /* 
-   * Give any extras solutions to the final thread. Unless there are a 
-   * staggering number of threads this really shouldnt be a problem. 
-   */
-  pool->controllers[threads-1].stop = solutions;  
+  _devol_split_islands(pool->controllers, threads, gene_pool, solutions);
 
   /* Finally, start them threads up. */
   for ( i = 0; i < threads; i++){
@@ -77,10 +99,16 @@ int thread_pool_init(struct thread_pool *pool,
     pool->controllers[i].state = DEVOL_TSTATE_FINISHED;
     pool->controllers[i].pool = pool;
     pool->controllers[i].gene_pool = gene_pool;
-    pool->controllers[i].rstate[0] = gene_pool->params.rstate[0] + i;
-    pool->controllers[i].rstate[1] = gene_pool->params.rstate[1] + i+1;
-    pool->controllers[i].rstate[2] = gene_pool->params.rstate[2] + i+2;
-    memset(&(pool->controllers[i].rdata), 0, sizeof(rdata_t));
+    pool->controllers[i].work_end = 0;
+    pool->controllers[i].perf = NULL;
+    pool->controllers[i].trace = NULL;
+    pool->controllers[i].async = NULL;
+    memset(&pool->controllers[i].stats, 0, sizeof(struct devol_stats));
+    if ( gene_pool )
+      devol_rng_init(&pool->controllers[i].rng, gene_pool->params.rng_type,
+		     gene_pool->params.rstate, i);
+    else
+      memset(&pool->controllers[i].rng, 0, sizeof(struct devol_rng));
     err = pthread_create( &(pool->threads[i]), NULL, _devol_thread_main, 
 			  &(pool->controllers[i]));
   }
@@ -109,6 +137,8 @@ int thread_pool_destroy(struct thread_pool *pool){
   /* Wait for each thread to die... */
   for ( i = 0; i < pool->thread_count; i++){
     pthread_join(pool->threads[i], NULL);
+    devol_async_destroy(&pool->controllers[i]);
+    devol_perf_free(&pool->controllers[i]);
   }
 
   /* Now free the thread pool memory. */
@@ -129,39 +159,19 @@ int thread_pool_destroy(struct thread_pool *pool){
  */
 void *_devol_thread_main(void *data){
 
-  double tmp;
-  double rrate;
-  double bfitness;
-  int breeder_window;
-  solution_t *new_solutions;
-  int solution_count, i;
-  solution_t *s1, *s2, *die;
-  int s1_ind, s2_ind;
-  int die_index;
-
-#ifdef _TIMING
-  time_t t_start;
-  time_t t_delta;
-  struct timeb tmp_time;
-#endif
+  int island;
 
   struct devol_controller *controller = (struct devol_controller *)data;
 
   INFO("Thread (ID=%d) starting up.\n", controller->tid);
   INFO(" (ID=%d) Block allocation: %d -> %d\n", controller->tid,
        controller->start, controller->stop);
+  INFO(" (ID=%d) Islands: %d -> %d\n", controller->tid,
+       controller->island_start, controller->island_stop);
 
-  /* Set up our params. */
-  rrate = controller->gene_pool->params.reproduction_rate;
-  bfitness = controller->gene_pool->params.breed_fitness;
-
-  breeder_window = (int)(bfitness * (controller->stop - controller->start));
-  solution_count = (int)(rrate * (controller->stop - controller->start));
-
-  /* Allocate out space for new solutions. */
-  new_solutions = (solution_t *)malloc(sizeof(solution_t) * solution_count);
-  INFO("(ID=%d) Solution count: %d\n", controller->tid, solution_count);
-  INFO("(ID=%d) Breeding window: %d\n", controller->tid, breeder_window);
+  /* Counters have to be opened by the thread they count. */
+  if ( controller->gene_pool && controller->gene_pool->params.perf )
+    devol_perf_open(controller);
 
   /* This lock forces the thread to wait until the calling algorithm is ready
    * for the thread to start up. */
@@ -172,113 +182,19 @@ void *_devol_thread_main(void *data){
    */
  run_iteration:
 
-#ifdef _TIMING
-  ftime(&tmp_time);
-  t_start = (tmp_time.time * 1000) + tmp_time.millitm;
-#endif
-
   controller->state = DEVOL_TSTATE_WORKING;
 
-  /*
-   * Here is where we start doing the work. The algorithm is as follows:
-   *
-   *  1) Calculate each solutions fitness.
-   *  2) Sort our block by fitness. The closer to 0 the fitness value, the
-   *       better the solution.
-   *  3) Create new solutions by breeding good solutions randomly.
-   *  4) Replace the worst solutions with the newly created solutions.
-   */
-  _gene_pool_calculate_fitnesses_p(controller->gene_pool, 
-				   controller->start, controller->stop);
-#ifdef _TIMING
-  ftime(&tmp_time);
-  t_delta = (tmp_time.time * 1000) + tmp_time.millitm;
-  INFO("(ID=%d) Computed fitnesses (delta_t=%d).\n", 
-       controller->tid, (int)(t_delta - t_start));
-#endif
-
-  /*
-   * This could potentially give rise to superlinear speedups. This is because
-   * sort algorithms scale super-linearly with problem size. I.e the run time
-   * for qsort is O(N * log(N)). Thus as N gets larger, the sequential program
-   * starts to hurt more than k subsections of an N sized problem.
-   */
-  qsort(&(controller->gene_pool->solutions[controller->start]), 
-	controller->stop - controller->start,
-	sizeof(solution_t), _compare_solutions);
-#ifdef _TIMING
-  ftime(&tmp_time);
-  t_delta = (tmp_time.time * 1000) + tmp_time.millitm;
-  INFO("(ID=%d) Sorted (delta_t=%d).\n", controller->tid, 
-       (int) (t_delta - t_start));
-#endif
-
-  /* This is kinda complex... basically we have to randomly choose some of the
-   * the better solutions to breed. This is affected by the param 
-   * reproduction_rate. The higher the reproduction rate, the more solutions
-   * we make per generation. 
-   */
-  INFO("%d new solutions...\n", solution_count);
-  for ( i = 0; i < solution_count; i++){
-
-    /* Generate a new solution from the two randomly selected in the
-     * breeder_window. */
-    devol_rand48(controller->rstate, &(controller->rdata), &tmp);
-    s1_ind = (int)(tmp * breeder_window);
-    do {
-      devol_rand48(controller->rstate, &(controller->rdata), &tmp);
-      s2_ind = (int)(tmp * breeder_window);
-    } while (s1_ind == s2_ind);
-
-    /* Get the addresses of the solution data in the solution pool of the
-     * gene pool. The sort will put the better solutions in the lower indexes
-     * of our block, thus we need only use the start of our block and add the
-     * random component of our index in order to get the random solution in the
-     * breeder window. */
-    s1 = (solution_t *) 
-      &(controller->gene_pool->solutions[controller->start + s1_ind]);
-    s2 = (solution_t *) 
-      &(controller->gene_pool->solutions[controller->start + s2_ind]);
-    DEBUG("Mutating solutions: %d(%lf) and %d(%lf).\n", 
-	  s1_ind, s1->fitness_val, 
-	  s2_ind, s2->fitness_val);
-
-    /* And make the new solution. */
-    new_solutions[i].mutate = s1->mutate;
-    new_solutions[i].fitness = s1->fitness;
-    new_solutions[i].init = s1->init;
-    new_solutions[i].destroy = s1->destroy;
-    new_solutions[i].cont = controller;
-    s1->mutate(s1, s2, &(new_solutions[i]));
-
-    /* Now choose a solution to die and be replaced. We will start killing
-     * solutions starting with the bad. We will wrap around if necessary; i.e:
-     * more solutions are bred than we have room for. */
-    die_index = controller->stop - (i % breeder_window) - 1;
-
-    DEBUG("  Killing %d\n", die_index);
-    die = (solution_t *) &(controller->gene_pool->solutions[die_index]);
-    die->destroy(die);
-
-    /* And finally do the replacement. */
-    *die = new_solutions[i];
+  /* Evolve each of our islands for a generation. See
+   * _gene_pool_evolve_island_p() for the algorithm itself. */
+  for ( island = controller->island_start;
+	island < controller->island_stop; island++)
+    _gene_pool_evolve_island_p(controller, island);
 
-  }
-#ifdef _TIMING
-  ftime(&tmp_time);
-  t_delta = (tmp_time.time * 1000) + tmp_time.millitm;
-  INFO("(ID=%d) Breeded (delta_t=%d).\n", controller->tid, 
-       (int) (t_delta - t_start));
-#endif
-
-  _gene_pool_calculate_fitnesses_p(controller->gene_pool, 
-				   controller->start, controller->stop);
-#ifdef _TIMING
-  ftime(&tmp_time);
-  t_delta = (tmp_time.time * 1000) + tmp_time.millitm;
-  INFO("(ID=%d) Done generation (delta_t=%d).\n", 
-       controller->tid, (int) (t_delta - t_start));
-#endif
+  /* The calling thread charges our wait on the others once they are all
+   * done; see gene_pool_iterate(). */
+  controller->stats.generations++;
+  controller->work_end = devol_clock_ns();
+  __sync_synchronize();
 
   /* Make sure the thread_pool is ready to start the thread return... */
   while ( ! controller->pool->term_ready );
@@ -292,6 +208,7 @@ void *_devol_thread_main(void *data){
   /* Good bye cruel world. */
   if ( controller->die ){
     INFO("Killing thread: tid=%d\n", controller->tid);
+    devol_perf_close(controller);
     pthread_exit(0);
   }
 
@@ -311,6 +228,14 @@ int gene_pool_iterate(struct gene_pool *gene_pool){
   int i;
   int done;
   int waiting;
+  uint64_t now;
+  struct devol_controller *cont;
+
+  /* Multi process and pipelined gene pools run generations their own way. */
+  if ( gene_pool->mp )
+    return _gene_pool_iterate_mp(gene_pool);
+  if ( gene_pool->pipeline )
+    return _gene_pool_iterate_pipeline(gene_pool);
 
   /* Make sure threads don't finish before we are ready for them to finish
    * i.e reaquired the sync_lock. */
@@ -360,12 +285,34 @@ int gene_pool_iterate(struct gene_pool *gene_pool){
 
   }
 
+  /* Everyone waited on the slowest thread, plus however long it took us to
+   * notice it was done. */
+  now = devol_clock_ns();
+  for ( i = 0; i < gene_pool->workers.thread_count; i++){
+    cont = &gene_pool->workers.controllers[i];
+    cont->stats.ns[DEVOL_PHASE_WAIT] += now - cont->work_end;
+    /* The worker is parked on the sync_lock, so its ring is ours for now. */
+    if ( cont->trace )
+      _devol_trace(cont, DEVOL_EVENT_PHASE, DEVOL_PHASE_WAIT, cont->work_end,
+		   now - cont->work_end);
+  }
+
+  /* Every island is done so their stats can be put together. */
+  _gene_pool_merge_fitness(gene_pool);
+
   /* Finally, we should do some gene dispersal. Each population of solutions
    * are isolated duing the normal operation of the algorithm. This is like
    * birds on islands. Here we try and get some birds to travel to other 
    * islands, so to speak. */
   gene_pool_disperse(gene_pool);
 
+  gene_pool->generation++;
+
+  if ( gene_pool->recorder )
+    _gene_pool_record_generation(gene_pool);
+  if ( gene_pool->exporter )
+    _gene_pool_export_generation(gene_pool);
+
   return DEVOL_OK;
 
 }
@@ -0,0 +1,175 @@
+/*
+ * Trace rings. When devol_params.trace is set every controller gets a ring of
+ * struct devol_event and records what it does in it: each phase it runs (the
+ * phase timers in devol.h do this), dispersal and failures to get a genome
+ * slot. Only the controller's own thread writes its ring (the calling thread
+ * writes the workers' wait phases, but only while they are parked on the
+ * sync_lock) so recording an event is a handful of stores and a barrier; no
+ * locks and no stdio. Old events are simply overwritten.
+ *
+ * gene_pool_dump_trace() writes the rings out in the Chrome trace event
+ * format, which chrome://tracing and Perfetto can load. Call it between
+ * generations.
+ */
+
+#include <devol.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/*
+ * Give a controller a ring with room for at least events events.
+ */
+int devol_trace_init(struct devol_controller *controller, int events){
+
+  uint32_t size = 1;
+  struct devol_trace *trace;
+
+  while ( size < (uint32_t)events && size < (1U << 30) )
+    size <<= 1;
+
+  trace = (struct devol_trace *)malloc(sizeof(struct devol_trace));
+  if ( ! trace )
+    return DEVOL_ERR;
+
+  trace->events = (struct devol_event *)
+    malloc(sizeof(struct devol_event) * size);
+  if ( ! trace->events ){
+    free(trace);
+    return DEVOL_ERR;
+  }
+
+  trace->mask = size - 1;
+  trace->head = 0;
+  controller->trace = trace;
+
+  return DEVOL_OK;
+
+}
+
+void devol_trace_destroy(struct devol_controller *controller){
+
+  if ( ! controller->trace )
+    return;
+
+  free(controller->trace->events);
+  free(controller->trace);
+  controller->trace = NULL;
+
+}
+
+/*
+ * Record an event. Only ever called by the thread that owns the ring.
+ */
+void _devol_trace(struct devol_controller *controller, int type,
+		  uint32_t arg, uint64_t start, uint64_t dur){
+
+  struct devol_trace *trace = controller->trace;
+  struct devol_event *e = &trace->events[trace->head & trace->mask];
+
+  e->start = start;
+  e->dur = dur;
+  e->generation = controller->gene_pool ? controller->gene_pool->generation : 0;
+  e->type = type;
+  e->arg = arg;
+
+  /* The event has to be there before head says so. */
+  __sync_synchronize();
+  trace->head++;
+
+}
+
+/* The oldest event still in a ring. */
+static uint64_t _trace_tail(struct devol_trace *trace){
+
+  return trace->head > trace->mask + 1 ? trace->head - (trace->mask + 1) : 0;
+
+}
+
+static void _dump_ring(struct devol_controller *controller, int tid,
+		       char *name, uint64_t origin, FILE *out, int *first){
+
+  uint64_t i, head;
+  struct devol_event *e;
+  char *phases[] = { "fitness", "sort", "breed", "replace", "wait",
+		     "disperse" };
+
+  if ( ! controller->trace )
+    return;
+
+  fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+	  "\"tid\":%d,\"args\":{\"name\":\"%s\"}}", *first ? "" : ",",
+	  tid, name);
+  *first = 0;
+
+  head = controller->trace->head;
+  for ( i = _trace_tail(controller->trace); i < head; i++){
+
+    e = &controller->trace->events[i & controller->trace->mask];
+
+    switch ( e->type ){
+
+    case DEVOL_EVENT_PHASE:
+      fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\","
+	      "\"ts\":%.3lf,\"dur\":%.3lf,\"pid\":1,\"tid\":%d,"
+	      "\"args\":{\"generation\":%u}}",
+	      e->arg < DEVOL_PHASES ? phases[e->arg] : "?",
+	      (e->start - origin) / 1000.0, e->dur / 1000.0, tid,
+	      e->generation);
+      break;
+
+    case DEVOL_EVENT_MIGRATION:
+      fprintf(out, ",\n{\"name\":\"migration\",\"cat\":\"dispersal\","
+	      "\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3lf,\"pid\":1,\"tid\":%d,"
+	      "\"args\":{\"generation\":%u,\"swaps\":%u}}",
+	      (e->start - origin) / 1000.0, tid, e->generation, e->arg);
+      break;
+
+    case DEVOL_EVENT_ALLOC_FAIL:
+      fprintf(out, ",\n{\"name\":\"alloc failed\",\"cat\":\"arena\","
+	      "\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3lf,\"pid\":1,\"tid\":%d,"
+	      "\"args\":{\"generation\":%u,\"solution\":%u}}",
+	      (e->start - origin) / 1000.0, tid, e->generation, e->arg);
+      break;
+
+    }
+  }
+
+}
+
+/*
+ * Write every controller's events as a Chrome trace. Times are in
+ * microseconds from the oldest event. The workers show up as threads 0 and
+ * up; the calling thread (dispersal, or everything for the sequential
+ * algorithm) comes after them.
+ */
+int gene_pool_dump_trace(struct gene_pool *pool, FILE *out){
+
+  int i, first = 1;
+  uint64_t origin = (uint64_t)-1;
+  struct devol_controller *c;
+  char name[32];
+
+  for ( i = -1; i < pool->workers.thread_count; i++){
+    c = i < 0 ? &pool->controller : &pool->workers.controllers[i];
+    if ( c->trace && c->trace->head &&
+	 c->trace->events[_trace_tail(c->trace) & c->trace->mask].start <
+	 origin )
+      origin = c->trace->events[_trace_tail(c->trace) & c->trace->mask].start;
+  }
+  if ( origin == (uint64_t)-1 )
+    origin = 0;
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for ( i = 0; i < pool->workers.thread_count; i++){
+    snprintf(name, sizeof(name), "worker %d", i);
+    _dump_ring(&pool->workers.controllers[i], i, name, origin, out, &first);
+  }
+  _dump_ring(&pool->controller, pool->workers.thread_count, "main", origin,
+	     out, &first);
+  fprintf(out, "\n]}\n");
+
+  return ferror(out) ? DEVOL_ERR : DEVOL_OK;
+
+}
@@ -1,7 +1,768 @@
 /*
  * Transparently run certain types of evolutionary problems on a grid of
  * computers.
+ *
+ * This is the island model spread over processes: each node is a process
+ * with its own gene pool (which can itself have as many islands and threads
+ * as it likes) and the nodes pass their best solutions around a ring over
+ * TCP. It goes like this:
+ *
+ *   1) The coordinator listens (grid_listen()) and waits for the nodes.
+ *   2) Each node opens a port of its own, connects to the coordinator
+ *      (grid_join()) and says which port that is. Once every node has turned
+ *      up the coordinator tells each one its rank and where the next node in
+ *      the ring is listening. Each node connects to the next node and
+ *      accepts the previous one.
+ *   3) The nodes evolve, calling grid_migrate() after each generation. Every
+ *      so often that packs the node's best solutions into a batch for the
+ *      next node and takes in any batches the previous node has sent in
+ *      place of its worst solutions. The sending and receiving is done by two
+ *      threads per node; grid_migrate() only touches the queues, so a slow
+ *      neighbour or network never holds up a generation. If a queue fills up
+ *      batches are dropped, and counted.
+ *   4) When a node is done (grid_leave()) it tells the next node, waits for
+ *      the previous node to do the same and sends its statistics to the
+ *      coordinator, which collects them from everyone (grid_coordinate()).
  */
 
 #include <devol.h>
+#include <devol_grid.h>
 
+#include <math.h>
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+/* Batches allowed to wait in each direction before they are dropped. */
+#define GRID_QUEUE_MAX  64
+
+/* The biggest message a node will believe. */
+#define GRID_MSG_MAX    (64 << 20)
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+int _grid_write_all(int fd, const void *buf, size_t len){
+
+  ssize_t n;
+  const char *p = (const char *)buf;
+
+  while ( len ){
+    n = send(fd, p, len, MSG_NOSIGNAL);
+    if ( n < 0 && errno == EINTR )
+      continue;
+    if ( n <= 0 )
+      return DEVOL_ERR;
+    p += n;
+    len -= n;
+  }
+
+  return DEVOL_OK;
+
+}
+
+int _grid_read_all(int fd, void *buf, size_t len){
+
+  ssize_t n;
+  char *p = (char *)buf;
+
+  while ( len ){
+    n = recv(fd, p, len, 0);
+    if ( n < 0 && errno == EINTR )
+      continue;
+    if ( n <= 0 )
+      return DEVOL_ERR;
+    p += n;
+    len -= n;
+  }
+
+  return DEVOL_OK;
+
+}
+
+int _grid_send(int fd, uint32_t type, const void *buf, uint32_t len){
+
+  struct grid_msg msg;
+
+  msg.type = type;
+  msg.length = len;
+  if ( _grid_write_all(fd, &msg, sizeof(msg)) )
+    return DEVOL_ERR;
+
+  return len ? _grid_write_all(fd, buf, len) : DEVOL_OK;
+
+}
+
+/*
+ * Read a message that has to be of a certain type and size.
+ */
+int _grid_expect(int fd, uint32_t type, void *buf, uint32_t len){
+
+  struct grid_msg msg;
+
+  if ( _grid_read_all(fd, &msg, sizeof(msg)) ||
+       msg.type != type || msg.length != len )
+    return DEVOL_ERR;
+
+  return _grid_read_all(fd, buf, len);
+
+}
+
+/*
+ * A socket listening on port (0 for any port) on every interface. Returns the
+ * socket and fills in the port actually used.
+ */
+static int _grid_listen_on(int *port){
+
+  int fd, one = 1;
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if ( fd < 0 )
+    return DEVOL_ERR;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(*port);
+
+  if ( bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+       listen(fd, 64) ||
+       getsockname(fd, (struct sockaddr *)&addr, &len) ){
+    close(fd);
+    return DEVOL_ERR;
+  }
+
+  *port = ntohs(addr.sin_port);
+  return fd;
+
+}
+
+int _grid_connect(struct sockaddr_in *addr){
+
+  int fd, one = 1;
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if ( fd < 0 )
+    return DEVOL_ERR;
+
+  if ( connect(fd, (struct sockaddr *)addr, sizeof(*addr)) ){
+    close(fd);
+    return DEVOL_ERR;
+  }
+
+  /* Batches go out one message at a time; don't let them sit around. */
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+
+}
+
+/*
+ * Start a coordinator listening on port, or any free port if port is 0.
+ * Returns the port.
+ */
+int grid_listen(struct grid_queue *queue, int port){
+
+  queue->nodes = NULL;
+  queue->n_count = 0;
+  queue->fd = _grid_listen_on(&port);
+  if ( queue->fd < 0 )
+    return DEVOL_ERR;
+
+  return port;
+
+}
+
+/*
+ * Wait for nodes nodes to join, put them in a ring and then wait for each
+ * of them to finish. Their statistics go in stats (room for nodes of them)
+ * in rank order. A node that goes away without reporting is marked
+ * DEVOL_GRID_DOWN and gets all zero stats; if that happens this returns
+ * DEVOL_ERR. queue->nodes is left with the nodes' final states; free it when
+ * done with them.
+ */
+int grid_coordinate(struct grid_queue *queue, int nodes,
+		    struct grid_stats *stats){
+
+  int i, fd, err = DEVOL_OK;
+  uint32_t port;
+  socklen_t len;
+  struct grid_node *node, *next;
+  struct grid_setup setup;
+
+  queue->nodes = (struct grid_node *)
+    malloc(sizeof(struct grid_node) * nodes);
+  if ( ! queue->nodes )
+    return DEVOL_ERR;
+  memset(queue->nodes, 0, sizeof(struct grid_node) * nodes);
+
+  /* Each node says hello with the port it is listening on; the address we
+   * see it connecting from is where the previous node will find it. */
+  for ( i = 0; i < nodes; i++){
+
+    node = &queue->nodes[i];
+    len = sizeof(node->host);
+    fd = accept(queue->fd, (struct sockaddr *)&node->host, &len);
+    if ( fd < 0 && errno != EINTR && errno != ECONNABORTED ){
+      while ( i-- > 0 )
+	close(queue->nodes[i].fd);
+      close(queue->fd);
+      queue->fd = -1;
+      return DEVOL_ERR;
+    }
+
+    /* Whoever that was, it was not one of our nodes. */
+    if ( fd < 0 || _grid_expect(fd, GRID_MSG_HELLO, &port, sizeof(port)) ){
+      if ( fd >= 0 )
+	close(fd);
+      i--;
+      continue;
+    }
+
+    node->host.sin_port = htons(port);
+    node->fd = fd;
+    node->state = DEVOL_GRID_AVAIL;
+    pthread_mutex_init(&node->node_lock, NULL);
+    queue->n_count++;
+
+  }
+  close(queue->fd);
+  queue->fd = -1;
+
+  for ( i = 0; i < nodes; i++){
+
+    node = &queue->nodes[i];
+    next = &queue->nodes[(i + 1) % nodes];
+    setup.rank = i;
+    setup.count = nodes;
+    setup.next_addr = next->host.sin_addr.s_addr;
+    setup.next_port = ntohs(next->host.sin_port);
+
+    pthread_mutex_lock(&node->node_lock);
+    if ( _grid_send(node->fd, GRID_MSG_SETUP, &setup, sizeof(setup)) )
+      node->state = DEVOL_GRID_DOWN;
+    else
+      node->state = DEVOL_GRID_BUSY;
+    pthread_mutex_unlock(&node->node_lock);
+
+  }
+
+  for ( i = 0; i < nodes; i++){
+
+    node = &queue->nodes[i];
+    pthread_mutex_lock(&node->node_lock);
+
+    if ( node->state == DEVOL_GRID_DOWN ||
+	 _grid_expect(node->fd, GRID_MSG_STATS, &stats[i],
+		      sizeof(struct grid_stats)) ){
+      memset(&stats[i], 0, sizeof(struct grid_stats));
+      stats[i].rank = i;
+      node->state = DEVOL_GRID_DOWN;
+      err = DEVOL_ERR;
+    } else {
+      node->state = DEVOL_GRID_AVAIL;
+    }
+
+    close(node->fd);
+    node->fd = -1;
+    pthread_mutex_unlock(&node->node_lock);
+    pthread_mutex_destroy(&node->node_lock);
+
+  }
+
+  return err;
+
+}
+
+void grid_print_stats(struct grid_stats *stats, int nodes, FILE *out){
+
+  int i;
+  struct grid_stats total;
+  double best = HUGE_VAL;
+  uint64_t ns = 0;
+
+  memset(&total, 0, sizeof(total));
+  fprintf(out, "# node  generations  evaluations      evals/s      sent"
+	  "  received  accepted  dropped            best\n");
+
+  for ( i = 0; i < nodes; i++){
+
+    fprintf(out, "%6u %12u %12llu %12.0lf %9llu %9llu %9llu %8llu %15lf\n",
+	    stats[i].rank, stats[i].generations,
+	    (unsigned long long)stats[i].evaluations,
+	    stats[i].ns ? stats[i].evaluations * 1.0e9 / stats[i].ns : 0,
+	    (unsigned long long)stats[i].sent,
+	    (unsigned long long)stats[i].received,
+	    (unsigned long long)stats[i].accepted,
+	    (unsigned long long)stats[i].dropped, stats[i].best);
+
+    total.evaluations += stats[i].evaluations;
+    total.sent += stats[i].sent;
+    total.received += stats[i].received;
+    total.accepted += stats[i].accepted;
+    total.dropped += stats[i].dropped;
+    if ( stats[i].ns > ns )
+      ns = stats[i].ns;
+    if ( stats[i].generations && stats[i].best < best )
+      best = stats[i].best;
+
+  }
+
+  fprintf(out, "%6s %12s %12llu %12.0lf %9llu %9llu %9llu %8llu %15lf\n",
+	  "all", "", (unsigned long long)total.evaluations,
+	  ns ? total.evaluations * 1.0e9 / ns : 0,
+	  (unsigned long long)total.sent, (unsigned long long)total.received,
+	  (unsigned long long)total.accepted,
+	  (unsigned long long)total.dropped, best);
+
+}
+
+/*
+ * Send the outbox to the next node until a BYE goes out.
+ */
+static void *_grid_sender(void *data){
+
+  uint32_t type;
+  struct grid_batch *b;
+  struct grid_peer *peer = (struct grid_peer *)data;
+
+  do {
+
+    pthread_mutex_lock(&peer->lock);
+    while ( ! peer->outbox )
+      pthread_cond_wait(&peer->cond, &peer->lock);
+    b = peer->outbox;
+    peer->outbox = b->next;
+    peer->out_len--;
+    pthread_mutex_unlock(&peer->lock);
+
+    /* If the next node has gone away there is nobody to send to; keep
+     * draining so that grid_leave() still finishes. */
+    if ( peer->next.state != DEVOL_GRID_DOWN &&
+	 _grid_write_all(peer->next.fd, &b->msg,
+			 sizeof(struct grid_msg) + b->msg.length) )
+      peer->next.state = DEVOL_GRID_DOWN;
+
+    type = b->msg.type;
+    free(b);
+
+  } while ( type != GRID_MSG_BYE );
+
+  return NULL;
+
+}
+
+/*
+ * Fill the inbox from the previous node until it says BYE or goes away.
+ */
+static void *_grid_receiver(void *data){
+
+  struct grid_msg msg;
+  struct grid_batch *b, **tail;
+  struct grid_peer *peer = (struct grid_peer *)data;
+  size_t rec = sizeof(double) + peer->params.packed_size;
+
+  while ( _grid_read_all(peer->prev.fd, &msg, sizeof(msg)) == DEVOL_OK &&
+	  msg.type != GRID_MSG_BYE && msg.length <= GRID_MSG_MAX ){
+
+    b = (struct grid_batch *)malloc(sizeof(struct grid_batch) + msg.length);
+    if ( ! b )
+      break;
+    b->next = NULL;
+    b->msg = msg;
+    if ( _grid_read_all(peer->prev.fd, b->data, msg.length) ){
+      free(b);
+      break;
+    }
+
+    /* Only migrants from a node packing solutions the way we do are any
+     * use. */
+    if ( msg.type != GRID_MSG_MIGRANTS || msg.length % rec ){
+      free(b);
+      continue;
+    }
+
+    pthread_mutex_lock(&peer->lock);
+    peer->stats.received += msg.length / rec;
+    if ( peer->in_len == GRID_QUEUE_MAX ){
+      /* The gene pool has fallen behind; old migrants are the least
+       * interesting ones. */
+      peer->stats.dropped += peer->inbox->msg.length / rec;
+      b->next = peer->inbox->next;
+      free(peer->inbox);
+      peer->inbox = b->next;
+      b->next = NULL;
+      peer->in_len--;
+    }
+    for ( tail = &peer->inbox; *tail; tail = &(*tail)->next )
+      ;
+    *tail = b;
+    peer->in_len++;
+    pthread_mutex_unlock(&peer->lock);
+
+  }
+
+  pthread_mutex_lock(&peer->lock);
+  peer->prev_done = 1;
+  pthread_cond_broadcast(&peer->cond);
+  pthread_mutex_unlock(&peer->lock);
+
+  return NULL;
+
+}
+
+/*
+ * Join the grid whose coordinator is at host:port. pool is the gene pool this
+ * node will be evolving; it must already be created. Returns once this node
+ * is connected to its neighbours.
+ */
+int grid_join(struct grid_peer *peer, struct gene_pool *pool,
+	      struct grid_params *params, const char *host, int port){
+
+  int fd, listen_port = 0;
+  uint32_t hello;
+  char service[16];
+  struct grid_setup setup;
+  struct sockaddr_in addr;
+  struct addrinfo hints, *res;
+
+  memset(peer, 0, sizeof(struct grid_peer));
+  peer->coordinator.fd = -1;
+  peer->next.fd = -1;
+  peer->prev.fd = -1;
+  peer->pool = pool;
+  peer->params = *params;
+  if ( peer->params.migrants <= 0 )
+    peer->params.migrants = 1;
+  if ( peer->params.migrants > (int)pool->solution_count )
+    peer->params.migrants = pool->solution_count;
+  if ( peer->params.interval <= 0 )
+    peer->params.interval = 1;
+  if ( ! peer->params.packed_size )
+    peer->params.packed_size = pool->params.genome_size ?
+      pool->params.genome_size : sizeof(pool->solutions[0].private);
+
+  peer->listen_fd = _grid_listen_on(&listen_port);
+  if ( peer->listen_fd < 0 )
+    return DEVOL_ERR;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  snprintf(service, sizeof(service), "%d", port);
+  if ( getaddrinfo(host, service, &hints, &res) ){
+    close(peer->listen_fd);
+    return DEVOL_ERR;
+  }
+  memcpy(&addr, res->ai_addr, sizeof(addr));
+  freeaddrinfo(res);
+
+  peer->coordinator.host = addr;
+  peer->coordinator.fd = _grid_connect(&addr);
+  hello = listen_port;
+  if ( peer->coordinator.fd < 0 ||
+       _grid_send(peer->coordinator.fd, GRID_MSG_HELLO, &hello,
+		  sizeof(hello)) ||
+       _grid_expect(peer->coordinator.fd, GRID_MSG_SETUP, &setup,
+		    sizeof(setup)) )
+    goto fail;
+
+  peer->rank = setup.rank;
+  peer->count = setup.count;
+
+  /* The next node's port is already listening so the connect goes through
+   * whether or not it has got round to accepting us yet. With one node the
+   * ring is just us talking to ourselves. */
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = setup.next_addr;
+  addr.sin_port = htons(setup.next_port);
+  peer->next.host = addr;
+  peer->next.fd = _grid_connect(&addr);
+  if ( peer->next.fd < 0 )
+    goto fail;
+  peer->next.state = DEVOL_GRID_BUSY;
+
+  fd = accept(peer->listen_fd, NULL, NULL);
+  if ( fd < 0 )
+    goto fail;
+  peer->prev.fd = fd;
+  peer->prev.state = DEVOL_GRID_BUSY;
+  close(peer->listen_fd);
+  peer->listen_fd = -1;
+
+  pthread_mutex_init(&peer->lock, NULL);
+  pthread_cond_init(&peer->cond, NULL);
+  if ( pthread_create(&peer->receiver, NULL, _grid_receiver, peer) )
+    goto fail;
+  if ( pthread_create(&peer->sender, NULL, _grid_sender, peer) ){
+    /* Hanging up on the previous node stops the receiver. */
+    shutdown(peer->prev.fd, SHUT_RDWR);
+    pthread_join(peer->receiver, NULL);
+    goto fail;
+  }
+
+  peer->stats.rank = peer->rank;
+  peer->started = devol_clock_ns();
+
+  return DEVOL_OK;
+
+ fail:
+  if ( peer->listen_fd >= 0 )
+    close(peer->listen_fd);
+  if ( peer->coordinator.fd >= 0 )
+    close(peer->coordinator.fd);
+  if ( peer->next.fd >= 0 )
+    close(peer->next.fd);
+  if ( peer->prev.fd >= 0 )
+    close(peer->prev.fd);
+  return DEVOL_ERR;
+
+}
+
+/*
+ * Pick the k best (or worst) solutions. Unevaluated solutions count as the
+ * worst there are.
+ */
+static int _grid_select(struct gene_pool *pool, int *idx, double *key,
+			int k, int worst){
+
+  int i, j, n = 0;
+  double f;
+
+  for ( i = 0; i < (int)pool->solution_count; i++){
+
+    f = pool->solutions[i].fitness_val;
+    if ( isnan(f) ){
+      if ( ! worst )
+	continue;
+      f = -HUGE_VAL;
+    } else if ( worst ){
+      f = -f;
+    }
+
+    if ( n == k && f >= key[k - 1] )
+      continue;
+    j = n < k ? n++ : k - 1;
+    for ( ; j > 0 && key[j - 1] > f; j--){
+      key[j] = key[j - 1];
+      idx[j] = idx[j - 1];
+    }
+    key[j] = f;
+    idx[j] = i;
+
+  }
+
+  return n;
+
+}
+
+static void _grid_pack(struct grid_peer *peer, solution_t *sol, char *buf){
+
+  memcpy(buf, &sol->fitness_val, sizeof(double));
+  buf += sizeof(double);
+
+  if ( peer->params.pack )
+    peer->params.pack(sol, buf);
+  else if ( peer->pool->params.genome_size )
+    memcpy(buf, sol->private.ptr, peer->params.packed_size);
+  else
+    memcpy(buf, &sol->private, peer->params.packed_size);
+
+}
+
+static void _grid_unpack(struct grid_peer *peer, solution_t *sol,
+			 const char *buf){
+
+  memcpy(&sol->fitness_val, buf, sizeof(double));
+  buf += sizeof(double);
+
+  if ( peer->params.unpack )
+    peer->params.unpack(sol, buf);
+  else if ( peer->pool->params.genome_size )
+    memcpy(sol->private.ptr, buf, peer->params.packed_size);
+  else
+    memcpy(&sol->private, buf, peer->params.packed_size);
+
+}
+
+/*
+ * Take in the previous node's migrants, if any have come in. Each batch
+ * replaces the worst solutions in the pool, but only where the migrant is
+ * better. The receiver fills the inbox under the lock so it is only looked
+ * at under it too.
+ */
+static void _grid_immigrate(struct grid_peer *peer){
+
+  int i, n, k;
+  int *idx;
+  double f, *key;
+  char *p;
+  struct grid_batch *b, *list;
+  size_t rec = sizeof(double) + peer->params.packed_size;
+  struct gene_pool *pool = peer->pool;
+
+  pthread_mutex_lock(&peer->lock);
+  list = peer->inbox;
+  peer->inbox = NULL;
+  peer->in_len = 0;
+  pthread_mutex_unlock(&peer->lock);
+
+  while ( list ){
+
+    b = list;
+    list = b->next;
+    n = b->msg.length / rec;
+    if ( n > (int)pool->solution_count )
+      n = pool->solution_count;
+
+    idx = (int *)malloc(sizeof(int) * n);
+    key = (double *)malloc(sizeof(double) * n);
+    if ( idx && key ){
+      k = _grid_select(pool, idx, key, n, 1);
+      for ( i = 0, p = b->data; i < k; i++, p += rec){
+	memcpy(&f, p, sizeof(double));
+	if ( isnan(pool->solutions[idx[i]].fitness_val) ||
+	     f < pool->solutions[idx[i]].fitness_val ){
+	  _grid_unpack(peer, &pool->solutions[idx[i]], p);
+	  peer->stats.accepted++;
+	}
+      }
+    }
+
+    free(idx);
+    free(key);
+    free(b);
+
+  }
+
+}
+
+/*
+ * Call after each generation. Every params.interval generations this queues
+ * copies of the best solutions for the next node; every time it takes in
+ * whatever has arrived from the previous node. Never waits on the network.
+ */
+int grid_migrate(struct grid_peer *peer){
+
+  int i, k;
+  int *idx;
+  double *key;
+  struct grid_batch *b, **tail;
+  size_t rec = sizeof(double) + peer->params.packed_size;
+  struct gene_pool *pool = peer->pool;
+
+  if ( pool->generation % peer->params.interval == 0 ){
+
+    k = peer->params.migrants;
+    idx = (int *)malloc(sizeof(int) * k);
+    key = (double *)malloc(sizeof(double) * k);
+    if ( ! idx || ! key ){
+      free(idx);
+      free(key);
+      return DEVOL_ERR;
+    }
+
+    k = _grid_select(pool, idx, key, k, 0);
+    b = (struct grid_batch *)malloc(sizeof(struct grid_batch) + (k * rec));
+    if ( ! b ){
+      free(idx);
+      free(key);
+      return DEVOL_ERR;
+    }
+
+    b->next = NULL;
+    b->msg.type = GRID_MSG_MIGRANTS;
+    b->msg.length = k * rec;
+    for ( i = 0; i < k; i++)
+      _grid_pack(peer, &pool->solutions[idx[i]], b->data + (i * rec));
+    free(idx);
+    free(key);
+
+    pthread_mutex_lock(&peer->lock);
+    if ( peer->out_len == GRID_QUEUE_MAX ){
+      peer->stats.dropped += k;
+      free(b);
+    } else {
+      for ( tail = &peer->outbox; *tail; tail = &(*tail)->next )
+	;
+      *tail = b;
+      peer->out_len++;
+      peer->stats.sent += k;
+      pthread_cond_broadcast(&peer->cond);
+    }
+    pthread_mutex_unlock(&peer->lock);
+
+  }
+
+  _grid_immigrate(peer);
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Leave the grid: tell the next node we are done, wait for the previous one
+ * to do the same and report to the coordinator.
+ */
+int grid_leave(struct grid_peer *peer){
+
+  int err;
+  struct grid_batch *b, **tail;
+  struct devol_stats stats;
+
+  b = (struct grid_batch *)malloc(sizeof(struct grid_batch));
+  if ( ! b )
+    return DEVOL_ERR;
+  b->next = NULL;
+  b->msg.type = GRID_MSG_BYE;
+  b->msg.length = 0;
+
+  pthread_mutex_lock(&peer->lock);
+  for ( tail = &peer->outbox; *tail; tail = &(*tail)->next )
+    ;
+  *tail = b;
+  peer->out_len++;
+  pthread_cond_broadcast(&peer->cond);
+  while ( ! peer->prev_done )
+    pthread_cond_wait(&peer->cond, &peer->lock);
+  pthread_mutex_unlock(&peer->lock);
+
+  pthread_join(peer->sender, NULL);
+  pthread_join(peer->receiver, NULL);
+
+  /* Anything still in the inbox came in after we stopped. */
+  while ( peer->inbox ){
+    b = peer->inbox;
+    peer->inbox = b->next;
+    free(b);
+  }
+
+  gene_pool_get_stats(peer->pool, &stats);
+  peer->stats.generations = peer->pool->generation;
+  peer->stats.evaluations = stats.evaluations;
+  peer->stats.ns = devol_clock_ns() - peer->started;
+  peer->stats.best = gene_pool_best_fitness(peer->pool);
+  peer->stats.mean = peer->pool->fitness.mean;
+
+  err = _grid_send(peer->coordinator.fd, GRID_MSG_STATS, &peer->stats,
+		   sizeof(struct grid_stats));
+
+  close(peer->coordinator.fd);
+  close(peer->next.fd);
+  close(peer->prev.fd);
+  pthread_mutex_destroy(&peer->lock);
+  pthread_cond_destroy(&peer->cond);
+
+  return err;
+
+}
@@ -0,0 +1,537 @@
+/*
+ * Remote fitness evaluation, for fitness functions too heavy to run on the
+ * machine doing the breeding. The engine's batch hook (devol_params.evaluate)
+ * is pointed at grid_evaluate(), which packs the solutions that need
+ * evaluating into batches and ships them to fitness servers: the nodes of a
+ * grid_queue. A server unpacks each batch, runs fitness() on it and sends
+ * back a double per solution.
+ *
+ * Each call keeps up to depth batches in flight on every server it has, so
+ * the servers are never left waiting on the network between batches. With
+ * threads every worker calls grid_evaluate() for its own islands and takes
+ * whichever servers are free, so one thread's batches are out being
+ * evaluated while other threads breed.
+ *
+ * Servers can be:
+ *
+ *   1) Local processes made by grid_fitness_spawn(). They run
+ *      grid_fitness_serve() in a fork of this program, or if the queue has a
+ *      command, that command with the socket on its stdin and stdout.
+ *   2) Remote, made with grid_fitness_connect() to a machine running
+ *      grid_fitness_listen().
+ *
+ * If a server goes away its batches are evaluated locally instead.
+ */
+
+#include <devol.h>
+#include <devol_grid.h>
+
+#include <poll.h>
+#include <math.h>
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/*
+ * Fill in the rest of fit and point params at grid_evaluate(). The queue's
+ * servers can be added before or after.
+ */
+int grid_fitness_init(struct grid_fitness *fit, struct grid_queue *queue,
+		      struct devol_params *params){
+
+  if ( fit->batch <= 0 )
+    fit->batch = 64;
+  if ( fit->depth <= 0 )
+    fit->depth = 4;
+  if ( ! fit->packed_size )
+    fit->packed_size = params->genome_size ? params->genome_size :
+      sizeof(((solution_t *)NULL)->private);
+
+  fit->queue = queue;
+  fit->genome_size = params->genome_size;
+  fit->fitness = params->fitness;
+  fit->batches = 0;
+  fit->remote = 0;
+  fit->local = 0;
+  fit->next = 0;
+
+  params->evaluate = grid_evaluate;
+  params->evaluate_arg = fit;
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Add a server on fd to the queue.
+ */
+static int _grid_add_server(struct grid_queue *queue, int fd, pid_t pid){
+
+  struct grid_node *nodes, *node;
+
+  nodes = (struct grid_node *)realloc(queue->nodes, sizeof(struct grid_node) *
+				      (queue->n_count + 1));
+  if ( ! nodes )
+    return DEVOL_ERR;
+  queue->nodes = nodes;
+
+  node = &nodes[queue->n_count++];
+  memset(node, 0, sizeof(struct grid_node));
+  node->fd = fd;
+  node->pid = pid;
+  node->state = DEVOL_GRID_AVAIL;
+  pthread_mutex_init(&node->node_lock, NULL);
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Start servers local fitness servers and add them to the queue.
+ */
+int grid_fitness_spawn(struct grid_queue *queue, int servers,
+		       struct grid_fitness *fit){
+
+  int i, j, sv[2];
+  pid_t pid;
+
+  for ( i = 0; i < servers; i++){
+
+    if ( socketpair(AF_UNIX, SOCK_STREAM, 0, sv) )
+      return DEVOL_ERR;
+
+    fflush(stdout);
+    pid = fork();
+    if ( pid < 0 ){
+      close(sv[0]);
+      close(sv[1]);
+      return DEVOL_ERR;
+    }
+
+    if ( pid == 0 ){
+      /* Only our own end of our own socket; the other servers' sockets
+       * would keep them from ever seeing the engine hang up. */
+      close(sv[0]);
+      for ( j = 0; j < queue->n_count; j++)
+	close(queue->nodes[j].fd);
+      if ( queue->command ){
+	dup2(sv[1], 0);
+	dup2(sv[1], 1);
+	close(sv[1]);
+	execl("/bin/sh", "sh", "-c", queue->command, (char *)NULL);
+	_exit(127);
+      }
+      _exit(grid_fitness_serve(sv[1], fit) ? 1 : 0);
+    }
+
+    close(sv[1]);
+    if ( _grid_add_server(queue, sv[0], pid) ){
+      close(sv[0]);
+      return DEVOL_ERR;
+    }
+
+  }
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Add the fitness server listening at host:port to the queue.
+ */
+int grid_fitness_connect(struct grid_queue *queue, const char *host,
+			 int port){
+
+  int fd;
+  char service[16];
+  struct sockaddr_in addr;
+  struct addrinfo hints, *res;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  snprintf(service, sizeof(service), "%d", port);
+  if ( getaddrinfo(host, service, &hints, &res) )
+    return DEVOL_ERR;
+  memcpy(&addr, res->ai_addr, sizeof(addr));
+  freeaddrinfo(res);
+
+  fd = _grid_connect(&addr);
+  if ( fd < 0 )
+    return DEVOL_ERR;
+  if ( _grid_add_server(queue, fd, 0) ){
+    close(fd);
+    return DEVOL_ERR;
+  }
+  queue->nodes[queue->n_count - 1].host = addr;
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Hang up on every server and wait for the ones we started.
+ */
+void grid_fitness_stop(struct grid_queue *queue){
+
+  int i;
+
+  for ( i = 0; i < queue->n_count; i++){
+    close(queue->nodes[i].fd);
+    if ( queue->nodes[i].pid )
+      waitpid(queue->nodes[i].pid, NULL, 0);
+    pthread_mutex_destroy(&queue->nodes[i].node_lock);
+  }
+
+  free(queue->nodes);
+  queue->nodes = NULL;
+  queue->n_count = 0;
+
+}
+
+/*
+ * Be a fitness server on fd until the other end hangs up. fit needs the
+ * problem's fitness() and the packing filled in the same way as the engine's
+ * (grid_fitness_init() does this).
+ */
+int grid_fitness_serve(int fd, struct grid_fitness *fit){
+
+  uint32_t i;
+  char *p, *data = NULL;
+  double *out = NULL;
+  void *genome = NULL;
+  size_t have = 0;
+  solution_t sol;
+  struct grid_msg msg;
+  struct grid_eval eval;
+
+  memset(&sol, 0, sizeof(sol));
+  sol.fitness = fit->fitness;
+  if ( fit->unpack && fit->genome_size ){
+    genome = malloc(fit->genome_size);
+    if ( ! genome )
+      return DEVOL_ERR;
+  }
+
+  while ( _grid_read_all(fd, &msg, sizeof(msg)) == DEVOL_OK ){
+
+    if ( msg.type != GRID_MSG_EVAL || msg.length < sizeof(eval) ||
+	 _grid_read_all(fd, &eval, sizeof(eval)) ||
+	 msg.length - sizeof(eval) != eval.count * fit->packed_size )
+      break;
+
+    if ( eval.count * (fit->packed_size + sizeof(double)) > have ){
+      free(data);
+      free(out);
+      have = eval.count * (fit->packed_size + sizeof(double));
+      data = (char *)malloc(have);
+      out = (double *)malloc(have);
+      if ( ! data || ! out )
+	break;
+    }
+    if ( _grid_read_all(fd, data, msg.length - sizeof(eval)) )
+      break;
+
+    for ( i = 0, p = data; i < eval.count; i++, p += fit->packed_size){
+      if ( fit->unpack ){
+	sol.private.ptr = genome;
+	fit->unpack(&sol, p);
+      } else if ( fit->genome_size ){
+	sol.private.ptr = p;
+      } else {
+	memcpy(&sol.private, p, fit->packed_size);
+      }
+      out[i] = sol.fitness(&sol);
+    }
+
+    msg.type = GRID_MSG_FITNESS;
+    msg.length = sizeof(eval) + (eval.count * sizeof(double));
+    if ( _grid_write_all(fd, &msg, sizeof(msg)) ||
+	 _grid_write_all(fd, &eval, sizeof(eval)) ||
+	 _grid_write_all(fd, out, eval.count * sizeof(double)) )
+      break;
+
+  }
+
+  free(data);
+  free(out);
+  free(genome);
+  close(fd);
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Be a fitness server machine: serve everyone who connects to port, each in
+ * a process of its own. Never returns unless the port can't be had.
+ */
+int grid_fitness_listen(int port, struct grid_fitness *fit){
+
+  int fd, lfd, one = 1;
+  pid_t pid;
+  struct sockaddr_in addr;
+
+  lfd = socket(AF_INET, SOCK_STREAM, 0);
+  if ( lfd < 0 )
+    return DEVOL_ERR;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if ( bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) || listen(lfd, 64) ){
+    close(lfd);
+    return DEVOL_ERR;
+  }
+
+  /* Nobody waits for the servers. */
+  signal(SIGCHLD, SIG_IGN);
+
+  for ( ; ; ){
+
+    fd = accept(lfd, NULL, NULL);
+    if ( fd < 0 )
+      continue;
+
+    pid = fork();
+    if ( pid == 0 ){
+      close(lfd);
+      _exit(grid_fitness_serve(fd, fit) ? 1 : 0);
+    }
+    close(fd);
+
+  }
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * What one call has on the go with one server: the batches sent and not yet
+ * answered, oldest first, as (first solution, count).
+ */
+struct _grid_inflight {
+
+  int node;
+  int head;
+  int len;
+  int *first;
+  int *count;
+
+};
+
+static void _grid_pack_solution(struct grid_fitness *fit, solution_t *sol,
+				char *buf){
+
+  if ( fit->pack )
+    fit->pack(sol, buf);
+  else if ( fit->genome_size )
+    memcpy(buf, sol->private.ptr, fit->packed_size);
+  else
+    memcpy(buf, &sol->private, fit->packed_size);
+
+}
+
+static int _grid_send_batch(struct grid_fitness *fit, int fd,
+			    solution_t **solutions, int first, int count,
+			    uint32_t batch, char *buf){
+
+  int i;
+  struct grid_msg *msg = (struct grid_msg *)buf;
+  struct grid_eval *eval = (struct grid_eval *)(msg + 1);
+  char *p = (char *)(eval + 1);
+
+  msg->type = GRID_MSG_EVAL;
+  msg->length = sizeof(struct grid_eval) + (count * fit->packed_size);
+  eval->batch = batch;
+  eval->count = count;
+  for ( i = 0; i < count; i++, p += fit->packed_size)
+    _grid_pack_solution(fit, solutions[first + i], p);
+
+  return _grid_write_all(fd, buf, sizeof(struct grid_msg) + msg->length);
+
+}
+
+static int _grid_recv_batch(int fd, solution_t **solutions, int first,
+			    int count, uint32_t batch, double *buf){
+
+  int i;
+  struct grid_msg msg;
+  struct grid_eval eval;
+
+  if ( _grid_read_all(fd, &msg, sizeof(msg)) ||
+       msg.type != GRID_MSG_FITNESS ||
+       msg.length != sizeof(eval) + (count * sizeof(double)) ||
+       _grid_read_all(fd, &eval, sizeof(eval)) ||
+       eval.batch != batch || eval.count != (uint32_t)count ||
+       _grid_read_all(fd, buf, count * sizeof(double)) )
+    return DEVOL_ERR;
+
+  for ( i = 0; i < count; i++)
+    solutions[first + i]->fitness_val = buf[i];
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * A server is gone: evaluate what it had here.
+ */
+static void _grid_server_down(struct grid_fitness *fit, struct grid_node *node,
+			      struct _grid_inflight *f, solution_t **solutions){
+
+  int i, b;
+
+  node->state = DEVOL_GRID_DOWN;
+  for ( ; f->len; f->len--, f->head++){
+    b = f->head % fit->depth;
+    for ( i = 0; i < f->count[b]; i++)
+      solutions[f->first[b] + i]->fitness_val =
+	fit->fitness(solutions[f->first[b] + i]);
+    __sync_fetch_and_add(&fit->local, f->count[b]);
+  }
+
+}
+
+/*
+ * The batch evaluator for devol_params.evaluate. arg is the struct
+ * grid_fitness.
+ */
+int grid_evaluate(solution_t **solutions, int count, void *arg){
+
+  int i, k, b, n = 0, next = 0, busy = 0;
+  char *out = NULL;
+  double *in = NULL;
+  struct grid_fitness *fit = (struct grid_fitness *)arg;
+  struct grid_queue *queue = fit->queue;
+  struct grid_node *node;
+  struct _grid_inflight *f, *held = NULL;
+  struct pollfd *pfd = NULL;
+  int *slots = NULL;
+
+  if ( ! queue->n_count )
+    return DEVOL_ERR;
+
+  held = (struct _grid_inflight *)
+    malloc(sizeof(struct _grid_inflight) * queue->n_count);
+  pfd = (struct pollfd *)malloc(sizeof(struct pollfd) * queue->n_count);
+  slots = (int *)malloc(sizeof(int) * 2 * fit->depth * queue->n_count);
+  out = (char *)malloc(sizeof(struct grid_msg) + sizeof(struct grid_eval) +
+		       (fit->batch * fit->packed_size));
+  in = (double *)malloc(sizeof(double) * fit->batch);
+  if ( ! held || ! pfd || ! slots || ! out || ! in )
+    goto done;
+
+  /* Take every server nobody else is using, or wait for one if they all
+   * are. */
+  k = __sync_fetch_and_add(&fit->next, 1);
+  for ( i = 0; i < queue->n_count; i++){
+    b = (k + i) % queue->n_count;
+    if ( queue->nodes[b].state != DEVOL_GRID_DOWN &&
+	 pthread_mutex_trylock(&queue->nodes[b].node_lock) == 0 )
+      held[n++].node = b;
+  }
+  for ( i = 0; ! n && i < queue->n_count; i++){
+    b = (k + i) % queue->n_count;
+    if ( queue->nodes[b].state == DEVOL_GRID_DOWN )
+      continue;
+    pthread_mutex_lock(&queue->nodes[b].node_lock);
+    if ( queue->nodes[b].state == DEVOL_GRID_DOWN )
+      pthread_mutex_unlock(&queue->nodes[b].node_lock);
+    else
+      held[n++].node = b;
+  }
+  if ( ! n )
+    goto done;
+
+  for ( i = 0; i < n; i++){
+    held[i].head = 0;
+    held[i].len = 0;
+    held[i].first = &slots[2 * i * fit->depth];
+    held[i].count = &slots[((2 * i) + 1) * fit->depth];
+  }
+
+  do {
+
+    /* Top everyone up. */
+    for ( i = 0; i < n && next < count; i++){
+      f = &held[i];
+      node = &queue->nodes[f->node];
+      while ( node->state != DEVOL_GRID_DOWN && f->len < fit->depth &&
+	      next < count ){
+	b = (f->head + f->len) % fit->depth;
+	f->first[b] = next;
+	f->count[b] = count - next < fit->batch ? count - next : fit->batch;
+	next += f->count[b];
+	f->len++;
+	busy++;
+	if ( _grid_send_batch(fit, node->fd, solutions, f->first[b],
+			      f->count[b], f->head + f->len - 1, out) ){
+	  busy -= f->len;
+	  _grid_server_down(fit, node, f, solutions);
+	}
+	__sync_fetch_and_add(&fit->batches, 1);
+      }
+    }
+
+    if ( ! busy )
+      break;
+
+    /* Then take the answers as they come in. */
+    for ( i = 0; i < n; i++){
+      pfd[i].fd = held[i].len ? queue->nodes[held[i].node].fd : -1;
+      pfd[i].events = POLLIN;
+      pfd[i].revents = 0;
+    }
+    if ( poll(pfd, n, -1) < 0 && errno != EINTR )
+      break;
+
+    for ( i = 0; i < n; i++){
+      f = &held[i];
+      if ( ! f->len || ! pfd[i].revents )
+	continue;
+      node = &queue->nodes[f->node];
+      b = f->head % fit->depth;
+      if ( _grid_recv_batch(node->fd, solutions, f->first[b], f->count[b],
+			    f->head, in) ){
+	busy -= f->len;
+	_grid_server_down(fit, node, f, solutions);
+	continue;
+      }
+      __sync_fetch_and_add(&fit->remote, f->count[b]);
+      f->head++;
+      f->len--;
+      busy--;
+    }
+
+  } while ( busy || next < count );
+
+  /* Only if poll() failed: answers still to come would confuse the next
+   * caller, so give up on those servers. */
+  for ( i = 0; i < n; i++){
+    if ( held[i].len )
+      _grid_server_down(fit, &queue->nodes[held[i].node], &held[i],
+			solutions);
+    pthread_mutex_unlock(&queue->nodes[held[i].node].node_lock);
+  }
+
+ done:
+  free(held);
+  free(pfd);
+  free(slots);
+  free(out);
+  free(in);
+
+  /* Anything not done here gets evaluated by the engine. */
+  return next == count && n ? DEVOL_OK : DEVOL_ERR;
+
+}
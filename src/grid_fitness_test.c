@@ -0,0 +1,225 @@
+/*
+ * Test remote fitness evaluation with local fitness servers. The same
+ * deterministic problem is evolved with fitness() called directly and then
+ * with its evaluations farmed out to 1, 2 and 4 forked servers, with threads,
+ * with servers exec'ed from a command, and with a server killed part way
+ * through. Every run has to end with exactly the same population.
+ *
+ *   ./grid_fitness_test            Run the tests.
+ *   ./grid_fitness_test --serve    Be a fitness server on stdin/stdout.
+ *
+ * The fitness function is a Rastrigin function worked out many times over,
+ * to stand in for something expensive.
+ */
+
+#include <devol.h>
+#include <devol_grid.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+
+#define GENES 8
+#define WORK  50
+
+int    mutate(solution_t *par1, solution_t *par2, solution_t *dest);
+double fitness(solution_t *solution);
+int    init(solution_t *solution);
+
+struct devol_params params = {
+
+  .mutate = mutate,
+  .fitness = fitness,
+  .init = init,
+  .destroy = NULL,
+  .swap = NULL,
+
+  .gene_dispersal_factor = .05,
+  .reproduction_rate = .5,
+  .breed_fitness = .3,
+  .rstate = { 2837, 345, 99 },
+
+  .genome_size = sizeof(double) * GENES,
+  .islands = 4,
+  .deterministic = 1,
+
+};
+
+int solutions = 400;
+int generations = 50;
+
+int mutate(solution_t *par1, solution_t *par2, solution_t *dest){
+
+  int i, cut;
+  double r[GENES];
+  double *a = (double *)par1->private.ptr;
+  double *b = (double *)par2->private.ptr;
+  double *d = (double *)dest->private.ptr;
+
+  cut = devol_rng_u32(&par1->cont->rng) % GENES;
+  devol_rng_fill(&par1->cont->rng, r, GENES);
+  for ( i = 0; i < GENES; i++)
+    d[i] = (i < cut ? a[i] : b[i]) + ((r[i] - .5) * .1);
+
+  return 0;
+
+}
+
+double fitness(solution_t *solution){
+
+  int i, w;
+  double f = 0;
+  volatile double sum;
+  double *g = (double *)solution->private.ptr;
+
+  for ( w = 0; w < WORK; w++){
+    sum = 10 * GENES;
+    for ( i = 0; i < GENES; i++)
+      sum += (g[i] * g[i]) - (10 * cos(2 * M_PI * g[i]));
+    f = sum;
+  }
+
+  return f;
+
+}
+
+int init(solution_t *solution){
+
+  int i;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    g[i] = (devol_rng_uniform(&solution->cont->rng) - .5) * 10.24;
+
+  return 0;
+
+}
+
+/*
+ * Evolve the problem and copy out each solution's fitness and genome. With
+ * servers > 0 the fitnesses come from that many servers; kill says after
+ * how many generations to kill one of them (0 for never).
+ */
+int evolve(int threads, int servers, char *command, int kill_at,
+	   double *out){
+
+  int i, g;
+  uint64_t start;
+  struct gene_pool pool;
+  struct grid_queue queue;
+  struct grid_fitness fit;
+  struct devol_params p = params;
+
+  memset(&queue, 0, sizeof(queue));
+  memset(&fit, 0, sizeof(fit));
+  queue.command = command;
+
+  if ( servers ){
+    fit.batch = 32;
+    fit.depth = 4;
+    grid_fitness_init(&fit, &queue, &p);
+    if ( grid_fitness_spawn(&queue, servers, &fit) )
+      return DEVOL_ERR;
+  }
+
+  start = devol_clock_ns();
+  if ( threads )
+    i = gene_pool_create(&pool, solutions, threads, p);
+  else
+    i = gene_pool_create_seq(&pool, solutions, p);
+  if ( i )
+    return DEVOL_ERR;
+
+  for ( g = 0; g < generations; g++){
+    if ( kill_at && g == kill_at )
+      kill(queue.nodes[0].pid, SIGKILL);
+    if ( threads )
+      gene_pool_iterate(&pool);
+    else
+      gene_pool_iterate_seq(&pool);
+  }
+
+  printf("threads=%d servers=%d%s%s: %.1lf ms", threads, servers,
+	 command ? " (exec)" : "", kill_at ? " (one killed)" : "",
+	 (devol_clock_ns() - start) / 1.0e6);
+  if ( servers )
+    printf(", %llu batches, %llu remote, %llu local",
+	   (unsigned long long)fit.batches, (unsigned long long)fit.remote,
+	   (unsigned long long)fit.local);
+  printf("\n");
+
+  for ( i = 0; i < solutions; i++){
+    out[i * (GENES + 1)] = pool.solutions[i].fitness_val;
+    memcpy(&out[(i * (GENES + 1)) + 1], pool.solutions[i].private.ptr,
+	   sizeof(double) * GENES);
+  }
+
+  if ( servers ){
+    grid_fitness_stop(&queue);
+    if ( ! fit.remote || (kill_at && ! fit.local) )
+      return DEVOL_ERR;
+  }
+
+  return DEVOL_OK;
+
+}
+
+int main(int argc, char **argv){
+
+  int i, fail = 0;
+  double *ref, *got;
+  char command[1024];
+  struct grid_fitness fit;
+  struct grid_queue queue;
+  struct devol_params p = params;
+
+  struct {
+    int threads;
+    int servers;
+    int exec;
+    int kill_at;
+  } runs[] = {
+    { 0, 1, 0, 0 },
+    { 0, 2, 0, 0 },
+    { 0, 4, 0, 0 },
+    { 2, 2, 0, 0 },
+    { 0, 2, 1, 0 },
+    { 0, 2, 0, 10 },
+  };
+
+  if ( argc > 1 && strcmp(argv[1], "--serve") == 0 ){
+    memset(&fit, 0, sizeof(fit));
+    memset(&queue, 0, sizeof(queue));
+    grid_fitness_init(&fit, &queue, &p);
+    return grid_fitness_serve(0, &fit) ? 1 : 0;
+  }
+  snprintf(command, sizeof(command), "exec %s --serve", argv[0]);
+
+  ref = (double *)malloc(sizeof(double) * solutions * (GENES + 1));
+  got = (double *)malloc(sizeof(double) * solutions * (GENES + 1));
+  if ( ! ref || ! got || evolve(0, 0, NULL, 0, ref) ){
+    printf("FAIL: unable to run the problem locally.\n");
+    return 1;
+  }
+
+  for ( i = 0; i < (int)(sizeof(runs) / sizeof(runs[0])); i++){
+    if ( evolve(runs[i].threads, runs[i].servers,
+		runs[i].exec ? command : NULL, runs[i].kill_at, got) ){
+      printf("FAIL: the servers were not used as they should have been.\n");
+      fail = 1;
+    } else if ( memcmp(ref, got,
+		       sizeof(double) * solutions * (GENES + 1)) ){
+      printf("FAIL: the population differs from the local run.\n");
+      fail = 1;
+    }
+  }
+
+  if ( ! fail )
+    printf("PASS\n");
+
+  return fail;
+
+}
@@ -0,0 +1,287 @@
+/*
+ * Test the grid island model on one machine and see how it scales. With no
+ * arguments this forks a ring of 1, 2 and 4 node processes (or up to -n
+ * nodes), each evolving its own gene pool and swapping migrants with its
+ * neighbours over TCP on localhost, with this process as the coordinator. It
+ * checks that every node finished and that migrants made it all the way
+ * round, and prints each node's stats and the total evaluations per second
+ * for each ring size.
+ *
+ * The nodes can also be run by hand, on one machine or several:
+ *
+ *   ./grid_test -c <nodes> [-p port]     Coordinate nodes nodes.
+ *   ./grid_test -j <host:port>           Join the coordinator at host:port.
+ *
+ * The problem is a Rastrigin function in a few dimensions with its genome in
+ * an engine arena, so it is the genome that travels.
+ */
+
+#include <devol.h>
+#include <devol_grid.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define GENES 8
+
+int    mutate(solution_t *par1, solution_t *par2, solution_t *dest);
+double fitness(solution_t *solution);
+int    init(solution_t *solution);
+
+struct devol_params params = {
+
+  .mutate = mutate,
+  .fitness = fitness,
+  .init = init,
+  .destroy = NULL,
+  .swap = NULL,
+
+  .gene_dispersal_factor = .05,
+  .reproduction_rate = .5,
+  .breed_fitness = .3,
+  .rstate = { 2837, 345, 99 },
+
+  .genome_size = sizeof(double) * GENES,
+  .islands = 4,
+  .hall_of_fame = 1,
+
+};
+
+struct grid_params grid = {
+
+  .migrants = 4,
+  .interval = 5,
+
+};
+
+int solutions = 400;
+int generations = 300;
+
+int mutate(solution_t *par1, solution_t *par2, solution_t *dest){
+
+  int i, cut;
+  double r[GENES];
+  double *a = (double *)par1->private.ptr;
+  double *b = (double *)par2->private.ptr;
+  double *d = (double *)dest->private.ptr;
+
+  cut = devol_rng_u32(&par1->cont->rng) % GENES;
+  devol_rng_fill(&par1->cont->rng, r, GENES);
+  for ( i = 0; i < GENES; i++)
+    d[i] = (i < cut ? a[i] : b[i]) + ((r[i] - .5) * .1);
+
+  return 0;
+
+}
+
+double fitness(solution_t *solution){
+
+  int i;
+  double f = 10 * GENES;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    f += (g[i] * g[i]) - (10 * cos(2 * M_PI * g[i]));
+
+  return f;
+
+}
+
+int init(solution_t *solution){
+
+  int i;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    g[i] = (devol_rng_uniform(&solution->cont->rng) - .5) * 10.24;
+
+  return 0;
+
+}
+
+/*
+ * Be one node: evolve a gene pool for a while, migrating as we go.
+ */
+int node(const char *host, int port, int seed){
+
+  int g;
+  struct gene_pool pool;
+  struct grid_peer peer;
+  struct devol_params p = params;
+
+  /* Every node should start somewhere different. The nodes run the
+   * sequential algorithm: the point here is one process per core, and the
+   * worker threads spin while they wait for each other. */
+  p.rstate[2] += seed;
+  if ( gene_pool_create_seq(&pool, solutions, p) )
+    return DEVOL_ERR;
+
+  if ( grid_join(&peer, &pool, &grid, host, port) ){
+    fprintf(stderr, "Unable to join the grid at %s:%d.\n", host, port);
+    return DEVOL_ERR;
+  }
+
+  for ( g = 0; g < generations; g++){
+    gene_pool_iterate_seq(&pool);
+    grid_migrate(&peer);
+  }
+
+  return grid_leave(&peer);
+
+}
+
+/*
+ * Fork nodes nodes on localhost and coordinate them. Fills in stats and
+ * returns the wall time in ns, or 0 if anything went wrong.
+ */
+uint64_t ring(int nodes, struct grid_stats *stats){
+
+  int i, port, status, err = 0;
+  pid_t pid;
+  uint64_t start;
+  struct grid_queue queue;
+
+  memset(&queue, 0, sizeof(queue));
+  port = grid_listen(&queue, 0);
+  if ( port < 0 )
+    return 0;
+
+  fflush(stdout);
+  start = devol_clock_ns();
+  for ( i = 0; i < nodes; i++){
+    pid = fork();
+    if ( pid < 0 )
+      return 0;
+    if ( pid == 0 ){
+      close(queue.fd);
+      _exit(node("127.0.0.1", port, i) ? 1 : 0);
+    }
+  }
+
+  if ( grid_coordinate(&queue, nodes, stats) )
+    err = 1;
+  for ( i = 0; i < nodes; i++){
+    if ( wait(&status) < 0 || ! WIFEXITED(status) || WEXITSTATUS(status) )
+      err = 1;
+  }
+  free(queue.nodes);
+
+  return err ? 0 : devol_clock_ns() - start;
+
+}
+
+int scaling(int max_nodes){
+
+  int i, n, fail = 0;
+  uint64_t ns, evals;
+  double rate, base = 0;
+  struct grid_stats *stats;
+
+  stats = (struct grid_stats *)malloc(sizeof(struct grid_stats) * max_nodes);
+  if ( ! stats )
+    return 1;
+
+  printf("# %d solutions per node, %d generations, %d migrants every %d"
+	 " generations; %ld CPUs\n", solutions, generations, grid.migrants,
+	 grid.interval, sysconf(_SC_NPROCESSORS_ONLN));
+
+  for ( n = 1; ; n = n * 2 < max_nodes ? n * 2 : max_nodes){
+
+    ns = ring(n, stats);
+    if ( ! ns ){
+      printf("FAIL: a ring of %d nodes did not finish.\n", n);
+      fail = 1;
+      break;
+    }
+
+    grid_print_stats(stats, n, stdout);
+
+    /* Every node has to have heard from its neighbour. */
+    evals = 0;
+    for ( i = 0; i < n; i++){
+      evals += stats[i].evaluations;
+      if ( stats[i].generations != (uint32_t)generations ||
+	   ! stats[i].sent || ! stats[i].received ){
+	printf("FAIL: node %d of %d did not migrate.\n", i, n);
+	fail = 1;
+      }
+    }
+
+    rate = evals * 1.0e9 / ns;
+    if ( n == 1 )
+      base = rate;
+    printf("nodes=%d wall=%.1lf ms evaluations/s=%.0lf speedup=%.2lf\n\n",
+	   n, ns / 1.0e6, rate, rate / base);
+
+    if ( n == max_nodes )
+      break;
+
+  }
+
+  free(stats);
+  if ( ! fail )
+    printf("PASS\n");
+
+  return fail;
+
+}
+
+int main(int argc, char **argv){
+
+  int opt, port = 0, nodes = 0, max_nodes = 4;
+  char *join = NULL, *colon;
+  struct grid_queue queue;
+  struct grid_stats *stats;
+
+  while ( (opt = getopt(argc, argv, "n:c:p:j:")) != -1 ){
+    switch ( opt ){
+    case 'n':
+      max_nodes = atoi(optarg);
+      break;
+    case 'c':
+      nodes = atoi(optarg);
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'j':
+      join = optarg;
+      break;
+    default:
+      fprintf(stderr, "Usage: grid_test [-n nodes] | -c nodes [-p port] | "
+	      "-j host:port\n");
+      return 1;
+    }
+  }
+
+  if ( join ){
+    colon = strrchr(join, ':');
+    if ( ! colon ){
+      fprintf(stderr, "Join the coordinator at host:port.\n");
+      return 1;
+    }
+    *colon = 0;
+    return node(join, atoi(colon + 1), getpid()) ? 1 : 0;
+  }
+
+  if ( nodes > 0 ){
+    port = grid_listen(&queue, port);
+    stats = (struct grid_stats *)malloc(sizeof(struct grid_stats) * nodes);
+    if ( port < 0 || ! stats ){
+      fprintf(stderr, "Unable to listen.\n");
+      return 1;
+    }
+    printf("# Waiting for %d nodes on port %d.\n", nodes, port);
+    fflush(stdout);
+    opt = grid_coordinate(&queue, nodes, stats);
+    grid_print_stats(stats, nodes, stdout);
+    return opt ? 1 : 0;
+  }
+
+  return max_nodes > 0 ? scaling(max_nodes) : 1;
+
+}
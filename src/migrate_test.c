@@ -0,0 +1,247 @@
+/*
+ * Test out topology migration with a genome that keeps a pointer into
+ * itself. Migration and the hall of fame copy genomes from slot to slot, so
+ * without devol_params.copy() the copies would point back into the slots
+ * they came from (another island's, maybe on another thread). With copy()
+ * every genome has to point into its own slot after every generation: the
+ * sequential algorithm, threads and worker processes alike. The same run
+ * without copy() has to be caught out, or the check is worth nothing.
+ *
+ * Then the adaptive interval: with migration_diversity set the interval has
+ * to come down while the islands are apart and go back up once migration
+ * has brought them together, and it must never move if the threshold is out
+ * of reach.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define GENES 4
+
+struct genome {
+  double *genes;	/* Points at data, in the same slot. */
+  double  data[GENES];
+};
+
+int    mutate(solution_t *par1, solution_t *par2, solution_t *dest);
+double fitness(solution_t *solution);
+int    init(solution_t *solution);
+void   copy(void *dest, const void *src);
+
+struct devol_params params = {
+
+  .mutate = mutate,
+  .fitness = fitness,
+  .init = init,
+  .copy = copy,
+
+  .gene_dispersal_factor = .05,
+  .reproduction_rate = .5,
+  .breed_fitness = .3,
+  .rstate = { 2837, 345, 99 },
+
+  .genome_size = sizeof(struct genome),
+  .islands = 6,
+  .hall_of_fame = 8,
+
+  .migration = DEVOL_MIGRATE_TORUS,
+  .migrants = 2,
+  .migration_interval = 1,
+
+};
+
+int solutions = 300;
+int generations = 50;
+
+int mutate(solution_t *par1, solution_t *par2, solution_t *dest){
+
+  int i, cut;
+  double r[GENES];
+  struct genome *a = (struct genome *)par1->private.ptr;
+  struct genome *b = (struct genome *)par2->private.ptr;
+  struct genome *d = (struct genome *)dest->private.ptr;
+
+  cut = devol_rng_u32(&par1->cont->rng) % GENES;
+  devol_rng_fill(&par1->cont->rng, r, GENES);
+  for ( i = 0; i < GENES; i++)
+    d->genes[i] = (i < cut ? a->genes[i] : b->genes[i]) + ((r[i] - .5) * .01);
+
+  return 0;
+
+}
+
+double fitness(solution_t *solution){
+
+  int i;
+  double f = 0;
+  struct genome *g = (struct genome *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    f += fabs((g->genes[i] * g->genes[i]) - 5);
+
+  return f;
+
+}
+
+int init(solution_t *solution){
+
+  int i;
+  struct genome *g = (struct genome *)solution->private.ptr;
+
+  g->genes = g->data;
+  for ( i = 0; i < GENES; i++)
+    g->genes[i] = devol_rng_uniform(&solution->cont->rng) * 10.0;
+
+  return 0;
+
+}
+
+void copy(void *dest, const void *src){
+
+  struct genome *d = (struct genome *)dest;
+
+  memcpy(d, src, sizeof(struct genome));
+  d->genes = d->data;
+
+}
+
+/*
+ * How many genomes, in the population and the hall of fame, point somewhere
+ * other than into themselves.
+ */
+int strays(struct gene_pool *pool){
+
+  int i, len, n = 0;
+  struct genome *g;
+  solution_t *hof;
+
+  for ( i = 0; i < pool->solution_count; i++){
+    g = (struct genome *)pool->solutions[i].private.ptr;
+    if ( g->genes != g->data )
+      n++;
+  }
+
+  hof = gene_pool_hall_of_fame(pool, &len);
+  for ( i = 0; i < len; i++){
+    g = (struct genome *)hof[i].private.ptr;
+    if ( g->genes != g->data )
+      n++;
+  }
+
+  return n;
+
+}
+
+/*
+ * Evolve with threads threads (0 for the sequential algorithm) or processes
+ * worker processes and return how many strays there were over the run, or
+ * -1 if the gene pool could not be made.
+ */
+int evolve(int threads, int processes){
+
+  int g, n = 0;
+  struct gene_pool pool;
+
+  if ( processes )
+    g = gene_pool_create_mp(&pool, solutions, processes, params);
+  else if ( threads )
+    g = gene_pool_create(&pool, solutions, threads, params);
+  else
+    g = gene_pool_create_seq(&pool, solutions, params);
+  if ( g )
+    return -1;
+
+  for ( g = 0; g < generations; g++){
+    if ( threads || processes )
+      gene_pool_iterate(&pool);
+    else
+      gene_pool_iterate_seq(&pool);
+    n += strays(&pool);
+  }
+
+  gene_pool_destroy(&pool);
+
+  return n;
+
+}
+
+/*
+ * Evolve sequentially with an interval of up to 8 that adapts to the islands'
+ * diversity and count how many times the interval went down and how many
+ * times it went back up afterwards.
+ */
+int adapt(double diversity, int *shrank, int *grew){
+
+  int g, last;
+  struct gene_pool pool;
+  struct devol_params p = params;
+
+  p.migration_interval = 8;
+  p.migration_diversity = diversity;
+  if ( gene_pool_create_seq(&pool, solutions, p) )
+    return DEVOL_ERR;
+
+  *shrank = *grew = 0;
+  last = pool.migrate_interval;
+  for ( g = 0; g < 2 * generations; g++){
+    gene_pool_iterate_seq(&pool);
+    if ( pool.migrate_interval < last )
+      (*shrank)++;
+    else if ( pool.migrate_interval > last && *shrank )
+      (*grew)++;
+    last = pool.migrate_interval;
+  }
+
+  gene_pool_destroy(&pool);
+
+  return DEVOL_OK;
+
+}
+
+int main(int argc, char **argv){
+
+  int n, shrank, grew, failed = 0;
+
+  n = evolve(0, 0);
+  printf("sequential: %d strays\n", n);
+  failed |= n != 0;
+
+  n = evolve(3, 0);
+  printf("3 threads: %d strays\n", n);
+  failed |= n != 0;
+
+  n = evolve(0, 3);
+  printf("3 processes: %d strays\n", n);
+  failed |= n != 0;
+
+  /* Byte for byte copies leave the migrants pointing into their outboxes. */
+  params.copy = NULL;
+  n = evolve(0, 0);
+  printf("sequential without copy(): %d strays\n", n);
+  failed |= n <= 0;
+
+  params.copy = copy;
+  if ( adapt(.2, &shrank, &grew) ){
+    printf("Unable to make a gene pool.\n");
+    return 1;
+  }
+  printf("adaptive interval: shrank %d times, grew back %d times\n",
+	 shrank, grew);
+  failed |= ! shrank || ! grew;
+
+  if ( adapt(1, &shrank, &grew) ){
+    printf("Unable to make a gene pool.\n");
+    return 1;
+  }
+  printf("out of reach: shrank %d times\n", shrank);
+  failed |= shrank != 0;
+
+  printf("%s\n", failed ? "FAIL" : "PASS");
+
+  return failed;
+
+}
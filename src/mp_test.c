@@ -0,0 +1,235 @@
+/*
+ * Test the multi process gene pool. The same deterministic problem is evolved
+ * with the sequential algorithm and with 1, 2 and 3 worker processes, and the
+ * final populations, fitness statistics and halls of fame have to be bitwise
+ * identical. Then a worker is killed part way through a run and the gene pool
+ * has to notice and fail instead of waiting on it forever.
+ *
+ * The fitness function works in a static scratch buffer, the way plenty of
+ * old numerical code does, so it could not be used with threads.
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define GENES 4
+
+int    mutate(solution_t *par1, solution_t *par2, solution_t *dest);
+double fitness(solution_t *solution);
+int    init(solution_t *solution);
+
+struct devol_params params = {
+
+  .mutate = mutate,
+  .fitness = fitness,
+  .init = init,
+  .destroy = NULL,
+  .swap = NULL,
+
+  .gene_dispersal_factor = .05,
+  .reproduction_rate = .5,
+  .breed_fitness = .3,
+  .rstate = { 2837, 345, 99 },
+
+  .genome_size = sizeof(double) * GENES,
+  .islands = 6,
+  .deterministic = 1,
+  .hall_of_fame = 4,
+
+};
+
+int solutions = 600;
+int generations = 100;
+
+/* Process counts to try; 0 is the sequential algorithm. */
+int runs[] = { 0, 1, 2, 3 };
+
+/* If set, a worker kills itself after this many evaluations. */
+int   crash_after = 0;
+pid_t parent;
+
+int mutate(solution_t *par1, solution_t *par2, solution_t *dest){
+
+  int i, cut;
+  double r[GENES];
+  double *a = (double *)par1->private.ptr;
+  double *b = (double *)par2->private.ptr;
+  double *d = (double *)dest->private.ptr;
+
+  cut = devol_rng_u32(&par1->cont->rng) % GENES;
+  devol_rng_fill(&par1->cont->rng, r, GENES);
+  for ( i = 0; i < GENES; i++)
+    d[i] = (i < cut ? a[i] : b[i]) + ((r[i] - .5) * .01);
+
+  return 0;
+
+}
+
+double fitness(solution_t *solution){
+
+  int i;
+  static int calls = 0;
+  static double scratch[GENES];
+  double f = 0;
+
+  if ( crash_after && getpid() != parent && ++calls == crash_after )
+    kill(getpid(), SIGKILL);
+
+  memcpy(scratch, solution->private.ptr, sizeof(scratch));
+  for ( i = 0; i < GENES; i++){
+    scratch[i] = (scratch[i] * scratch[i]) - 5;
+    f += fabs(scratch[i]);
+  }
+
+  return f;
+
+}
+
+int init(solution_t *solution){
+
+  int i;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    g[i] = devol_rng_uniform(&solution->cont->rng) * 10.0;
+
+  return 0;
+
+}
+
+/* The fitness statistics and the hall of fame get compared too. */
+#define EXTRA (5 + (4 * (GENES + 1)))
+
+int evolve(int processes, double *out){
+
+  int i, g, len;
+  struct gene_pool pool;
+  struct devol_fitness fit;
+  solution_t *hof;
+
+  if ( processes )
+    i = gene_pool_create_mp(&pool, solutions, processes, params);
+  else
+    i = gene_pool_create_seq(&pool, solutions, params);
+  if ( i )
+    return DEVOL_ERR;
+
+  for ( g = 0; g < generations; g++){
+    if ( processes )
+      i = gene_pool_iterate(&pool);
+    else
+      i = gene_pool_iterate_seq(&pool);
+    if ( i )
+      return DEVOL_ERR;
+  }
+
+  for ( i = 0; i < solutions; i++){
+    out[i * (GENES + 1)] = pool.solutions[i].fitness_val;
+    memcpy(&out[(i * (GENES + 1)) + 1], pool.solutions[i].private.ptr,
+	   sizeof(double) * GENES);
+  }
+
+  out += solutions * (GENES + 1);
+  memset(out, 0, sizeof(double) * EXTRA);
+  gene_pool_get_fitness(&pool, &fit);
+  out[0] = fit.mean;
+  out[1] = fit.variance;
+  out[2] = fit.min;
+  out[3] = fit.max;
+  out[4] = gene_pool_best_fitness(&pool);
+  hof = gene_pool_hall_of_fame(&pool, &len);
+  for ( i = 0; i < len; i++){
+    out[5 + (i * (GENES + 1))] = hof[i].fitness_val;
+    memcpy(&out[6 + (i * (GENES + 1))], hof[i].private.ptr,
+	   sizeof(double) * GENES);
+  }
+
+  if ( processes )
+    gene_pool_destroy_mp(&pool);
+
+  return DEVOL_OK;
+
+}
+
+/*
+ * Kill a worker and make sure the gene pool gives up on it promptly.
+ */
+int crash(void){
+
+  int g;
+  uint64_t start;
+  struct gene_pool pool;
+
+  parent = getpid();
+  crash_after = solutions;
+  if ( gene_pool_create_mp(&pool, solutions, 3, params) )
+    return DEVOL_ERR;
+
+  start = devol_clock_ns();
+  for ( g = 0; g < generations; g++){
+    if ( gene_pool_iterate(&pool) )
+      break;
+  }
+
+  if ( g == generations || gene_pool_iterate(&pool) == DEVOL_OK ){
+    printf("killed worker: not noticed\n");
+    return DEVOL_ERR;
+  }
+  printf("killed worker: noticed in generation %d after %.1lf ms\n", g,
+	 (devol_clock_ns() - start) / 1.0e6);
+
+  gene_pool_destroy_mp(&pool);
+  crash_after = 0;
+
+  return DEVOL_OK;
+
+}
+
+int main(int argc, char **argv){
+
+  int r;
+  int failed = 0;
+  size_t len = sizeof(double) * ((solutions * (GENES + 1)) + EXTRA);
+  double *ref = (double *)malloc(len);
+  double *pop = (double *)malloc(len);
+
+  printf("solutions=%d islands=%d generations=%d\n",
+	 solutions, params.islands, generations);
+
+  for ( r = 0; r < sizeof(runs) / sizeof(runs[0]); r++){
+
+    if ( evolve(runs[r], r ? pop : ref) ){
+      printf("%d processes: unable to run the problem\n", runs[r]);
+      failed = 1;
+      continue;
+    }
+    if ( r == 0 ){
+      printf("sequential: best fitness %lf, mean %lf\n",
+	     ref[solutions * (GENES + 1) + 4], ref[solutions * (GENES + 1)]);
+      continue;
+    }
+
+    if ( memcmp(ref, pop, len) ){
+      printf("%d processes: population differs from the sequential run\n",
+	     runs[r]);
+      failed = 1;
+    } else {
+      printf("%d processes: identical\n", runs[r]);
+    }
+
+  }
+
+  if ( crash() )
+    failed = 1;
+
+  printf("%s\n", failed ? "FAIL" : "PASS");
+
+  return failed;
+
+}
@@ -0,0 +1,100 @@
+/*
+ * Hammer the lock free queue with a few producer and consumer threads and make
+ * sure every value comes out exactly once, and that each producer's values
+ * come out in the order they went in. The queue is kept small so it spends
+ * plenty of time full and empty.
+ */
+
+#include <devol.h>
+
+#include <stdio.h>
+#include <sched.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define PRODUCERS  3
+#define CONSUMERS  3
+#define VALUES     200000   /* Per producer. */
+
+struct devol_queue queue;
+volatile int producing = PRODUCERS;
+
+/* How many times each value was seen, and the last value each consumer saw
+ * from each producer. */
+unsigned char seen[PRODUCERS * VALUES];
+int out_of_order = 0;
+
+void *produce(void *arg){
+
+  int i, p = (int)(long)arg;
+
+  for ( i = 0; i < VALUES; i++){
+    while ( devol_queue_push(&queue, (p * VALUES) + i) )
+      sched_yield();
+  }
+  __sync_fetch_and_sub(&producing, 1);
+
+  return NULL;
+
+}
+
+void *consume(void *arg){
+
+  int p, value, done;
+  int last[PRODUCERS];
+
+  for ( p = 0; p < PRODUCERS; p++)
+    last[p] = -1;
+
+  for ( ; ; ){
+    done = producing == 0;
+    __sync_synchronize();
+    if ( devol_queue_pop(&queue, &value) ){
+      if ( done )
+	break;
+      sched_yield();
+      continue;
+    }
+    __sync_fetch_and_add(&seen[value], 1);
+    p = value / VALUES;
+    if ( value <= last[p] )
+      __sync_fetch_and_add(&out_of_order, 1);
+    last[p] = value;
+  }
+
+  return NULL;
+
+}
+
+int main(){
+
+  int i, bad = 0;
+  pthread_t threads[PRODUCERS + CONSUMERS];
+
+  if ( devol_queue_init(&queue, 64) ){
+    printf("Unable to make the queue.\n");
+    return 1;
+  }
+
+  for ( i = 0; i < CONSUMERS; i++)
+    pthread_create(&threads[i], NULL, consume, NULL);
+  for ( i = 0; i < PRODUCERS; i++)
+    pthread_create(&threads[CONSUMERS + i], NULL, produce, (void *)(long)i);
+  for ( i = 0; i < PRODUCERS + CONSUMERS; i++)
+    pthread_join(threads[i], NULL);
+
+  for ( i = 0; i < PRODUCERS * VALUES; i++){
+    if ( seen[i] != 1 )
+      bad++;
+  }
+
+  printf("%d values through %d producers and %d consumers: %d lost or "
+	 "doubled, %d out of order\n", PRODUCERS * VALUES, PRODUCERS,
+	 CONSUMERS, bad, out_of_order);
+  printf("%s\n", bad || out_of_order ? "FAIL" : "PASS");
+
+  devol_queue_destroy(&queue);
+
+  return bad || out_of_order;
+
+}
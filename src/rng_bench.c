@@ -0,0 +1,97 @@
+/*
+ * Measure how many random numbers per second each of the generators can make.
+ * Compares the raw glibc erand48_r() the engine used to call for every draw
+ * against both devol_rng generators, one draw at a time and in bulk.
+ *
+ * Usage:
+ *
+ *   ./rng_bench [draws]
+ */
+
+#include <devol.h>
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILL_LEN 1024
+
+unsigned short seed[3] = {7, 20, 1969};
+
+double now(){
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + (ts.tv_nsec / 1.0e9);
+
+}
+
+void report(char *name, long draws, double secs, double sum){
+
+  /* The sum is printed so the compiler cannot throw the draws away. */
+  printf("  %-22s %10.2lf Mdraws/s   (mean %.4lf)\n", name,
+	 (draws / secs) / 1.0e6, sum / draws);
+
+}
+
+int main(int argc, char **argv){
+
+  long i, draws = 50000000;
+  int  type, j;
+  double d, sum, t_start;
+  double buf[FILL_LEN];
+  unsigned short rstate[3];
+  rdata_t rdata;
+  struct devol_rng rng;
+  char *names[] = { "philox", "rand48" };
+  char label[64];
+
+  if ( argc > 1 )
+    draws = atol(argv[1]);
+  draws -= draws % FILL_LEN;
+
+  printf("# %ld uniform doubles per generator\n", draws);
+
+  /* What the engine used to do. */
+  rstate[0] = seed[0];
+  rstate[1] = seed[1];
+  rstate[2] = seed[2];
+  memset(&rdata, 0, sizeof(rdata));
+  sum = 0;
+  t_start = now();
+  for ( i = 0; i < draws; i++){
+    devol_rand48(rstate, &rdata, &d);
+    sum += d;
+  }
+  report("erand48_r", draws, now() - t_start, sum);
+
+  for ( type = DEVOL_RNG_PHILOX; type <= DEVOL_RNG_RAND48; type++){
+
+    /* One at a time. */
+    devol_rng_init(&rng, type, seed, 0);
+    sum = 0;
+    t_start = now();
+    for ( i = 0; i < draws; i++)
+      sum += devol_rng_uniform(&rng);
+    snprintf(label, sizeof(label), "%s uniform", names[type]);
+    report(label, draws, now() - t_start, sum);
+
+    /* In bulk. */
+    devol_rng_init(&rng, type, seed, 0);
+    sum = 0;
+    t_start = now();
+    for ( i = 0; i < draws; i += FILL_LEN){
+      devol_rng_fill(&rng, buf, FILL_LEN);
+      for ( j = 0; j < FILL_LEN; j++)
+	sum += buf[j];
+    }
+    snprintf(label, sizeof(label), "%s fill", names[type]);
+    report(label, draws, now() - t_start, sum);
+
+  }
+
+  return 0;
+
+}
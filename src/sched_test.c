@@ -0,0 +1,258 @@
+/*
+ * Test the scheduler. A bunch of small jobs share two threads and each has to
+ * end up exactly where it would have running on its own. Then, with a single
+ * thread so the order is fixed, jobs with weights 3 and 1 have to get
+ * generations in that ratio and a high priority job has to run ahead of a low
+ * priority one. Every gene pool is torn down with gene_pool_destroy().
+ */
+
+#include <devol.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define GENES 4
+#define JOBS  6
+
+int    mutate(solution_t *par1, solution_t *par2, solution_t *dest);
+double fitness(solution_t *solution);
+int    init(solution_t *solution);
+
+struct devol_params params = {
+
+  .mutate = mutate,
+  .fitness = fitness,
+  .init = init,
+  .destroy = NULL,
+  .swap = NULL,
+
+  .gene_dispersal_factor = .05,
+  .reproduction_rate = .5,
+  .breed_fitness = .3,
+  .rstate = { 2837, 345, 99 },
+
+  .genome_size = sizeof(double) * GENES,
+  .islands = 2,
+  .deterministic = 1,
+
+};
+
+int solutions = 200;
+int generations = 60;
+
+int mutate(solution_t *par1, solution_t *par2, solution_t *dest){
+
+  int i, cut;
+  double r[GENES];
+  double *a = (double *)par1->private.ptr;
+  double *b = (double *)par2->private.ptr;
+  double *d = (double *)dest->private.ptr;
+
+  cut = devol_rng_u32(&par1->cont->rng) % GENES;
+  devol_rng_fill(&par1->cont->rng, r, GENES);
+  for ( i = 0; i < GENES; i++)
+    d[i] = (i < cut ? a[i] : b[i]) + ((r[i] - .5) * .01);
+
+  return 0;
+
+}
+
+double fitness(solution_t *solution){
+
+  int i;
+  double f = 0;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    f += fabs((g[i] * g[i]) - 5);
+
+  return f;
+
+}
+
+int init(solution_t *solution){
+
+  int i;
+  double *g = (double *)solution->private.ptr;
+
+  for ( i = 0; i < GENES; i++)
+    g[i] = devol_rng_uniform(&solution->cont->rng) * 10.0;
+
+  return 0;
+
+}
+
+/* Make job n's gene pool; each job gets its own seed. */
+int make_pool(struct gene_pool *pool, int n){
+
+  struct devol_params p = params;
+
+  p.rstate[2] += n;
+  return gene_pool_create_seq(pool, solutions, p);
+
+}
+
+void copy_out(struct gene_pool *pool, double *out){
+
+  int i;
+
+  for ( i = 0; i < solutions; i++){
+    out[i * (GENES + 1)] = pool->solutions[i].fitness_val;
+    memcpy(&out[(i * (GENES + 1)) + 1], pool->solutions[i].private.ptr,
+	   sizeof(double) * GENES);
+  }
+
+}
+
+/*
+ * Run JOBS jobs on two threads and compare them to running alone.
+ */
+int shared(void){
+
+  int i, g, fail = 0;
+  size_t len = sizeof(double) * solutions * (GENES + 1);
+  double *ref = (double *)malloc(len);
+  double *got = (double *)malloc(len);
+  struct gene_pool alone;
+  struct gene_pool pools[JOBS];
+  struct devol_job jobs[JOBS];
+  struct devol_sched *sched;
+
+  sched = devol_sched_create(2);
+  if ( ! sched )
+    return 1;
+
+  memset(jobs, 0, sizeof(jobs));
+  for ( i = 0; i < JOBS; i++){
+    if ( make_pool(&pools[i], i) )
+      return 1;
+    jobs[i].pool = &pools[i];
+    jobs[i].generations = generations;
+    jobs[i].weight = 1 + (i % 3);
+    devol_sched_add(sched, &jobs[i]);
+  }
+
+  devol_sched_wait_all(sched);
+  devol_sched_print(sched, stdout);
+
+  for ( i = 0; i < JOBS; i++){
+
+    if ( make_pool(&alone, i) )
+      return 1;
+    for ( g = 0; g < generations; g++)
+      gene_pool_iterate_seq(&alone);
+    copy_out(&alone, ref);
+    copy_out(&pools[i], got);
+    gene_pool_destroy(&alone);
+    gene_pool_destroy(&pools[i]);
+
+    if ( jobs[i].ran != generations || memcmp(ref, got, len) ){
+      printf("job %d: differs from running alone\n", i);
+      fail = 1;
+    }
+
+  }
+
+  devol_sched_destroy(sched);
+  free(ref);
+  free(got);
+  if ( ! fail )
+    printf("shared threads: every job identical to running alone\n");
+
+  return fail;
+
+}
+
+/*
+ * Weights and priorities on one thread. A short job of a higher priority
+ * goes in first to keep the thread busy while the others are added, so they
+ * are all waiting when it picks the next one and the order is fixed.
+ */
+int fairness(void){
+
+  int i, fail = 0;
+  double gen;
+  struct gene_pool pools[3];
+  struct devol_job jobs[3];
+  struct devol_sched *sched;
+
+  for ( i = 0; i < 3; i++){
+    if ( make_pool(&pools[i], i) )
+      return 1;
+  }
+
+  /* Weights 3 and 1: the heavy job runs three generations for every one the
+   * light one runs, so with 300 and 100 to do they finish together. Had the
+   * weights been ignored the light one would be done halfway through. */
+  memset(jobs, 0, sizeof(jobs));
+  jobs[0].name = "first";
+  jobs[0].priority = 1;
+  jobs[1].name = "heavy";
+  jobs[1].generations = 300;
+  jobs[1].weight = 3;
+  jobs[2].name = "light";
+  jobs[2].generations = 100;
+  jobs[2].weight = 1;
+  for ( i = 0; i < 3; i++){
+    jobs[i].pool = &pools[i];
+    if ( ! jobs[i].generations )
+      jobs[i].generations = 20;
+  }
+
+  sched = devol_sched_create(1);
+  for ( i = 0; i < 3; i++)
+    devol_sched_add(sched, &jobs[i]);
+  devol_sched_wait_all(sched);
+  devol_sched_print(sched, stdout);
+  devol_sched_destroy(sched);
+
+  gen = (double)(jobs[1].busy + jobs[2].busy) / 400;
+  printf("weights 3:1: light finished %.1lf generations from heavy\n",
+	 ((double)jobs[2].finished - (double)jobs[1].finished) / gen);
+  if ( fabs((double)jobs[2].finished - (double)jobs[1].finished) > 5 * gen )
+    fail = 1;
+
+  /* Priority: the high priority job, added last, has to be finished before
+   * the low one starts. */
+  memset(jobs, 0, sizeof(jobs));
+  jobs[0].name = "first";
+  jobs[0].priority = 2;
+  jobs[1].name = "low";
+  jobs[2].name = "high";
+  jobs[2].priority = 1;
+  for ( i = 0; i < 3; i++){
+    jobs[i].pool = &pools[i];
+    jobs[i].generations = 20;
+  }
+
+  sched = devol_sched_create(1);
+  for ( i = 0; i < 3; i++)
+    devol_sched_add(sched, &jobs[i]);
+  devol_sched_wait_all(sched);
+  devol_sched_destroy(sched);
+
+  printf("priority: high %s before low started\n",
+	 jobs[2].finished <= jobs[1].started ? "finished" : "not finished");
+  if ( jobs[2].finished > jobs[1].started )
+    fail = 1;
+
+  for ( i = 0; i < 3; i++)
+    gene_pool_destroy(&pools[i]);
+
+  return fail;
+
+}
+
+int main(int argc, char **argv){
+
+  int fail;
+
+  fail = shared();
+  fail |= fairness();
+  printf("%s\n", fail ? "FAIL" : "PASS");
+
+  return fail;
+
+}
@@ -4,10 +4,17 @@
 
 #include <devol.h>
 
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
 
+/*
+ * The average fitness of the population. After the first generation this is
+ * just the mean the engine keeps (see devol_fitness.c); before it the initial
+ * population is evaluated.
+ */
 double gene_pool_avg_fitness(struct gene_pool *pool){
 
   int i;
@@ -16,9 +23,13 @@ double gene_pool_avg_fitness(struct gene_pool *pool){
   if ( ! pool )
     return 0;
 
+  if ( pool->fitness.count )
+    return pool->fitness.mean;
+
   for ( i = 0; i < pool->solution_count; i++){
-    pool->solutions[i].fitness_val = 
-      pool->solutions[i].fitness(&(pool->solutions[i]));
+    if ( isnan(pool->solutions[i].fitness_val) )
+      pool->solutions[i].fitness_val = 
+	pool->solutions[i].fitness(&(pool->solutions[i]));
     total += pool->solutions[i].fitness_val;
   }
 
@@ -55,6 +66,204 @@ void _gene_pool_calculate_fitnesses_p(struct gene_pool *pool,
 
 }
 
+/*
+ * Give each of the passed controllers room to list every solution in its
+ * block, if the gene pool batches its evaluations. Done once when the gene
+ * pool is made so evaluating an island never has to allocate.
+ */
+int _gene_pool_init_batches(struct gene_pool *pool,
+			    struct devol_controller *controllers, int count){
+
+  int i;
+
+  for ( i = 0; i < count; i++)
+    controllers[i].batch = NULL;
+
+  if ( ! pool->params.evaluate || pool->params.submit )
+    return DEVOL_OK;
+
+  for ( i = 0; i < count; i++){
+    if ( controllers[i].stop <= controllers[i].start )
+      continue;
+    controllers[i].batch = (solution_t **)
+      malloc(sizeof(solution_t *) *
+	     (controllers[i].stop - controllers[i].start));
+    if ( ! controllers[i].batch ){
+      _gene_pool_free_batches(controllers, i);
+      return DEVOL_ERR;
+    }
+  }
+
+  return DEVOL_OK;
+
+}
+
+void _gene_pool_free_batches(struct devol_controller *controllers, int count){
+
+  int i;
+
+  for ( i = 0; i < count; i++){
+    free(controllers[i].batch);
+    controllers[i].batch = NULL;
+  }
+
+}
+
+/*
+ * Hand the solutions from start to stop that need evaluating to
+ * params.evaluate() all at once, then evaluate whatever it left undone here.
+ * start to stop is one of the controller's islands, so it fits in the
+ * controller's batch.
+ */
+static void _gene_pool_evaluate_batch_p(struct devol_controller *controller,
+					int start, int stop){
+
+  int i, n = 0;
+  solution_t **batch = controller->batch;
+  struct gene_pool *pool = controller->gene_pool;
+
+  for ( i = start; i < stop; i++){
+    if ( isnan(pool->solutions[i].fitness_val) )
+      batch[n++] = &pool->solutions[i];
+  }
+  controller->stats.cache_hits += (stop - start) - n;
+
+  if ( n )
+    _gene_pool_evaluate_list_p(controller, batch, n);
+
+}
+
+/*
+ * Evaluate count solutions that are known to need it, with params.evaluate()
+ * if there is one.
+ */
+void _gene_pool_evaluate_list_p(struct devol_controller *controller,
+				solution_t **list, int count){
+
+  int i;
+  struct gene_pool *pool = controller->gene_pool;
+
+  if ( pool->params.submit ){
+    for ( i = 0; i < count; i++)
+      _gene_pool_submit_p(controller, list[i]);
+    _gene_pool_async_wait_p(controller);
+    return;
+  }
+
+  controller->stats.evaluations += count;
+
+  if ( pool->params.evaluate )
+    pool->params.evaluate(list, count, pool->params.evaluate_arg);
+
+  for ( i = 0; i < count; i++){
+    if ( isnan(list[i]->fitness_val) )
+      list[i]->fitness_val = list[i]->fitness(list[i]);
+  }
+
+}
+
+/*
+ * Like _gene_pool_calculate_fitnesses_p() but only evaluates the solutions
+ * that have changed since they were last evaluated, and keeps count.
+ */
+void _gene_pool_evaluate_p(struct devol_controller *controller,
+			   int start, int stop){
+
+  int i;
+  solution_t *sol;
+  struct gene_pool *pool = controller->gene_pool;
+
+  if ( controller->batch ){
+    _gene_pool_evaluate_batch_p(controller, start, stop);
+    return;
+  }
+
+  for ( i = start; i < stop; i++){
+    sol = &(pool->solutions[i]);
+    if ( ! isnan(sol->fitness_val) ){
+      controller->stats.cache_hits++;
+      continue;
+    }
+    if ( pool->params.submit ){
+      _gene_pool_submit_p(controller, sol);
+      continue;
+    }
+    sol->fitness_val = sol->fitness(sol);
+    controller->stats.evaluations++;
+  }
+
+  if ( pool->params.submit )
+    _gene_pool_async_wait_p(controller);
+
+}
+
+/*
+ * Add up the stats from each of the gene pool's controllers. For the SMP
+ * algorithm the times are summed over the threads, so they are CPU time and
+ * not wall clock time. generations is the number of generations the pool has
+ * run.
+ */
+void gene_pool_get_stats(struct gene_pool *pool, struct devol_stats *stats){
+
+  int i, p;
+  struct devol_stats *src;
+
+  memset(stats, 0, sizeof(struct devol_stats));
+  if ( ! pool )
+    return;
+
+  for ( i = -1; i < pool->workers.thread_count; i++){
+
+    src = i < 0 ? &pool->controller.stats :
+      &pool->workers.controllers[i].stats;
+
+    for ( p = 0; p < DEVOL_PHASES; p++)
+      stats->ns[p] += src->ns[p];
+    stats->evaluations += src->evaluations;
+    stats->cache_hits += src->cache_hits;
+    stats->mutates += src->mutates;
+    stats->inits += src->inits;
+
+  }
+
+  stats->generations = pool->generation;
+
+}
+
+void gene_pool_print_stats(struct gene_pool *pool, FILE *out){
+
+  int p;
+  uint64_t total = 0;
+  struct devol_stats stats;
+  char *names[] = { "fitness", "sort", "breed", "replace", "wait",
+		    "disperse" };
+
+  gene_pool_get_stats(pool, &stats);
+  for ( p = 0; p < DEVOL_PHASES; p++)
+    total += stats.ns[p];
+  if ( ! total )
+    total = 1;
+
+  fprintf(out, "# Stats after %llu generations:\n",
+	  (unsigned long long)stats.generations);
+  fprintf(out, "#   phase       time (ms)        %%\n");
+  for ( p = 0; p < DEVOL_PHASES; p++)
+    fprintf(out, "#   %-8s %12.3lf %8.2lf\n", names[p], stats.ns[p] / 1.0e6,
+	    (100.0 * stats.ns[p]) / total);
+  fprintf(out, "#   evaluations: %llu (%llu cached)\n",
+	  (unsigned long long)stats.evaluations,
+	  (unsigned long long)stats.cache_hits);
+  fprintf(out, "#   mutate: %llu  init: %llu\n",
+	  (unsigned long long)stats.mutates, (unsigned long long)stats.inits);
+  if ( pool->fitness.count ){
+    fprintf(out, "#   fitness: mean %lf  stddev %lf\n", pool->fitness.mean,
+	    sqrt(pool->fitness.variance));
+    fprintf(out, "#   fitness: min %lf  max %lf  best ever %lf\n",
+	    pool->fitness.min, pool->fitness.max, gene_pool_best_fitness(pool));
+  }
+
+}
+
 int _compare_solutions(const void *a, const void *b){
 
   solution_t *s_a = (solution_t *)a;